@@ -4,19 +4,48 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <render/shader.h>
-#include <render/texture.h>
-#include <models/box.h>
+#include <render/framebuffer.h>
+#include <render/readback.h>
+#include <render/shader_watcher.h>
+#include <render/texture_streamer.h>
+#include <render/profiler.h>
+#include <render/scene_renderer.h>
+#include <io/frame_writer.h>
 
 #include <vector>
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include <math.h>
-#include <models/sphere.h>
 
 #define _USE_MATH_DEFINES
 
-static bool useSphereScene = false; // false => boxes, true => spheres
+static SceneRenderer renderer;	// Scene, camera and anaglyph settings
 
-static Sphere sphere; // The new sphere object
+// Profiling control
+static bool showProfile = false;	// Print per-section CPU/GPU times once a second
+static std::string tracePath;		// Write a Chrome trace here on exit, empty for none
+
+// Shader control
+static bool watchShaders = false;	// Rebuild programs when their source files change
+static bool useShaderCache = true;	// Keep linked program binaries in shader_cache/
+static ShaderWatcher shaderWatcher;
+
+// Headless control
+static bool headless = false;				// Render offscreen and write frames to files instead of a window
+static int headlessFrames = 120;
+static float headlessFrameRate = 30.0f;	// Fixed timestep of the camera orbit
+static std::string outputPrefix = "frame";	// PPM sequence prefix, or a .y4m/.rgb video file
+
+// Scene control
+static std::string loadScenePath;		// Snapshot to load instead of generating the scene, empty for none
+static std::string saveScenePath;		// Write the starting scene here, empty for none
+
+// Interactive control
+static double maxFrameRate = 60.0;		// Cap on frames per second while animating, 0 for none
 
 static GLFWwindow *window;
 static int windowWidth = 1024; 
@@ -24,98 +53,276 @@ static int windowHeight = 768;
 
 static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
+static void window_refresh_callback(GLFWwindow *window);
 
-// OpenGL camera view parameters
-static glm::vec3 originalEyeCenter(0, 0, 100);
+// Sleep until an event arrives or `timeout` seconds pass, without a limit if negative
+static void waitEvents(double timeout) {
+	if (timeout < 0) {
+		glfwWaitEvents();
+		return;
+	}
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 2)
+	glfwWaitEventsTimeout(timeout);
+#else
+	// GLFW 3.1 has no timed wait: take what is queued, then sleep in short 
+	// steps so input still gets handled while the caller's deadline runs out
+	glfwPollEvents();
+	std::this_thread::sleep_for(std::chrono::duration<double>(std::min(timeout, 0.01)));
+#endif
+}
+
+// Render to the window until it is closed. Frames are only rendered when 
+// something visible changed; otherwise the window keeps the last one and the 
+// loop sleeps until input arrives.
+static void runInteractive(const glm::mat4 &projectionMatrix) {
+	double lastFrameTime = glfwGetTime();	// Orbit time base, restarted after sleeping
+	double lastPresentTime = 0;				// When the window last got a new frame
+	do
+	{
+		// Upload the next texture levels that are ready, each one sharpens the picture
+		if (!textureStreamer.idle()) {
+			textureStreamer.update();
+			renderer.invalidateFrame();
+		}
 
-static glm::vec3 eyeCenter = originalEyeCenter;
-static glm::vec3 lookat(0, 0, 0);
-static glm::vec3 up(0, 1, 0);
+		// Pick up edited shaders between frames
+		if (watchShaders && shaderWatcher.poll() > 0) {
+			renderer.invalidateFrame();
+		}
 
-static glm::float32 FoV = 45;
-static glm::float32 zNear = 0.1f; 
-static glm::float32 zFar = 1000.0f;
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		double currentTime = glfwGetTime();
 
-// View control 
-static float viewAzimuth = M_PI / 2;
-static float viewPolar = M_PI / 2;
-static float viewDistance = 100.0f;
-static bool rotating = false;
+		if (!renderer.needsFrame(projectionMatrix, framebufferWidth, framebufferHeight)) {
+			// Nothing changed, so the window still shows the right picture. Wake 
+			// up now and then if a texture or shader may still arrive.
+			waitEvents(watchShaders || !textureStreamer.idle() ? 0.25 : -1.0);
+			lastFrameTime = glfwGetTime();
+			continue;
+		}
 
-// Scene control 
-static int numBoxes = 1;				// Debug: set numBoxes to 1.
-std::vector<glm::mat4> boxTransforms;	// We represent the scene by a single box and a number of transforms for drawing the box at different locations.
+		// Hold animation to the frame rate cap. The first frame after sleeping goes out at once.
+		if (maxFrameRate > 0 && currentTime - lastPresentTime < 1.0 / maxFrameRate) {
+			waitEvents(lastPresentTime + 1.0 / maxFrameRate - currentTime);
+			continue;
+		}
+		lastPresentTime = currentTime;
 
-// Anaglyph control 
-static float ipd = 2.0f;				// Distance between left/right eye.
-// After you implement the anaglyph, adjust the IPD value to control the red/cyan offsets and depth perception. 
+		renderer.renderFrame(projectionMatrix, 0, framebufferWidth, framebufferHeight);
 
-enum AnaglyphMode {
-	None,
-	ToeIn, 
-	Asymmetric, 
-	AnaglyphModeCount,
-};
+		// Animation, from the time of the previous frame or the end of the last idle wait
+		float deltaTime = float(currentTime - lastFrameTime);
+		lastFrameTime = currentTime;
+		renderer.advanceOrbit(deltaTime);
 
-static std::string strAnaglyphMode[] = {
-	"None", 
-	"Toe-in", 
-	"Asymmetric view frustum", 
-	"Invalid",
-};
+		// Swap buffers
+		{
+			ProfileScope scope("swap", false);
+			glfwSwapBuffers(window);
+		}
+		glfwPollEvents();
 
-static AnaglyphMode anaglyphMode = AnaglyphMode::None;
+		if (showProfile) {
+			static double lastReport = 0;
+			if (currentTime - lastReport >= 1.0) {
+				lastReport = currentTime;
+				profiler.report(std::cout);
+			}
+		}
 
-// Helper functions 
+	} // Check if the ESC key was pressed or the window was closed
+	while (!glfwWindowShouldClose(window));
+}
 
-static void nextAnaglyphMode() {
-	anaglyphMode = (AnaglyphMode)(((int)anaglyphMode + 1) % (int)AnaglyphModeCount);
+// Move the oldest finished readback to the writer thread. Returns false if there was none; 
+// a frame that failed to read back is dropped, counted in readback.failures.
+static bool collectFrame(ReadbackRing &readback, FrameWriter &writer, bool wait) {
+	Frame frame;
+	frame.pixels = writer.acquireBuffer();
+	ReadbackResult result = readback.collect(frame.pixels, frame.index, wait);
+	if (result == ReadbackNotReady) return false;
+	if (result == ReadbackCollected) {
+		frame.width = readback.width;
+		frame.height = readback.height;
+		writer.push(std::move(frame));
+	}
+	return true;
 }
 
-static int randomInt() {
-	return rand();
+// Render headlessFrames frames into an offscreen framebuffer at a fixed orbit 
+// timestep and write them to <outputPrefix>_<index>.ppm, or to one video file 
+// when outputPrefix ends in .y4m or .rgb. Preparation, rendering, readback and 
+// encoding are pipelined: frame N+1 is prepared on worker threads while frame N 
+// is submitted, a ring of PBOs lets reading frame N overlap rendering frame N+1, 
+// and a writer thread converts and writes, so the slowest stage sets the rate.
+// Returns false if a frame was lost or could not be written.
+static bool runHeadless(const glm::mat4 &projectionMatrix) {
+	Framebuffer target;
+	target.initialize(windowWidth, windowHeight);
+
+	ReadbackRing readback;
+	readback.initialize(windowWidth, windowHeight, 3);
+
+	FrameWriter writer;
+	writer.start(outputPrefix, FrameFormatForPath(outputPrefix), headlessFrameRate, 8);
+
+	// Recorded frames should never show a texture placeholder
+	if (!textureStreamer.finish()) {
+		std::cerr << "Recording with textures that failed to stream" << std::endl;
+	}
+
+	double startTime = glfwGetTime();
+	if (headlessFrames > 0) {
+		renderer.prepareFrame(projectionMatrix, target.width, target.height);
+	}
+	for (int i = 0; i < headlessFrames; ++i) {
+		// The camera path is known ahead, so frame i + 1 is prepared while frame i is submitted
+		renderer.advanceOrbit(1.0f / headlessFrameRate);
+		if (i + 1 < headlessFrames) {
+			renderer.prepareFrame(projectionMatrix, target.width, target.height);
+		}
+		renderer.submitFrame(target.framebufferID);
+
+		// Only wait on the GPU if every buffer in the ring is still in flight
+		if (readback.full()) {
+			collectFrame(readback, writer, true);
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebufferID);
+		readback.request(i);
+
+		while (collectFrame(readback, writer, false)) {}
+	}
+	while (collectFrame(readback, writer, true)) {}
+	double renderTime = glfwGetTime() - startTime;
+
+	writer.finish();
+	double totalTime = glfwGetTime() - startTime;
+
+	std::cout << "Rendered " << headlessFrames << " frames in " << renderTime << " s (" 
+		<< headlessFrames / renderTime << " fps), wrote " << writer.framesWritten << " in " 
+		<< totalTime << " s, writer busy " << writer.busySeconds << " s (" << writer.framesWritten / std::max(writer.busySeconds, 1e-9) 
+		<< " fps), writer stalls: " << writer.stalls << std::endl;
+	if (readback.failures > 0 || writer.failed) {
+		std::cerr << readback.failures << " frames failed to read back" << (writer.failed ? ", writing failed" : "") << std::endl;
+	}
+	if (renderer.useDynamicResolution) {
+		std::cout << "Resolution scale " << renderer.dynamicResolution.scale << " after " << renderer.dynamicResolution.changes 
+			<< " changes (GPU " << renderer.dynamicResolution.gpuMilliseconds << " ms, budget " << renderer.dynamicResolution.budgetMilliseconds << " ms)" << std::endl;
+	}
+
+	if (profiler.enabled) {
+		profiler.report(std::cout);
+	}
+
+	bool ok = readback.failures == 0 && !writer.failed;
+	readback.cleanup();
+	target.cleanup();
+	return ok;
 }
 
-static float randomFloat() {
-	float r = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-	return r;
+// Rebuild the model and composite programs whenever their shader files are saved
+static void startShaderWatcher() {
+	shaderWatcher.watch(&renderer.box.programID, "../src/box.vert", "../src/box.frag", [] { renderer.box.loadUniforms(); });
+	shaderWatcher.watch(&renderer.box.instancedProgramID, "../src/box_instanced.vert", "../src/box.frag", [] { renderer.box.loadUniforms(); });
+	shaderWatcher.watch(&renderer.sphere.programID, "../src/sphere.vert", "../src/sphere.frag", [] { renderer.sphere.loadUniforms(); });
+	shaderWatcher.watch(&renderer.sphere.instancedProgramID, "../src/sphere_instanced.vert", "../src/sphere.frag", [] { renderer.sphere.loadUniforms(); });
+	shaderWatcher.watch(&renderer.sphere.impostorProgramID, "../src/sphere_impostor.vert", "../src/sphere_impostor.frag", [] { renderer.sphere.loadUniforms(); });
+	shaderWatcher.watch(&renderer.stereoTarget.programID, "../src/composite.vert", "../src/anaglyph.frag", [] { renderer.stereoTarget.loadUniforms(); });
+	shaderWatcher.watch(&renderer.reprojection.warpProgramID, "../src/reproject.vert", "../src/reproject.frag", [] { renderer.reprojection.loadUniforms(); });
+	shaderWatcher.watch(&renderer.reprojection.fillProgramID, "../src/composite.vert", "../src/hole_fill.frag", [] { renderer.reprojection.loadUniforms(); });
+	shaderWatcher.start();
+	std::cout << "Watching shader files for changes." << std::endl;
 }
 
-static glm::vec3 randomVec3() {
-	return glm::vec3(randomFloat(), randomFloat(), randomFloat());
+static void printUsage() {
+	std::cout << "Usage: anaglyph [--headless] [--frames N] [--fps F] [--output PREFIX|FILE.y4m|FILE.rgb] [--video FILE]" << std::endl;
+	std::cout << "                [--width W] [--height H] [--mode none|toein|asymmetric] [--max-fps F]" << std::endl;
+	std::cout << "                [--boxes N] [--spheres] [--impostors] [--instancing] [--single-pass] [--reproject] [--cull] [--rotate]" << std::endl;
+	std::cout << "                [--scene FILE.ascene] [--save-scene FILE.ascene]" << std::endl;
+	std::cout << "                [--dynamic-resolution] [--frame-budget MS] [--min-scale S] [--max-scale S]" << std::endl;
+	std::cout << "                [--watch-shaders] [--no-shader-cache] [--profile] [--trace FILE.json]" << std::endl;
 }
 
-static void generateScene() {
-	boxTransforms.clear();
-	if (numBoxes == 1) {
-		// Use this for debugging
-		glm::mat4 modelMatrix = glm::mat4();
-		modelMatrix = glm::translate(modelMatrix, glm::vec3(0, 0, 0));
-		modelMatrix = glm::scale(modelMatrix, glm::vec3(16, 16, 16));
-		boxTransforms.push_back(modelMatrix);
-	} else {
-		// Generate boxes based on random position, rotation, and scale. 
-		// Store their transforms.
-		for (int i = 0; i < numBoxes; ++i) {
-			glm::vec3 position = 100.0f * (randomVec3() - 0.5f);
-			float s = (1 + (randomInt() % 4)) * 1.0f;
-			glm::vec3 scale(s, s, s);
-			float angle = randomFloat() * M_PI * 2;
-			glm::vec3 axis = glm::normalize(randomVec3() - 0.5f);
-
-			glm::mat4 modelMatrix = glm::mat4();
-			modelMatrix = glm::translate(modelMatrix, position);
-			modelMatrix = glm::rotate(modelMatrix, angle, axis);
-			modelMatrix = glm::scale(modelMatrix, scale);
-			boxTransforms.push_back(modelMatrix);
+static bool parseArguments(int argc, char **argv) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--frames" && hasValue) {
+			headlessFrames = atoi(argv[++i]);
+		} else if (arg == "--fps" && hasValue) {
+			headlessFrameRate = (float)atof(argv[++i]);
+		} else if (arg == "--output" && hasValue) {
+			outputPrefix = argv[++i];
+		} else if (arg == "--video" && hasValue) {
+			// Record the camera orbit into a video file
+			outputPrefix = argv[++i];
+			headless = true;
+			renderer.rotating = true;
+			if (FrameFormatForPath(outputPrefix) == PPMSequence) return false;
+		} else if (arg == "--max-fps" && hasValue) {
+			maxFrameRate = atof(argv[++i]);
+		} else if (arg == "--width" && hasValue) {
+			windowWidth = atoi(argv[++i]);
+		} else if (arg == "--height" && hasValue) {
+			windowHeight = atoi(argv[++i]);
+		} else if (arg == "--mode" && hasValue) {
+			std::string mode = argv[++i];
+			if (mode == "none") renderer.anaglyphMode = None;
+			else if (mode == "toein") renderer.anaglyphMode = ToeIn;
+			else if (mode == "asymmetric") renderer.anaglyphMode = Asymmetric;
+			else return false;
+		} else if (arg == "--boxes" && hasValue) {
+			renderer.numBoxes = atoi(argv[++i]);
+		} else if (arg == "--spheres") {
+			renderer.useSphereScene = true;
+		} else if (arg == "--scene" && hasValue) {
+			loadScenePath = argv[++i];
+		} else if (arg == "--save-scene" && hasValue) {
+			saveScenePath = argv[++i];
+		} else if (arg == "--impostors") {
+			renderer.useSphereImpostors = true;
+		} else if (arg == "--instancing") {
+			renderer.useInstancing = true;
+		} else if (arg == "--reproject") {
+			renderer.useReprojection = true;
+		} else if (arg == "--single-pass") {
+			renderer.useSinglePassStereo = true;
+		} else if (arg == "--cull") {
+			renderer.useCulling = true;
+		} else if (arg == "--dynamic-resolution") {
+			renderer.useDynamicResolution = true;
+		} else if (arg == "--frame-budget" && hasValue) {
+			renderer.dynamicResolution.budgetMilliseconds = atof(argv[++i]);
+		} else if (arg == "--min-scale" && hasValue) {
+			renderer.dynamicResolution.minScale = (float)atof(argv[++i]);
+		} else if (arg == "--max-scale" && hasValue) {
+			renderer.dynamicResolution.maxScale = (float)atof(argv[++i]);
+		} else if (arg == "--rotate") {
+			renderer.rotating = true;
+		} else if (arg == "--watch-shaders") {
+			watchShaders = true;
+		} else if (arg == "--no-shader-cache") {
+			useShaderCache = false;
+		} else if (arg == "--profile") {
+			showProfile = true;
+		} else if (arg == "--trace" && hasValue) {
+			tracePath = argv[++i];
+		} else {
+			return false;
 		}
 	}
+	const DynamicResolution &resolution = renderer.dynamicResolution;
+	if (resolution.budgetMilliseconds <= 0 || resolution.minScale <= 0 || resolution.maxScale > 1 || resolution.minScale > resolution.maxScale) return false;
+	return windowWidth > 0 && windowHeight > 0 && renderer.numBoxes > 0 && headlessFrames >= 0 && headlessFrameRate > 0 && maxFrameRate >= 0;
 }
 
 // Debugging functions 
 
 static void printAnaglyphMode() {
-	std::cout << "Anaglyph mode: " << strAnaglyphMode[(int)anaglyphMode] << std::endl;
+	std::cout << "Anaglyph mode: " << strAnaglyphMode[(int)renderer.anaglyphMode] << std::endl;
 }
 
 static void printVec3(glm::vec3 v) {
@@ -130,8 +337,14 @@ static void printMat4(glm::mat4 m) {
 	std::cout << m[0][3] << " " << m[1][3] << " " << m[2][3] << " " << m[3][3] << std::endl;
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
+	if (!parseArguments(argc, argv))
+	{
+		printUsage();
+		return -1;
+	}
+
 	// Initialise GLFW
 	if (!glfwInit())
 	{
@@ -144,6 +357,13 @@ int main(void)
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For MacOS
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	// Headless runs still need a context, but the window is never shown. On machines 
+	// without a display, run under a virtual X server (e.g. xvfb-run with Mesa llvmpipe).
+	if (headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	}
+
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(windowWidth, windowHeight, "Anaglyph Rendering", NULL, NULL);
 	if (window == NULL)
@@ -161,6 +381,9 @@ int main(void)
 	// Ensure we can capture mouse cursor movement 
 	glfwSetCursorPosCallback(window, cursor_position_callback);
 
+	// Redraw when the window system lost the window's contents
+	glfwSetWindowRefreshCallback(window, window_refresh_callback);
+
 	// Load OpenGL functions, gladLoadGL returns the loaded version, 0 on error.
 	int version = gladLoadGL(glfwGetProcAddress);
 	if (version == 0)
@@ -177,197 +400,75 @@ int main(void)
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
 
-	// Create a box
-	Box box;
-	box.initialize();
+	profiler.enabled = showProfile || !tracePath.empty();
+	profiler.tracing = !tracePath.empty();
+
+	if (!useShaderCache)
+	{
+		SetShaderCacheDirectory(NULL);
+	}
+
+	textureStreamer.initialize();
+
+	// Create the box and sphere models
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	renderer.aspect = (float)windowWidth / windowHeight;
+	renderer.dynamicResolution.logChanges = true;
+	renderer.initialize(framebufferWidth, framebufferHeight);
 
-	sphere.initialize();
+	if (watchShaders && !headless)
+	{
+		startShaderWatcher();
+	}
 
-	// Create the scene with a set of boxes represented by their transforms
-	generateScene();
+	// Create the scene with a set of boxes represented by their transforms, or load a saved one
+	if (loadScenePath.empty() || !renderer.loadScene(loadScenePath))
+	{
+		renderer.generateScene();
+	}
+	if (!saveScenePath.empty())
+	{
+		renderer.saveScene(saveScenePath);
+	}
 
 	// Set a perspective camera 
-	glm::mat4 projectionMatrix = glm::perspective(glm::radians(FoV), (float)windowWidth / windowHeight, zNear, zFar);
+	glm::mat4 projectionMatrix = renderer.projectionMatrix();
 
 	printAnaglyphMode();
 
-	do
+	bool ok = true;
+	if (headless)
 	{
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// TODO: Render anaglyph 
-		// --------------------------------------------------------------------
+		ok = runHeadless(projectionMatrix);
+	}
+	else
+	{
+		runInteractive(projectionMatrix);
+	}
 
-		if (anaglyphMode == None)
+	if (profiler.tracing)
+	{
+		if (profiler.writeTrace(tracePath))
 		{
-			// Clear the screen
-			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			// Set camera view matrix
-			glm::mat4 viewMatrix = glm::lookAt(eyeCenter, lookat, up);
-			glm::mat4 vp = projectionMatrix * viewMatrix;
-
-			// If we’re in sphere scene, render spheres. Otherwise, render boxes.
-			if (!useSphereScene)
-			{
-				for (int i = 0; i < numBoxes; ++i)
-				{
-					box.render(vp, boxTransforms[i]);
-				}
-			}
-			else
-			{
-				for (int i = 0; i < numBoxes; ++i)
-				{
-					sphere.render(vp, boxTransforms[i]);
-				}
-			}
+			std::cout << "Wrote trace " << tracePath << " (" << profiler.traceEvents.size() << " events)" << std::endl;
 		}
 		else
 		{
-
-			glm::mat4 vpLeft;
-			glm::mat4 vpRight;
-
-			if (anaglyphMode == ToeIn) {
-
-				// TODO: Implement the toe-in projection here
-				// 1) Compute the camera’s right direction
-				glm::vec3 rightDir = glm::normalize(glm::cross(lookat - eyeCenter, up));
-
-				// 2) Shift each eye left/right by half the IPD
-				glm::vec3 leftEyePos = eyeCenter - 0.5f * ipd * rightDir;
-				glm::vec3 rightEyePos = eyeCenter + 0.5f * ipd * rightDir;
-
-				// 3) “Toe in”: each eye rotates to converge on the same lookat point
-				glm::mat4 viewLeft = glm::lookAt(leftEyePos, lookat, up);
-				glm::mat4 viewRight = glm::lookAt(rightEyePos, lookat, up);
-
-				// 4) Use the same perspective projection for both eyes
-				vpLeft = projectionMatrix * viewLeft;
-				vpRight = projectionMatrix * viewRight;
-
-				// ------------------------------------------------------------
-
-
-			} else if (anaglyphMode == Asymmetric) {	
-
-				// TODO: Implement the asymmetric view frustum here
-				float aspect = float(windowWidth) / float(windowHeight);
-				float top = zNear * tan(glm::radians(FoV / 2.0f));
-				float rightVal = top * aspect;
-
-				// Distance from camera to the plane you’re focusing on.
-				// Here, we use “viewDistance” since the camera is ~100 units from the origin.
-				float frustumShift = 0.5f * ipd * (zNear / viewDistance);
-
-				// Compute shared directions
-				glm::vec3 forwardDir = glm::normalize(lookat - eyeCenter);
-				glm::vec3 rightDir = glm::normalize(glm::cross(forwardDir, up));
-
-				// Left eye position (shift by -ipd/2)
-				glm::vec3 leftEyePos = eyeCenter - 0.5f * ipd * rightDir;
-				// Right eye position (shift by +ipd/2)
-				glm::vec3 rightEyePos = eyeCenter + 0.5f * ipd * rightDir;
-
-				// For the left eye, frustum is shifted to the right by “frustumShift”
-				float left_left = -rightVal + frustumShift;
-				float left_right = rightVal + frustumShift;
-				glm::mat4 projLeft = glm::frustum(left_left, left_right, -top, top, zNear, zFar);
-				glm::mat4 viewLeft = glm::lookAt(leftEyePos, leftEyePos + forwardDir, up);
-				vpLeft = projLeft * viewLeft;
-
-				// For the right eye, frustum is shifted left by “frustumShift”
-				float right_left = -rightVal - frustumShift;
-				float right_right = rightVal - frustumShift;
-				glm::mat4 projRight = glm::frustum(right_left, right_right, -top, top, zNear, zFar);
-				glm::mat4 viewRight = glm::lookAt(rightEyePos, rightEyePos + forwardDir, up);
-				vpRight = projRight * viewRight;
-
-				// ------------------------------------------------------------
-
-			}
-
-			// TODO: Implement two-pass rendering to draw the anaglyph
-			// FIRST PASS: Render the Left Eye in Red only
-			glColorMask(GL_TRUE, GL_FALSE, GL_FALSE, GL_TRUE); // R only
-			glClear(GL_DEPTH_BUFFER_BIT);					   // Clear depth but keep color
-			if (!useSphereScene)
-			{
-				// BOX RENDER
-				for (int i = 0; i < numBoxes; ++i)
-				{
-					box.render(vpLeft, boxTransforms[i]);
-				}
-			}
-			else
-			{
-				// SPHERE RENDER
-				// Note: you can re-use boxTransforms for the sphere's positions/scales
-				// or define a separate sphereTransforms if you prefer.
-				for (int i = 0; i < numBoxes; ++i)
-				{
-					sphere.render(vpLeft, boxTransforms[i]);
-				}
-			}
-
-			// SECOND PASS: Render the Right Eye in Cyan (G+B) only
-			// SECOND PASS: Render the Right Eye in Cyan (G+B) only
-			glColorMask(GL_FALSE, GL_TRUE, GL_TRUE, GL_TRUE); // G+B
-			glClear(GL_DEPTH_BUFFER_BIT);					  // Clear depth again
-			if (!useSphereScene)
-			{
-				// BOX RENDER
-				for (int i = 0; i < numBoxes; ++i)
-				{
-					box.render(vpRight, boxTransforms[i]);
-				}
-			}
-			else
-			{
-				// SPHERE RENDER
-				for (int i = 0; i < numBoxes; ++i)
-				{
-					sphere.render(vpRight, boxTransforms[i]);
-				}
-			}
-
-			// Finally, restore normal color masking
-			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-
-			// ----------------------------------------------------------------
-		}
-
-		// --------------------------------------------------------------------
-
-
-		// Animation
-		static double lastTime = glfwGetTime();
-		double currentTime = glfwGetTime();
-		float deltaTime = float(currentTime - lastTime);
-		lastTime = currentTime;
-		if (rotating) {
-			viewAzimuth += 1.0f * deltaTime;
-			eyeCenter.x = viewDistance * cos(viewAzimuth);
-			eyeCenter.z = viewDistance * sin(viewAzimuth);
+			std::cerr << "Cannot write trace " << tracePath << std::endl;
 		}
-
-		// Swap buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-
-	} // Check if the ESC key was pressed or the window was closed
-	while (!glfwWindowShouldClose(window));
+	}
 
 	// Clean up
-	sphere.cleanup();
-	box.cleanup();
+	profiler.cleanup();
+	shaderWatcher.stop();
+	renderer.cleanup();
+	textureStreamer.cleanup();
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
 
-	return 0;
+	return ok ? 0 : 1;
 }
 
 // Is called whenever a key is pressed/released via GLFW
@@ -376,46 +477,43 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 	if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
 	{
 		std::cout << "Space key is pressed." << std::endl;
-		rotating = !rotating;
+		renderer.rotating = !renderer.rotating;
 	}
 
 	if (key == GLFW_KEY_R && action == GLFW_PRESS)
 	{
 		std::cout << "Reset." << std::endl;
-		rotating = false;
-		eyeCenter = originalEyeCenter;
-		viewAzimuth = M_PI / 2;
-		viewPolar = M_PI / 2;
+		renderer.resetCamera();
 	}
 
 	if (key == GLFW_KEY_UP && (action == GLFW_REPEAT || action == GLFW_PRESS))
 	{
-		viewPolar -= 0.1f;
-		eyeCenter.y = viewDistance * cos(viewPolar);
+		renderer.viewPolar -= 0.1f;
+		renderer.eyeCenter.y = renderer.viewDistance * cos(renderer.viewPolar);
 	}
 
 	if (key == GLFW_KEY_DOWN && (action == GLFW_REPEAT || action == GLFW_PRESS))
 	{
-		viewPolar += 0.1f;
-		eyeCenter.y = viewDistance * cos(viewPolar);
+		renderer.viewPolar += 0.1f;
+		renderer.eyeCenter.y = renderer.viewDistance * cos(renderer.viewPolar);
 	}
 
 	if (key == GLFW_KEY_LEFT && (action == GLFW_REPEAT || action == GLFW_PRESS))
 	{
-		viewAzimuth -= 0.1f;
-		eyeCenter.x = viewDistance * cos(viewAzimuth);
-		eyeCenter.z = viewDistance * sin(viewAzimuth);
+		renderer.viewAzimuth -= 0.1f;
+		renderer.eyeCenter.x = renderer.viewDistance * cos(renderer.viewAzimuth);
+		renderer.eyeCenter.z = renderer.viewDistance * sin(renderer.viewAzimuth);
 	}
 
 	if (key == GLFW_KEY_RIGHT && (action == GLFW_REPEAT || action == GLFW_PRESS))
 	{
-		viewAzimuth += 0.1f;
-		eyeCenter.x = viewDistance * cos(viewAzimuth);
-		eyeCenter.z = viewDistance * sin(viewAzimuth);
+		renderer.viewAzimuth += 0.1f;
+		renderer.eyeCenter.x = renderer.viewDistance * cos(renderer.viewAzimuth);
+		renderer.eyeCenter.z = renderer.viewDistance * sin(renderer.viewAzimuth);
 	}
 
 	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
-        nextAnaglyphMode(); 
+        renderer.nextAnaglyphMode(); 
 		printAnaglyphMode();
 	}
 
@@ -423,42 +521,122 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 	// Special case: IPD == 0 means no 3D effect.
 
 	if (key == GLFW_KEY_COMMA) {
-		ipd -= 0.1f;
-		ipd = std::max(ipd, 0.0f);
-		std::cout << "IPD: " << ipd << std::endl;
+		renderer.ipd -= 0.1f;
+		renderer.ipd = std::max(renderer.ipd, 0.0f);
+		std::cout << "IPD: " << renderer.ipd << std::endl;
 	}
 
 	if (key == GLFW_KEY_PERIOD) {
-		ipd += 0.1f;
-		std::cout << "IPD: " << ipd << std::endl;
+		renderer.ipd += 0.1f;
+		std::cout << "IPD: " << renderer.ipd << std::endl;
 	}
 
 	if (key == GLFW_KEY_1) {
-		numBoxes = 1;
-		generateScene();
+		renderer.numBoxes = 1;
+		renderer.scenePath.clear();
+		renderer.generateScene();
 	}
 
 	if (key == GLFW_KEY_0) {
-		numBoxes = 100;
-		generateScene();
+		renderer.numBoxes = 100;
+		renderer.scenePath.clear();
+		renderer.generateScene();
+	}
+
+	// Stress test, best used together with instancing
+	if (key == GLFW_KEY_9 && action == GLFW_PRESS) {
+		renderer.numBoxes = 100000;
+		renderer.scenePath.clear();
+		renderer.generateScene();
+	}
+
+	// Press 'S' to toggle single-pass stereo (applies to the anaglyph modes)
+	if (key == GLFW_KEY_S && action == GLFW_PRESS) {
+		renderer.useSinglePassStereo = !renderer.useSinglePassStereo;
+		std::cout << "Single-pass stereo: " << (renderer.useSinglePassStereo ? "on" : "off") << std::endl;
+	}
+
+	// Press 'K' to cycle the color matrices of the single-pass composite
+	if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+		renderer.nextCompositeMatrix();
+		std::cout << "Composite colors: " << strAnaglyphMatrix[(int)renderer.compositeMatrix] << std::endl;
+	}
+
+	// Press 'C' to toggle frustum culling
+	if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+		renderer.useCulling = !renderer.useCulling;
+		std::cout << "Culling: " << (renderer.useCulling ? "on" : "off") << std::endl;
+	}
+
+	// Press 'L' to toggle sphere level of detail
+	if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+		renderer.useSphereLOD = !renderer.useSphereLOD;
+		std::cout << "Sphere level of detail: " << (renderer.useSphereLOD ? "on" : "off") << std::endl;
+	}
+
+	// Press 'O' to toggle ray-cast sphere impostors
+	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+		renderer.useSphereImpostors = !renderer.useSphereImpostors;
+		std::cout << "Sphere impostors: " << (renderer.useSphereImpostors ? "on" : "off") << std::endl;
+	}
+
+	// Press 'J' to toggle synthesizing the right eye by reprojecting the left one
+	if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+		renderer.useReprojection = !renderer.useReprojection;
+		std::cout << "Right eye reprojection: " << (renderer.useReprojection ? "on" : "off") << std::endl;
+	}
+
+	// Press 'Q' to measure how far the reprojected right eye is from a rendered one
+	if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		ReprojectionQuality quality = renderer.measureReprojection(renderer.projectionMatrix(), framebufferWidth, framebufferHeight);
+		std::cout << "Reprojection quality: PSNR " << quality.difference.psnr << " dB, mean error " << quality.difference.meanAbsoluteError 
+			<< ", " << quality.difference.differingFraction * 100 << "% values off, " << quality.holeFraction * 100 << "% holes filled" << std::endl;
+	}
+
+	// Press 'G' to toggle the GL state change report
+	if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+		renderer.showStateStats = !renderer.showStateStats;
+		std::cout << "GL state report: " << (renderer.showStateStats ? "on" : "off") << std::endl;
+	}
+
+	// Press 'P' to toggle the per-section timing report
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		showProfile = !showProfile;
+		profiler.enabled = showProfile || profiler.tracing;
+		std::cout << "Timing report: " << (showProfile ? "on" : "off") << std::endl;
+	}
+
+	// Press 'I' to toggle instanced rendering
+	if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+		renderer.useInstancing = !renderer.useInstancing;
+		std::cout << "Instancing: " << (renderer.useInstancing ? "on" : "off") << std::endl;
+	}
+
+	// Press 'D' to toggle dynamic resolution
+	if (key == GLFW_KEY_D && action == GLFW_PRESS) {
+		renderer.useDynamicResolution = !renderer.useDynamicResolution;
+		std::cout << "Dynamic resolution: " << (renderer.useDynamicResolution ? "on" : "off") 
+			<< " (budget " << renderer.dynamicResolution.budgetMilliseconds << " ms)" << std::endl;
 	}
 
 	// Press '2' to toggle sphere mode
 	if (key == GLFW_KEY_2 && action == GLFW_PRESS)
 	{
-		useSphereScene = !useSphereScene;
-		if (useSphereScene)
+		renderer.useSphereScene = !renderer.useSphereScene;
+		if (renderer.useSphereScene)
 		{
 			std::cout << "Switched to Sphere scene.\n";
 			// If you want to regenerate a random sphere scene
 			// or re-use the same transforms, do it here:
-			generateScene();
+			renderer.generateScene();
 			// Or create a separate generateSphereScene() if you want different logic
 		}
 		else
 		{
 			std::cout << "Switched to Box scene.\n";
-			generateScene();
+			renderer.generateScene();
 		}
 	}
 
@@ -466,6 +644,10 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 		glfwSetWindowShouldClose(window, GL_TRUE);
 }
 
+void window_refresh_callback(GLFWwindow *window) {
+	renderer.invalidateFrame();
+}
+
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
 	// Optionally, you can implement your own mouse support.
 }
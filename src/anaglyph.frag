@@ -0,0 +1,22 @@
+#version 330 core
+
+in vec2 uv;
+
+// Left eye in the left half of the texture, right eye in the right half
+uniform sampler2D stereoTexture;
+
+// Contribution of each eye's RGB to the output color
+uniform mat3 leftMatrix;
+uniform mat3 rightMatrix;
+
+out vec3 finalColor;
+
+void main()
+{
+	// Stay half a texel inside the left half, so filtering never mixes in the right eye
+	float halfTexel = 0.5 / float(textureSize(stereoTexture, 0).x);
+	vec2 position = vec2(clamp(uv.x * 0.5, halfTexel, 0.5 - halfTexel), uv.y);
+	vec3 left = texture(stereoTexture, position).rgb;
+	vec3 right = texture(stereoTexture, position + vec2(0.5, 0.0)).rgb;
+	finalColor = clamp(leftMatrix * left + rightMatrix * right, 0.0, 1.0);
+}
@@ -0,0 +1,385 @@
+// Headless benchmark: renders a fixed camera orbit over scenes of every size, 
+// anaglyph mode and model, and reports frame time distributions and draw 
+// calls as JSON, to compare builds and catch regressions.
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <render/framebuffer.h>
+#include <render/render_state.h>
+#include <render/stream_buffer.h>
+#include <render/texture_streamer.h>
+#include <render/scene_renderer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int benchSeed = 2024;
+
+// Sphere meshes and sphere impostors are separate scenes so one run compares them
+enum BenchScene { BoxScene, SphereScene, ImpostorScene };
+
+// Benchmark settings
+static int width = 1024;
+static int height = 768;
+static int warmupFrames = 10;
+static int measuredFrames = 60;
+static float frameRate = 30.0f;		// Timestep of the scripted orbit
+static double maxCaseSeconds = 20.0;	// Stop measuring a case early past this budget
+static std::vector<int> sceneSizes = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+static std::vector<AnaglyphMode> modes = { None, ToeIn, Asymmetric };
+static std::vector<BenchScene> scenes = { BoxScene, SphereScene, ImpostorScene };
+static std::string outputPath;		// Empty for stdout
+
+static SceneRenderer renderer;
+
+static const char *sceneName(BenchScene scene) {
+	switch (scene) {
+	case SphereScene: return "sphere";
+	case ImpostorScene: return "impostor";
+	default: return "box";
+	}
+}
+
+static const char *modeName(AnaglyphMode mode) {
+	switch (mode) {
+	case ToeIn: return "toein";
+	case Asymmetric: return "asymmetric";
+	default: return "none";
+	}
+}
+
+struct Distribution {
+	double min = 0, mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+static Distribution distribution(std::vector<double> samples) {
+	Distribution d;
+	if (samples.empty()) return d;
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (double sample : samples) sum += sample;
+	size_t n = samples.size();
+	d.min = samples.front();
+	d.max = samples.back();
+	d.mean = sum / n;
+	d.p50 = samples[std::min(n - 1, (size_t)(0.50 * n))];
+	d.p95 = samples[std::min(n - 1, (size_t)(0.95 * n))];
+	d.p99 = samples[std::min(n - 1, (size_t)(0.99 * n))];
+	return d;
+}
+
+static void writeDistribution(std::ostream &out, const char *name, const Distribution &d) {
+	out << "\"" << name << "\": {\"min\": " << d.min << ", \"mean\": " << d.mean << ", \"p50\": " << d.p50 
+		<< ", \"p95\": " << d.p95 << ", \"p99\": " << d.p99 << ", \"max\": " << d.max << "}";
+}
+
+struct CaseResult {
+	BenchScene scene;
+	int boxes;
+	AnaglyphMode mode;
+	int frames;
+	Distribution frameTime;		// Milliseconds from submission to glFinish returning
+	Distribution submitTime;	// Milliseconds spent in renderFrame() on the CPU
+	double drawCalls;			// Per frame, averaged
+	double vertices;
+	double stateChanges;
+	double stateChangesElided;
+	double sceneSeconds;		// generateScene() including uploads
+	int fenceWaits;				// Measured frames that waited for the GPU to release instance stream memory
+	double resolutionScale;		// Mean over the measured frames, 1 without --dynamic-resolution
+	int resolutionChanges;
+	bool measuredReprojection;	// Stereo cases with --reproject compare the synthesized right eye to a rendered one
+	ReprojectionQuality reprojection;
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static CaseResult runCase(Framebuffer &target, BenchScene scene, int boxes, AnaglyphMode mode) {
+	CaseResult result;
+	result.scene = scene;
+	result.boxes = boxes;
+	result.mode = mode;
+
+	// Same scene and the same orbit for every case and every build
+	renderer.useSphereScene = scene != BoxScene;
+	renderer.useSphereImpostors = scene == ImpostorScene;
+	renderer.numBoxes = boxes;
+	renderer.anaglyphMode = mode;
+	renderer.resetCamera();
+	renderer.rotating = true;
+
+	auto sceneStart = std::chrono::steady_clock::now();
+	renderer.generateScene();
+	glFinish();
+	result.sceneSeconds = millisecondsSince(sceneStart) * 1e-3;
+	renderer.dynamicResolution.reset();
+
+	glm::mat4 projectionMatrix = renderer.projectionMatrix();
+	for (int i = 0; i < warmupFrames; ++i) {
+		renderer.renderFrame(projectionMatrix, target.framebufferID, target.width, target.height);
+		glFinish();
+		renderer.advanceOrbit(1.0f / frameRate);
+	}
+
+	std::vector<double> frameTimes, submitTimes;
+	double drawCalls = 0, vertices = 0, stateChanges = 0, stateChangesElided = 0, resolutionScale = 0;
+	int fenceWaitsBefore = instanceStream.fenceWaits;
+	int resolutionChangesBefore = renderer.dynamicResolution.changes;
+	auto caseStart = std::chrono::steady_clock::now();
+	for (int i = 0; i < measuredFrames; ++i) {
+		auto frameStart = std::chrono::steady_clock::now();
+		renderer.renderFrame(projectionMatrix, target.framebufferID, target.width, target.height);
+		submitTimes.push_back(millisecondsSince(frameStart));
+		glFinish();
+		frameTimes.push_back(millisecondsSince(frameStart));
+
+		drawCalls += renderState.drawCalls;
+		vertices += (double)renderState.vertices;
+		stateChanges += renderState.issued;
+		stateChangesElided += renderState.elided;
+		resolutionScale += renderer.useDynamicResolution && mode != None ? renderer.dynamicResolution.scale : 1.0;
+		renderer.advanceOrbit(1.0f / frameRate);
+
+		if (millisecondsSince(caseStart) * 1e-3 > maxCaseSeconds) break;
+	}
+
+	result.frames = (int)frameTimes.size();
+	result.frameTime = distribution(frameTimes);
+	result.submitTime = distribution(submitTimes);
+	result.drawCalls = drawCalls / result.frames;
+	result.vertices = vertices / result.frames;
+	result.stateChanges = stateChanges / result.frames;
+	result.stateChangesElided = stateChangesElided / result.frames;
+	result.fenceWaits = instanceStream.fenceWaits - fenceWaitsBefore;
+	result.resolutionScale = resolutionScale / result.frames;
+	result.resolutionChanges = renderer.dynamicResolution.changes - resolutionChangesBefore;
+
+	result.measuredReprojection = renderer.useReprojection && mode != None;
+	if (result.measuredReprojection) {
+		result.reprojection = renderer.measureReprojection(projectionMatrix, target.width, target.height);
+	}
+	return result;
+}
+
+static void writeReport(std::ostream &out, const std::vector<CaseResult> &results) {
+	out << "{" << std::endl;
+	out << "  \"seed\": " << benchSeed << "," << std::endl;
+	out << "  \"renderer\": \"" << (const char *)glGetString(GL_RENDERER) << "\"," << std::endl;
+	out << "  \"gl_version\": \"" << (const char *)glGetString(GL_VERSION) << "\"," << std::endl;
+	out << "  \"width\": " << width << ", \"height\": " << height << "," << std::endl;
+	out << "  \"warmup_frames\": " << warmupFrames << ", \"frames\": " << measuredFrames << ", \"orbit_fps\": " << frameRate << "," << std::endl;
+	out << "  \"instancing\": " << (renderer.useInstancing ? "true" : "false") << ", \"single_pass\": " << (renderer.useSinglePassStereo ? "true" : "false") 
+		<< ", \"culling\": " << (renderer.useCulling ? "true" : "false") << ", \"sphere_lod\": " << (renderer.useSphereLOD ? "true" : "false") 
+		<< ", \"reprojection\": " << (renderer.useReprojection ? "true" : "false") << "," << std::endl;
+	out << "  \"dynamic_resolution\": " << (renderer.useDynamicResolution ? "true" : "false") << ", \"frame_budget_ms\": " << renderer.dynamicResolution.budgetMilliseconds 
+		<< ", \"min_scale\": " << renderer.dynamicResolution.minScale << ", \"max_scale\": " << renderer.dynamicResolution.maxScale << "," << std::endl;
+	// Bytes per vertex and per index of the meshes, smaller when optimized
+	out << "  \"optimized_meshes\": " << (renderer.useOptimizedMeshes ? "true" : "false") 
+		<< ", \"box_vertex_bytes\": " << renderer.box.mesh.vertexStride << ", \"box_index_bytes\": " << (renderer.box.mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4) 
+		<< ", \"sphere_vertex_bytes\": " << renderer.sphere.mesh.vertexStride << ", \"sphere_index_bytes\": " << (renderer.sphere.mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4) << "," << std::endl;
+	out << "  \"results\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); ++i) {
+		const CaseResult &r = results[i];
+		out << "    {\"scene\": \"" << sceneName(r.scene) << "\", \"boxes\": " << r.boxes << ", \"mode\": \"" << modeName(r.mode) 
+			<< "\", \"frames\": " << r.frames << ", \"scene_seconds\": " << r.sceneSeconds << ", ";
+		writeDistribution(out, "frame_ms", r.frameTime);
+		out << ", ";
+		writeDistribution(out, "submit_ms", r.submitTime);
+		out << ", \"draw_calls\": " << r.drawCalls << ", \"vertices\": " << r.vertices << ", \"state_changes\": " << r.stateChanges 
+			<< ", \"state_changes_elided\": " << r.stateChangesElided << ", \"fence_waits\": " << r.fenceWaits 
+			<< ", \"resolution_scale\": " << r.resolutionScale << ", \"resolution_changes\": " << r.resolutionChanges;
+		if (r.measuredReprojection) {
+			// JSON has no infinity: identical images report a PSNR of null
+			out << ", \"reprojection\": {\"holes\": " << r.reprojection.holeFraction << ", \"mean_error\": " << r.reprojection.difference.meanAbsoluteError 
+				<< ", \"differing\": " << r.reprojection.difference.differingFraction << ", \"psnr\": ";
+			if (std::isinf(r.reprojection.difference.psnr)) out << "null";
+			else out << r.reprojection.difference.psnr;
+			out << "}";
+		}
+		out << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
+static void printUsage() {
+	std::cout << "Usage: anaglyph_bench [--sizes N,N,...] [--modes none,toein,asymmetric] [--scenes box,sphere,impostor]" << std::endl;
+	std::cout << "                      [--frames N] [--warmup N] [--max-seconds S] [--width W] [--height H]" << std::endl;
+	std::cout << "                      [--instancing] [--single-pass] [--reproject] [--cull] [--no-lod] [--raw-meshes]" << std::endl;
+	std::cout << "                      [--dynamic-resolution] [--frame-budget MS] [--min-scale S] [--max-scale S] [--output FILE.json]" << std::endl;
+}
+
+static std::vector<std::string> splitList(const std::string &list) {
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		if (!item.empty()) items.push_back(item);
+	}
+	return items;
+}
+
+static bool parseArguments(int argc, char **argv) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--sizes" && hasValue) {
+			sceneSizes.clear();
+			for (const std::string &item : splitList(argv[++i])) sceneSizes.push_back(atoi(item.c_str()));
+		} else if (arg == "--modes" && hasValue) {
+			modes.clear();
+			for (const std::string &item : splitList(argv[++i])) {
+				if (item == "none") modes.push_back(None);
+				else if (item == "toein") modes.push_back(ToeIn);
+				else if (item == "asymmetric") modes.push_back(Asymmetric);
+				else return false;
+			}
+		} else if (arg == "--scenes" && hasValue) {
+			scenes.clear();
+			for (const std::string &item : splitList(argv[++i])) {
+				if (item == "box") scenes.push_back(BoxScene);
+				else if (item == "sphere") scenes.push_back(SphereScene);
+				else if (item == "impostor") scenes.push_back(ImpostorScene);
+				else return false;
+			}
+		} else if (arg == "--frames" && hasValue) {
+			measuredFrames = atoi(argv[++i]);
+		} else if (arg == "--warmup" && hasValue) {
+			warmupFrames = atoi(argv[++i]);
+		} else if (arg == "--max-seconds" && hasValue) {
+			maxCaseSeconds = atof(argv[++i]);
+		} else if (arg == "--width" && hasValue) {
+			width = atoi(argv[++i]);
+		} else if (arg == "--height" && hasValue) {
+			height = atoi(argv[++i]);
+		} else if (arg == "--instancing") {
+			renderer.useInstancing = true;
+		} else if (arg == "--single-pass") {
+			renderer.useSinglePassStereo = true;
+		} else if (arg == "--reproject") {
+			renderer.useReprojection = true;
+		} else if (arg == "--cull") {
+			renderer.useCulling = true;
+		} else if (arg == "--no-lod") {
+			renderer.useSphereLOD = false;
+		} else if (arg == "--dynamic-resolution") {
+			renderer.useDynamicResolution = true;
+		} else if (arg == "--frame-budget" && hasValue) {
+			renderer.dynamicResolution.budgetMilliseconds = atof(argv[++i]);
+		} else if (arg == "--min-scale" && hasValue) {
+			renderer.dynamicResolution.minScale = (float)atof(argv[++i]);
+		} else if (arg == "--max-scale" && hasValue) {
+			renderer.dynamicResolution.maxScale = (float)atof(argv[++i]);
+		} else if (arg == "--raw-meshes") {
+			renderer.useOptimizedMeshes = false;
+		} else if (arg == "--output" && hasValue) {
+			outputPath = argv[++i];
+		} else {
+			return false;
+		}
+	}
+	for (int size : sceneSizes) {
+		if (size <= 0) return false;
+	}
+	const DynamicResolution &resolution = renderer.dynamicResolution;
+	if (resolution.budgetMilliseconds <= 0 || resolution.minScale <= 0 || resolution.maxScale > 1 || resolution.minScale > resolution.maxScale) return false;
+	return width > 0 && height > 0 && measuredFrames > 0 && warmupFrames >= 0 && !sceneSizes.empty() && !modes.empty() && !scenes.empty();
+}
+
+int main(int argc, char **argv)
+{
+	if (!parseArguments(argc, argv))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (!glfwInit())
+	{
+		std::cerr << "Failed to initialize GLFW." << std::endl;
+		return -1;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For MacOS
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+	GLFWwindow *window = glfwCreateWindow(width, height, "Anaglyph Benchmark", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cerr << "Failed to open a GLFW window." << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	if (gladLoadGL(glfwGetProcAddress) == 0)
+	{
+		std::cerr << "Failed to initialize OpenGL context." << std::endl;
+		return -1;
+	}
+
+	glClearColor(163 / 255.0f, 227 / 255.0f, 255 / 255.0f, 1.0f);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	srand(benchSeed);
+	renderer.sceneSeed = benchSeed;
+	textureStreamer.initialize();
+	renderer.aspect = (float)width / height;
+	renderer.reportCulling = false;
+	renderer.initialize(width, height);
+	if (!textureStreamer.finish()) {
+		std::cerr << "Benchmarking with textures that failed to stream" << std::endl;
+	}
+
+	Framebuffer target;
+	target.initialize(width, height);
+
+	std::vector<CaseResult> results;
+	for (BenchScene scene : scenes) {
+		for (int boxes : sceneSizes) {
+			for (AnaglyphMode mode : modes) {
+				std::cerr << sceneName(scene) << " x " << boxes << ", " << modeName(mode) << ": " << std::flush;
+				CaseResult result = runCase(target, scene, boxes, mode);
+				std::cerr << result.frameTime.mean << " ms/frame, " << result.drawCalls << " draw calls, " << result.vertices << " vertices";
+				if (renderer.useDynamicResolution) std::cerr << ", scale " << result.resolutionScale;
+				std::cerr << std::endl;
+				results.push_back(result);
+			}
+		}
+	}
+
+	if (outputPath.empty())
+	{
+		writeReport(std::cout, results);
+	}
+	else
+	{
+		std::ofstream file(outputPath);
+		writeReport(file, results);
+		if (!file)
+		{
+			std::cerr << "Cannot write " << outputPath << std::endl;
+		}
+	}
+
+	target.cleanup();
+	renderer.cleanup();
+	textureStreamer.cleanup();
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,150 @@
+// Command line compositor: turns a left/right photo pair into an anaglyph 
+// without OpenGL, and benchmarks the SIMD kernels against the scalar reference.
+
+#include <image/anaglyph_compose.h>
+#include <io/image_io.h>
+#include <util/thread_pool.h>
+
+#include <stb/stb_image.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage() {
+	std::cout << "Usage: anaglyph_compose LEFT RIGHT OUTPUT.ppm [--matrix pure|half|dubois] [--threads N]" << std::endl;
+	std::cout << "       anaglyph_compose --bench ITERATIONS [--size WxH] [--matrix ...] [--threads N]" << std::endl;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time `iterations` runs of fn and return the average seconds per run
+template <typename Fn>
+static double timeRuns(int iterations, Fn fn) {
+	fn();	// Warm up caches and page in the output
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) fn();
+	return secondsSince(start) / iterations;
+}
+
+static void printResult(const char *name, double seconds, int width, int height) {
+	double megapixels = (double)width * height / 1e6;
+	std::cout << "  " << name << ": " << seconds * 1e3 << " ms/pair, " 
+		<< megapixels / seconds << " MP/s, " << 1.0 / seconds << " pairs/s" << std::endl;
+}
+
+static int runBenchmark(int iterations, int width, int height, const AnaglyphMatrices &matrices, ThreadPool &pool) {
+	size_t size = (size_t)width * height * 3;
+	std::vector<uint8_t> left(size), right(size), reference(size), output(size);
+	srand(2024);
+	for (size_t i = 0; i < size; ++i) {
+		left[i] = (uint8_t)rand();
+		right[i] = (uint8_t)rand();
+	}
+
+	std::cout << "Compositing " << width << "x" << height << " pairs, kernel " << ComposeKernelName() 
+		<< ", " << pool.threadCount() << " threads" << std::endl;
+
+	double scalarTime = timeRuns(std::max(1, iterations / 10), [&] {
+		ComposeAnaglyphScalar(left.data(), right.data(), reference.data(), (size_t)width * height, matrices);
+	});
+	printResult("scalar reference", scalarTime, width, height);
+
+	double simdTime = timeRuns(iterations, [&] {
+		ComposeAnaglyph(left.data(), right.data(), output.data(), width, height, matrices, NULL);
+	});
+	printResult("simd, 1 thread", simdTime, width, height);
+	bool match = memcmp(output.data(), reference.data(), size) == 0;
+
+	memset(output.data(), 0, size);
+	double parallelTime = timeRuns(iterations, [&] {
+		ComposeAnaglyph(left.data(), right.data(), output.data(), width, height, matrices, &pool);
+	});
+	printResult("simd, all threads", parallelTime, width, height);
+	match = match && memcmp(output.data(), reference.data(), size) == 0;
+
+	std::cout << "  speedup vs scalar: " << scalarTime / simdTime << "x (1 thread), " 
+		<< scalarTime / parallelTime << "x (all threads)" << std::endl;
+	std::cout << "  output matches reference: " << (match ? "yes" : "NO") << std::endl;
+	return match ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+	std::vector<std::string> paths;
+	AnaglyphMatrix matrix = PureRedCyan;
+	int threads = 0;
+	int benchIterations = 0;
+	int width = 4000, height = 3000;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--matrix" && hasValue) {
+			std::string name = argv[++i];
+			if (name == "pure") matrix = PureRedCyan;
+			else if (name == "half") matrix = HalfColorRedCyan;
+			else if (name == "dubois") matrix = DuboisRedCyan;
+			else { printUsage(); return -1; }
+		} else if (arg == "--threads" && hasValue) {
+			threads = atoi(argv[++i]);
+		} else if (arg == "--bench" && hasValue) {
+			benchIterations = atoi(argv[++i]);
+		} else if (arg == "--size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				printUsage();
+				return -1;
+			}
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			printUsage();
+			return -1;
+		} else {
+			paths.push_back(arg);
+		}
+	}
+
+	ThreadPool pool;
+	pool.initialize(threads);
+	const AnaglyphMatrices &matrices = GetAnaglyphMatrices(matrix);
+
+	if (benchIterations > 0) {
+		return runBenchmark(benchIterations, width, height, matrices, pool);
+	}
+
+	if (paths.size() != 3) {
+		printUsage();
+		return -1;
+	}
+
+	int leftWidth, leftHeight, rightWidth, rightHeight, channels;
+	uint8_t *left = stbi_load(paths[0].c_str(), &leftWidth, &leftHeight, &channels, 3);
+	uint8_t *right = stbi_load(paths[1].c_str(), &rightWidth, &rightHeight, &channels, 3);
+	if (!left || !right) {
+		std::cerr << "Failed to load " << (left ? paths[1] : paths[0]) << std::endl;
+		stbi_image_free(left);
+		stbi_image_free(right);
+		return -1;
+	}
+	if (leftWidth != rightWidth || leftHeight != rightHeight) {
+		std::cerr << "Left and right images differ in size." << std::endl;
+		stbi_image_free(left);
+		stbi_image_free(right);
+		return -1;
+	}
+
+	std::vector<uint8_t> output((size_t)leftWidth * leftHeight * 3);
+	auto start = std::chrono::steady_clock::now();
+	ComposeAnaglyph(left, right, output.data(), leftWidth, leftHeight, matrices, &pool);
+	std::cout << strAnaglyphMatrix[matrix] << " anaglyph of " << leftWidth << "x" << leftHeight 
+		<< " in " << secondsSince(start) * 1e3 << " ms (" << ComposeKernelName() << ")" << std::endl;
+
+	stbi_image_free(left);
+	stbi_image_free(right);
+
+	return WritePPM(paths[2], leftWidth, leftHeight, output.data(), false) ? 0 : -1;
+}
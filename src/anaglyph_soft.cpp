@@ -0,0 +1,400 @@
+// Software renderer: draws the viewer's scene and its red/cyan composite on
+// the CPU, with the tile-parallel rasterizer or the ray tracer, for machines
+// without a GPU, for high-quality stills and as a reference the GL output can
+// be checked against.
+
+#include <image/anaglyph_compose.h>
+#include <image/image_metrics.h>
+#include <io/frame_writer.h>
+#include <io/image_io.h>
+#include <raster/soft_rasterizer.h>
+#include <scene/instance_store.h>
+#include <scene/primitives.h>
+#include <scene/scene_snapshot.h>
+#include <scene/stereo_camera.h>
+#include <trace/ray_tracer.h>
+#include <util/thread_pool.h>
+
+#include <stb/stb_image.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int frameCount = 1;
+static float frameRate = 30.0f;			// Fixed timestep of the camera orbit
+static std::string outputPrefix = "soft";	// PPM sequence prefix, or a .y4m/.rgb video file
+static int width = 1024;
+static int height = 768;
+static AnaglyphMode anaglyphMode = None;
+static int numBoxes = 1;
+static bool useSphereScene = false;
+static bool useLevelOfDetail = true;	// Spheres pick their level as the GL renderer does
+static bool rotating = false;
+static int threads = 0;
+static std::string comparePath;			// GL frame to compare the first frame against
+static double tolerance = 2.0;			// Largest mean absolute error --compare accepts
+static bool measureScaling = false;
+static bool useRayTracing = false;		// Ray trace analytic boxes or spheres instead of rasterizing meshes
+static std::string loadScenePath;		// Snapshot to load instead of generating the scene, empty for none
+static std::string saveScenePath;		// Write the scene and its BVH here, empty for none
+
+static const uint64_t sceneSeed = 2024;
+static const float ipd = 2.0f;
+static const float viewDistance = 100.0f;
+
+// The scene and what it is drawn with
+struct SoftScene {
+	InstanceStore instances;
+	SoftMesh mesh;
+	SoftTexture texture;
+	bool textured = false;
+	std::vector<unsigned char> levels;		// Per instance, for the sphere
+	RayTracer tracer;
+};
+
+// Work of one frame, summed over both eyes
+struct FrameStats {
+	SoftStats raster;
+	RayTracerStats trace;
+};
+
+static void printUsage() {
+	std::cout << "Usage: anaglyph_soft [--frames N] [--fps F] [--output PREFIX|FILE.y4m|FILE.rgb] [--width W] [--height H]" << std::endl;
+	std::cout << "                     [--mode none|toein|asymmetric] [--boxes N] [--spheres] [--no-lod] [--rotate] [--threads N]" << std::endl;
+	std::cout << "                     [--ray-trace] [--compare GL_FRAME.ppm] [--tolerance MAE] [--scaling]" << std::endl;
+	std::cout << "                     [--scene FILE.ascene] [--save-scene FILE.ascene]" << std::endl;
+}
+
+static bool parseArguments(int argc, char **argv) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--frames" && hasValue) {
+			frameCount = atoi(argv[++i]);
+		} else if (arg == "--fps" && hasValue) {
+			frameRate = (float)atof(argv[++i]);
+		} else if (arg == "--output" && hasValue) {
+			outputPrefix = argv[++i];
+		} else if (arg == "--width" && hasValue) {
+			width = atoi(argv[++i]);
+		} else if (arg == "--height" && hasValue) {
+			height = atoi(argv[++i]);
+		} else if (arg == "--mode" && hasValue) {
+			std::string mode = argv[++i];
+			if (mode == "none") anaglyphMode = None;
+			else if (mode == "toein") anaglyphMode = ToeIn;
+			else if (mode == "asymmetric") anaglyphMode = Asymmetric;
+			else return false;
+		} else if (arg == "--boxes" && hasValue) {
+			numBoxes = atoi(argv[++i]);
+		} else if (arg == "--spheres") {
+			useSphereScene = true;
+		} else if (arg == "--no-lod") {
+			useLevelOfDetail = false;
+		} else if (arg == "--rotate") {
+			rotating = true;
+		} else if (arg == "--threads" && hasValue) {
+			threads = atoi(argv[++i]);
+		} else if (arg == "--compare" && hasValue) {
+			comparePath = argv[++i];
+		} else if (arg == "--tolerance" && hasValue) {
+			tolerance = atof(argv[++i]);
+		} else if (arg == "--scaling") {
+			measureScaling = true;
+		} else if (arg == "--ray-trace") {
+			useRayTracing = true;
+		} else if (arg == "--scene" && hasValue) {
+			loadScenePath = argv[++i];
+		} else if (arg == "--save-scene" && hasValue) {
+			saveScenePath = argv[++i];
+		} else {
+			return false;
+		}
+	}
+	bool fitsRasterizer = width <= SoftRasterizer::maxViewportSize && height <= SoftRasterizer::maxViewportSize;
+	return width > 0 && height > 0 && (fitsRasterizer || useRayTracing) && numBoxes > 0 && frameCount >= 0 && frameRate > 0 && threads >= 0 && tolerance >= 0;
+}
+
+// The instances, mesh and texture the viewer would draw with the same options
+static bool buildScene(SoftScene &scene, ThreadPool &pool) {
+	if (!loadScenePath.empty()) {
+		auto start = std::chrono::steady_clock::now();
+		SceneSnapshot snapshot;
+		if (!snapshot.open(loadScenePath)) {
+			std::cerr << "Failed to open scene snapshot " << loadScenePath << std::endl;
+			return false;
+		}
+		useSphereScene = snapshot.header->mesh == SnapshotSphere;
+		snapshot.load(scene.instances, NULL);
+		std::cout << "Loaded " << scene.instances.size() << " instances from " << loadScenePath << " in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	} else if (numBoxes == 1) {
+		// One box of scale 16 at the origin, as SceneRenderer::generateScene()
+		InstanceStore &instances = scene.instances;
+		instances.resize(1);
+		instances.positionX[0] = instances.positionY[0] = instances.positionZ[0] = 0.0f;
+		instances.scale[0] = 16.0f;
+		instances.axisX[0] = instances.axisY[0] = 0.0f;
+		instances.axisZ[0] = 1.0f;
+		instances.angle[0] = 0.0f;
+		instances.colors[0] = 0xffffffffu;
+		instances.updateTransform(0);
+	} else {
+		GenerateRandomInstances(scene.instances, numBoxes, sceneSeed, &pool);
+	}
+
+	if (!saveScenePath.empty()) {
+		// With the BVH the viewer culls with, so it does not build one either
+		BVH bvh;
+		bvh.build(scene.instances.bounds);
+		if (!WriteSceneSnapshot(saveScenePath, scene.instances, &bvh, useSphereScene ? SnapshotSphere : SnapshotBox)) {
+			std::cerr << "Failed to write scene snapshot " << saveScenePath << std::endl;
+			return false;
+		}
+		std::cout << "Saved " << scene.instances.size() << " instances to " << saveScenePath << std::endl;
+	}
+
+	MeshData mesh;
+	if (useSphereScene) {
+		// The viewer seeds rand() the same way before building the sphere's colors
+		srand(2024);
+		BuildSphereMesh(mesh);
+	} else {
+		BuildBoxMesh(mesh);
+	}
+	if (!scene.mesh.load(mesh.view())) {
+		std::cerr << "Failed to decode the model mesh." << std::endl;
+		return false;
+	}
+
+	if (!useSphereScene) {
+		int textureWidth, textureHeight, channels;
+		uint8_t *rgb = stbi_load("../src/facade4.jpg", &textureWidth, &textureHeight, &channels, 3);
+		if (rgb) {
+			scene.texture.load(rgb, textureWidth, textureHeight);
+			scene.textured = true;
+		} else {
+			std::cout << "Failed to load texture ../src/facade4.jpg" << std::endl;
+		}
+		stbi_image_free(rgb);
+	}
+	scene.levels.assign(scene.instances.size(), 0);
+
+	if (useRayTracing) {
+		RayTracer &tracer = scene.tracer;
+		tracer.model = useSphereScene ? TracedSphere : TracedBox;
+		tracer.texture = scene.textured ? &scene.texture : NULL;
+		tracer.build(scene.instances.transforms.data(), scene.instances.colors.data(), scene.instances.size(), &pool);
+		std::cout << "Built the ray tracing hierarchy over " << scene.instances.size() << " instances in "
+			<< tracer.stats.buildMilliseconds << " ms" << std::endl;
+	}
+	return true;
+}
+
+// The viewer's camera after `time` seconds on its orbit
+static StereoCamera cameraAt(float time) {
+	StereoCamera camera;
+	camera.FoV = 45;
+	camera.zNear = 0.1f;
+	camera.zFar = 1000.0f;
+	camera.aspect = (float)width / height;
+	camera.projectionMatrix = glm::perspective(glm::radians(camera.FoV), camera.aspect, camera.zNear, camera.zFar);
+	camera.eyeCenter = glm::vec3(0, 0, viewDistance);
+	if (rotating) {
+		float azimuth = (float)M_PI / 2 + time;
+		camera.eyeCenter = glm::vec3(viewDistance * cos(azimuth), 0, viewDistance * sin(azimuth));
+	}
+	camera.lookat = glm::vec3(0, 0, 0);
+	camera.up = glm::vec3(0, 1, 0);
+	camera.viewDistance = viewDistance;
+	camera.ipd = ipd;
+	camera.anaglyphMode = anaglyphMode;
+	return camera;
+}
+
+// Draw both eyes and compose them into `output`, rows bottom-up as the GL
+// readback returns them. Mono mode draws and outputs the left eye only.
+static void renderFrame(SoftScene &scene, const StereoCamera &camera, SoftRasterizer &rasterizer, SoftTarget &left, SoftTarget &right,
+	std::vector<unsigned char> &output, ThreadPool *pool, FrameStats &stats) {
+	glm::mat4 vpLeft, vpRight;
+	ComputeStereoViewProjections(camera, vpLeft, vpRight);
+
+	const InstanceStore &instances = scene.instances;
+	if (useSphereScene && useLevelOfDetail && !useRayTracing) {
+		float pixelScale = 0.5f * height / tan(glm::radians(camera.FoV / 2.0f));
+		for (size_t i = 0; i < instances.size(); ++i) {
+			scene.levels[i] = (unsigned char)scene.mesh.selectLevel(instances.transforms[i], vpLeft, vpRight, pixelScale, 0.5f);
+		}
+	}
+
+	const SoftTexture *texture = scene.textured ? &scene.texture : NULL;
+	stats = FrameStats();
+	auto draw = [&](const glm::mat4 &viewProjection, SoftTarget &target) {
+		if (useRayTracing) {
+			RayTracer &tracer = scene.tracer;
+			tracer.render(viewProjection, target, pool);
+			stats.trace.rays += tracer.stats.rays;
+			stats.trace.hits += tracer.stats.hits;
+			stats.trace.nodesVisited += tracer.stats.nodesVisited;
+			stats.trace.instancesTested += tracer.stats.instancesTested;
+			stats.trace.traceMilliseconds += tracer.stats.traceMilliseconds;
+			return;
+		}
+		rasterizer.render(scene.mesh, texture, instances.transforms.data(), instances.colors.data(), scene.levels.data(), instances.size(),
+			viewProjection, target, pool);
+		stats.raster.triangles += rasterizer.stats.triangles;
+		stats.raster.rasterized += rasterizer.stats.rasterized;
+		stats.raster.binned += rasterizer.stats.binned;
+		stats.raster.fragments += rasterizer.stats.fragments;
+		stats.raster.setupMilliseconds += rasterizer.stats.setupMilliseconds;
+		stats.raster.rasterMilliseconds += rasterizer.stats.rasterMilliseconds;
+	};
+
+	draw(vpLeft, left);
+	output.resize(left.color.size());
+	if (camera.anaglyphMode == None) {
+		std::copy(left.color.begin(), left.color.end(), output.begin());
+		return;
+	}
+	draw(vpRight, right);
+	ComposeAnaglyph(left.color.data(), right.color.data(), output.data(), width, height, GetAnaglyphMatrices(PureRedCyan), pool);
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time the first frame at 1, 2, 4, ... threads up to the hardware's
+static void runScaling(SoftScene &scene) {
+	int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<int> counts;
+	for (int n = 1; n < hardwareThreads; n *= 2) counts.push_back(n);
+	counts.push_back(hardwareThreads);
+
+	SoftRasterizer rasterizer;
+	SoftTarget left, right;
+	left.resize(width, height);
+	right.resize(width, height);
+	std::vector<unsigned char> output;
+	StereoCamera camera = cameraAt(0.0f);
+	FrameStats stats;
+
+	std::cout << "Scaling at " << width << "x" << height << ", " << scene.instances.size() << " instances:" << std::endl;
+	double serialTime = 0;
+	for (int count : counts) {
+		ThreadPool pool;
+		pool.initialize(count);
+		renderFrame(scene, camera, rasterizer, left, right, output, &pool, stats);	// Warm up
+
+		int iterations = 0;
+		auto start = std::chrono::steady_clock::now();
+		do {
+			renderFrame(scene, camera, rasterizer, left, right, output, &pool, stats);
+			++iterations;
+		} while (secondsSince(start) < 1.0 && iterations < 100);
+		double frameTime = secondsSince(start) / iterations;
+		if (count == 1) serialTime = frameTime;
+
+		std::cout << "  " << count << " threads: " << frameTime * 1e3 << " ms/frame, " << 1.0 / frameTime << " fps, speedup "
+			<< serialTime / frameTime << "x";
+		if (useRayTracing) std::cout << ", " << stats.trace.rays / frameTime / 1e6 << " Mrays/s";
+		std::cout << std::endl;
+	}
+}
+
+// Mean absolute error of the frame against a GL frame of the same options
+static bool compareWithReference(const std::vector<unsigned char> &frame) {
+	int referenceWidth, referenceHeight;
+	std::vector<unsigned char> reference;
+	if (!ReadPPM(comparePath, referenceWidth, referenceHeight, reference, true)) {
+		std::cerr << "Failed to read " << comparePath << std::endl;
+		return false;
+	}
+	if (referenceWidth != width || referenceHeight != height) {
+		std::cerr << comparePath << " is " << referenceWidth << "x" << referenceHeight << ", expected " << width << "x" << height << std::endl;
+		return false;
+	}
+	ImageDifference difference = CompareImages(frame.data(), reference.data(), frame.size());
+	bool match = difference.meanAbsoluteError <= tolerance;
+	std::cout << "Compared with " << comparePath << ": mean absolute error " << difference.meanAbsoluteError << ", PSNR "
+		<< difference.psnr << " dB, " << difference.differingFraction * 100 << "% of values differ by more than 8 ("
+		<< (match ? "within" : "OVER") << " tolerance " << tolerance << ")" << std::endl;
+	return match;
+}
+
+int main(int argc, char **argv) {
+	if (!parseArguments(argc, argv)) {
+		printUsage();
+		return -1;
+	}
+
+	ThreadPool pool;
+	pool.initialize(threads);
+
+	SoftScene scene;
+	if (!buildScene(scene, pool)) return -1;
+
+	if (measureScaling) {
+		runScaling(scene);
+		return 0;
+	}
+
+	SoftRasterizer rasterizer;
+	SoftTarget left, right;
+	left.resize(width, height);
+	right.resize(width, height);
+
+	FrameWriter writer;
+	writer.start(outputPrefix, FrameFormatForPath(outputPrefix), frameRate, 8);
+
+	bool match = true;
+	FrameStats stats, total;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frameCount; ++i) {
+		Frame frame;
+		frame.index = i;
+		frame.width = width;
+		frame.height = height;
+		frame.pixels = writer.acquireBuffer();
+		renderFrame(scene, cameraAt(i / frameRate), rasterizer, left, right, frame.pixels, &pool, stats);
+		if (i == 0 && !comparePath.empty()) {
+			match = compareWithReference(frame.pixels);
+		}
+		writer.push(std::move(frame));
+
+		total.raster.triangles += stats.raster.triangles;
+		total.raster.rasterized += stats.raster.rasterized;
+		total.raster.fragments += stats.raster.fragments;
+		total.raster.setupMilliseconds += stats.raster.setupMilliseconds;
+		total.raster.rasterMilliseconds += stats.raster.rasterMilliseconds;
+		total.trace.rays += stats.trace.rays;
+		total.trace.nodesVisited += stats.trace.nodesVisited;
+		total.trace.instancesTested += stats.trace.instancesTested;
+		total.trace.traceMilliseconds += stats.trace.traceMilliseconds;
+	}
+	double renderTime = secondsSince(start);
+	writer.finish();
+
+	if (frameCount > 0 && useRayTracing) {
+		const RayTracerStats &trace = total.trace;
+		std::cout << "Traced " << frameCount << " frames at " << width << "x" << height << " on " << pool.threadCount() << " threads in "
+			<< renderTime << " s (" << frameCount / renderTime << " fps), " << trace.rays / (trace.traceMilliseconds * 1e3) << " Mrays/s, "
+			<< (double)trace.nodesVisited / std::max(trace.rays, 1LL) << " nodes and " << (double)trace.instancesTested / std::max(trace.rays, 1LL)
+			<< " instances tested per ray" << std::endl;
+	} else if (frameCount > 0) {
+		const SoftStats &raster = total.raster;
+		std::cout << "Rendered " << frameCount << " frames at " << width << "x" << height << " on " << pool.threadCount() << " threads in "
+			<< renderTime << " s (" << frameCount / renderTime << " fps), setup " << raster.setupMilliseconds / frameCount << " ms, raster "
+			<< raster.rasterMilliseconds / frameCount << " ms per frame, " << raster.rasterized / frameCount << " of "
+			<< raster.triangles / frameCount << " triangles and " << raster.fragments / frameCount << " fragments per frame" << std::endl;
+	}
+	return writer.failed || !match ? 1 : 0;
+}
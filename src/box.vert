@@ -8,6 +8,9 @@ layout(location = 2) in vec2 vertexUV;
 // Matrix for vertex transformation
 uniform mat4 MVP;
 
+// Color of this box, multiplied into the vertex colors
+uniform vec4 tint;
+
 // Output data, to be interpolated for each fragment
 out vec3 color;
 out vec2 uv;
@@ -17,6 +20,6 @@ void main() {
     gl_Position =  MVP * vec4(vertexPosition, 1);
     
     // Pass vertex color to the fragment shader
-    color = vertexColor;
+    color = vertexColor * tint.rgb;
     uv = vertexUV;
 }
@@ -0,0 +1,39 @@
+#version 330 core
+
+// Input
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 2) in vec2 vertexUV;
+layout(location = 3) in mat4 instanceModel;	// Per-instance model matrix, occupies locations 3-6
+layout(location = 7) in vec4 instanceColor;	// Per-instance tint, multiplied into the vertex colors
+
+// View-projection matrices shared by all instances. VP[1] is only used in stereo mode.
+uniform mat4 VP[2];
+
+// 0: single view. 1: every instance is drawn twice, even instances for the left eye 
+// into the left half of the target, odd instances for the right eye into the right half.
+uniform int stereo;
+
+// Output data, to be interpolated for each fragment
+out vec3 color;
+out vec2 uv;
+
+void main() {
+    int eye = stereo * (gl_InstanceID & 1);
+
+    // Transform vertex
+    vec4 position = VP[eye] * instanceModel * vec4(vertexPosition, 1);
+
+    if (stereo != 0) {
+        // Clip against the inner edge of the eye's half, then squeeze x into that half
+        gl_ClipDistance[0] = (eye == 0) ? position.w - position.x : position.w + position.x;
+        position.x = 0.5 * position.x + ((eye == 0) ? -0.5 : 0.5) * position.w;
+    } else {
+        gl_ClipDistance[0] = 1.0;
+    }
+    gl_Position = position;
+    
+    // Pass vertex color to the fragment shader
+    color = vertexColor * instanceColor.rgb;
+    uv = vertexUV;
+}
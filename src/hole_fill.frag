@@ -0,0 +1,47 @@
+#version 330 core
+
+in vec2 uv;
+
+uniform sampler2D warpedColor;      // Alpha 0 where no left-eye pixel landed
+uniform sampler2D warpedDepth;
+uniform int searchRadius;
+
+out vec3 finalColor;
+
+void main()
+{
+    ivec2 size = textureSize(warpedColor, 0);
+    ivec2 pixel = min(ivec2(uv * vec2(size)), size - 1);
+    vec4 warped = texelFetch(warpedColor, pixel, 0);
+    if (warped.a > 0.0)
+    {
+        finalColor = warped.rgb;
+        return;
+    }
+
+    // A disocclusion shows what was behind the foreground in the left eye, so 
+    // take the farther of the nearest written pixels to the left and right
+    vec3 best = vec3(0.0);
+    float bestDepth = -1.0;
+    for (int side = -1; side <= 1; side += 2)
+    {
+        for (int i = 1; i <= searchRadius; ++i)
+        {
+            ivec2 neighbor = pixel + ivec2(side * i, 0);
+            if (neighbor.x < 0 || neighbor.x >= size.x)
+                break;
+            vec4 neighborColor = texelFetch(warpedColor, neighbor, 0);
+            if (neighborColor.a > 0.0)
+            {
+                float depth = texelFetch(warpedDepth, neighbor, 0).r;
+                if (depth > bestDepth)
+                {
+                    best = neighborColor.rgb;
+                    bestDepth = depth;
+                }
+                break;
+            }
+        }
+    }
+    finalColor = best;
+}
@@ -0,0 +1,265 @@
+#include "anaglyph_compose.h"
+
+#include <util/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ANAGLYPH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ANAGLYPH_TARGET(x)
+#else
+#define ANAGLYPH_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+const char *strAnaglyphMatrix[] = {
+	"Pure red/cyan",
+	"Half-color red/cyan",
+	"Dubois red/cyan",
+	"Invalid",
+};
+
+static const AnaglyphMatrices anaglyphMatrices[AnaglyphMatrixCount] = {
+	{
+		{ { 1, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } },
+		{ { 0, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+	},
+	{
+		{ { 0.299f, 0.587f, 0.114f }, { 0, 0, 0 }, { 0, 0, 0 } },
+		{ { 0, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+	},
+	{
+		{ { 0.456f, 0.500f, 0.176f }, { -0.040f, -0.038f, -0.016f }, { -0.015f, -0.021f, -0.005f } },
+		{ { -0.043f, -0.088f, -0.002f }, { 0.378f, 0.734f, -0.018f }, { -0.072f, -0.113f, 1.226f } },
+	},
+};
+
+const AnaglyphMatrices &GetAnaglyphMatrices(AnaglyphMatrix matrix) {
+	return anaglyphMatrices[matrix];
+}
+
+// Coefficients in 12-bit fixed point. The largest sum (3 * 1.23 * 4096 * 255 * 2) fits in 32 bits.
+static const int fixedShift = 12;
+
+struct FixedMatrices {
+	int left[3][3];
+	int right[3][3];
+};
+
+static FixedMatrices toFixed(const AnaglyphMatrices &matrices) {
+	FixedMatrices fixed;
+	for (int c = 0; c < 3; ++c) {
+		for (int k = 0; k < 3; ++k) {
+			fixed.left[c][k] = (int)lroundf(matrices.left[c][k] * (1 << fixedShift));
+			fixed.right[c][k] = (int)lroundf(matrices.right[c][k] * (1 << fixedShift));
+		}
+	}
+	return fixed;
+}
+
+static inline uint8_t composeByte(const uint8_t *left, const uint8_t *right, size_t i, const FixedMatrices &m) {
+	int c = (int)(i % 3);
+	size_t base = i - c;
+	int sum = 1 << (fixedShift - 1);
+	for (int k = 0; k < 3; ++k) {
+		sum += m.left[c][k] * left[base + k] + m.right[c][k] * right[base + k];
+	}
+	return (uint8_t)std::min(std::max(sum >> fixedShift, 0), 255);
+}
+
+void ComposeAnaglyphScalar(const uint8_t *left, const uint8_t *right, uint8_t *output, size_t pixelCount, const AnaglyphMatrices &matrices) {
+	FixedMatrices m = toFixed(matrices);
+	for (size_t i = 0; i < pixelCount * 3; ++i) {
+		output[i] = composeByte(left, right, i, m);
+	}
+}
+
+// The SIMD kernels work on the RGB bytes as one flat stream. Output byte i 
+// (channel c = i % 3) reads inputs i - c .. i - c + 2, i.e. offsets -2..+2 
+// with zero weights outside its own pixel, so a vector of consecutive output 
+// bytes is the sum of five shifted unaligned loads times per-lane weights. 
+// The weights only depend on the phase of the first byte modulo 3.
+
+#ifdef ANAGLYPH_X86
+
+// Per-lane weights for offset d - 2 and phase p, interleaved (left, right) to feed madd
+static void buildLaneWeights(const FixedMatrices &m, int lanes, int phase, int d, int16_t *weights) {
+	for (int j = 0; j < lanes; ++j) {
+		int c = (phase + j) % 3;
+		int k = c + d - 2;
+		bool inside = k >= 0 && k < 3;
+		weights[2 * j] = (int16_t)(inside ? m.left[c][k] : 0);
+		weights[2 * j + 1] = (int16_t)(inside ? m.right[c][k] : 0);
+	}
+}
+
+ANAGLYPH_TARGET("avx2")
+static size_t composeAVX2(const uint8_t *left, const uint8_t *right, uint8_t *output, size_t begin, size_t end, size_t total, const FixedMatrices &m) {
+	// 16 output bytes per step. After cvtepu8_epi16 + unpacklo/hi the lanes hold 
+	// bytes [0-3 | 8-11] and [4-7 | 12-15], so the weights are laid out the same way.
+	__m256i weightsLo[3][5], weightsHi[3][5];
+	for (int phase = 0; phase < 3; ++phase) {
+		for (int d = 0; d < 5; ++d) {
+			alignas(32) int16_t w[32];
+			buildLaneWeights(m, 16, phase, d, w);
+			int16_t lo[16], hi[16];
+			for (int j = 0; j < 4; ++j) {
+				for (int half = 0; half < 2; ++half) {
+					lo[8 * half + 2 * j] = w[2 * (8 * half + j)];
+					lo[8 * half + 2 * j + 1] = w[2 * (8 * half + j) + 1];
+					hi[8 * half + 2 * j] = w[2 * (8 * half + 4 + j)];
+					hi[8 * half + 2 * j + 1] = w[2 * (8 * half + 4 + j) + 1];
+				}
+			}
+			weightsLo[phase][d] = _mm256_loadu_si256((const __m256i *)lo);
+			weightsHi[phase][d] = _mm256_loadu_si256((const __m256i *)hi);
+		}
+	}
+
+	const __m256i rounding = _mm256_set1_epi32(1 << (fixedShift - 1));
+	size_t i = std::max(begin, (size_t)2);
+	int phase = (int)(i % 3);
+	for (; i + 16 <= end && i + 18 <= total; i += 16) {
+		__m256i sumLo = rounding;
+		__m256i sumHi = rounding;
+		for (int d = 0; d < 5; ++d) {
+			__m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(left + i + d - 2)));
+			__m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(right + i + d - 2)));
+			sumLo = _mm256_add_epi32(sumLo, _mm256_madd_epi16(_mm256_unpacklo_epi16(l, r), weightsLo[phase][d]));
+			sumHi = _mm256_add_epi32(sumHi, _mm256_madd_epi16(_mm256_unpackhi_epi16(l, r), weightsHi[phase][d]));
+		}
+		sumLo = _mm256_srai_epi32(sumLo, fixedShift);
+		sumHi = _mm256_srai_epi32(sumHi, fixedShift);
+		__m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(sumLo, sumHi), _mm256_setzero_si256());
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i *)(output + i), _mm256_castsi256_si128(packed));
+		phase = (phase + 1) % 3;
+	}
+	return i;
+}
+
+ANAGLYPH_TARGET("sse4.1")
+static size_t composeSSE41(const uint8_t *left, const uint8_t *right, uint8_t *output, size_t begin, size_t end, size_t total, const FixedMatrices &m) {
+	// 8 output bytes per step, unpacklo/hi hold bytes 0-3 and 4-7
+	__m128i weightsLo[3][5], weightsHi[3][5];
+	for (int phase = 0; phase < 3; ++phase) {
+		for (int d = 0; d < 5; ++d) {
+			alignas(16) int16_t w[16];
+			buildLaneWeights(m, 8, phase, d, w);
+			weightsLo[phase][d] = _mm_load_si128((const __m128i *)w);
+			weightsHi[phase][d] = _mm_load_si128((const __m128i *)(w + 8));
+		}
+	}
+
+	const __m128i rounding = _mm_set1_epi32(1 << (fixedShift - 1));
+	size_t i = std::max(begin, (size_t)2);
+	int phase = (int)(i % 3);
+	for (; i + 8 <= end && i + 10 <= total; i += 8) {
+		__m128i sumLo = rounding;
+		__m128i sumHi = rounding;
+		for (int d = 0; d < 5; ++d) {
+			__m128i l = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(left + i + d - 2)));
+			__m128i r = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(right + i + d - 2)));
+			sumLo = _mm_add_epi32(sumLo, _mm_madd_epi16(_mm_unpacklo_epi16(l, r), weightsLo[phase][d]));
+			sumHi = _mm_add_epi32(sumHi, _mm_madd_epi16(_mm_unpackhi_epi16(l, r), weightsHi[phase][d]));
+		}
+		sumLo = _mm_srai_epi32(sumLo, fixedShift);
+		sumHi = _mm_srai_epi32(sumHi, fixedShift);
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(sumLo, sumHi), _mm_setzero_si128());
+		_mm_storel_epi64((__m128i *)(output + i), packed);
+		phase = (phase + 2) % 3;
+	}
+	return i;
+}
+
+enum Kernel { KernelScalar, KernelSSE41, KernelAVX2 };
+
+static Kernel detectKernel() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse41 = __builtin_cpu_supports("sse4.1");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	return avx2 ? KernelAVX2 : (sse41 ? KernelSSE41 : KernelScalar);
+}
+
+#else
+
+enum Kernel { KernelScalar };
+
+static Kernel detectKernel() {
+	return KernelScalar;
+}
+
+#endif
+
+static Kernel activeKernel() {
+	static Kernel kernel = detectKernel();
+	return kernel;
+}
+
+const char *ComposeKernelName() {
+	switch (activeKernel()) {
+#ifdef ANAGLYPH_X86
+	case KernelAVX2: return "avx2";
+	case KernelSSE41: return "sse4.1";
+#endif
+	default: return "scalar";
+	}
+}
+
+// Compose output bytes [begin, end) of a stream of `total` bytes
+static void composeRange(const uint8_t *left, const uint8_t *right, uint8_t *output, size_t begin, size_t end, size_t total, const FixedMatrices &m) {
+	size_t i = begin;
+
+	// The vector loops need two bytes of slack on either side for the shifted loads
+	size_t head = std::min(end, std::max(begin, (size_t)2));
+	for (; i < head; ++i) {
+		output[i] = composeByte(left, right, i, m);
+	}
+
+	switch (activeKernel()) {
+#ifdef ANAGLYPH_X86
+	case KernelAVX2: i = composeAVX2(left, right, output, i, end, total, m); break;
+	case KernelSSE41: i = composeSSE41(left, right, output, i, end, total, m); break;
+#endif
+	default: break;
+	}
+
+	for (; i < end; ++i) {
+		output[i] = composeByte(left, right, i, m);
+	}
+}
+
+void ComposeAnaglyph(const uint8_t *left, const uint8_t *right, uint8_t *output, int width, int height, const AnaglyphMatrices &matrices, ThreadPool *pool) {
+	FixedMatrices m = toFixed(matrices);
+	size_t rowSize = (size_t)width * 3;
+	size_t total = rowSize * height;
+
+	if (!pool) {
+		composeRange(left, right, output, 0, total, total, m);
+		return;
+	}
+
+	// Enough rows per chunk to amortize scheduling, enough chunks to balance the threads
+	int grain = std::max(1, height / (pool->threadCount() * 8));
+	pool->parallelFor(0, height, grain, [&](int rowBegin, int rowEnd) {
+		composeRange(left, right, output, rowBegin * rowSize, rowEnd * rowSize, total, m);
+	});
+}
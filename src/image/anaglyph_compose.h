@@ -0,0 +1,38 @@
+#ifndef _ANAGLYPH_COMPOSE_H_
+#define _ANAGLYPH_COMPOSE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+struct ThreadPool;
+
+// Color matrices for combining a left/right pair into a red/cyan anaglyph
+enum AnaglyphMatrix {
+	PureRedCyan,		// Left red channel, right green and blue, as the two-pass color masks
+	HalfColorRedCyan,	// Left luminance in red, right green and blue
+	DuboisRedCyan,		// Least-squares fit for red/cyan filters (E. Dubois, 2001)
+	AnaglyphMatrixCount,
+};
+
+extern const char *strAnaglyphMatrix[];
+
+// output = left * leftRows + right * rightRows, rows are output R, G, B
+struct AnaglyphMatrices {
+	float left[3][3];
+	float right[3][3];
+};
+
+const AnaglyphMatrices &GetAnaglyphMatrices(AnaglyphMatrix matrix);
+
+// Scalar reference. Pixels are tightly packed 8-bit RGB.
+void ComposeAnaglyphScalar(const uint8_t *left, const uint8_t *right, uint8_t *output, size_t pixelCount, const AnaglyphMatrices &matrices);
+
+// Vectorized compositor (AVX2 or SSE4.1 chosen at runtime, scalar otherwise), 
+// split by rows across the pool when one is given. Output matches the scalar 
+// reference exactly: both use the same 12-bit fixed point arithmetic.
+void ComposeAnaglyph(const uint8_t *left, const uint8_t *right, uint8_t *output, int width, int height, const AnaglyphMatrices &matrices, ThreadPool *pool);
+
+// Name of the kernel ComposeAnaglyph() uses on this machine
+const char *ComposeKernelName();
+
+#endif
@@ -0,0 +1,27 @@
+#include "image_metrics.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+ImageDifference CompareImages(const uint8_t *a, const uint8_t *b, size_t bytes, int threshold) {
+	ImageDifference difference = { 0, std::numeric_limits<double>::infinity(), 0 };
+	if (bytes == 0) return difference;
+
+	double absoluteSum = 0, squaredSum = 0;
+	size_t differing = 0;
+	for (size_t i = 0; i < bytes; ++i) {
+		int d = abs((int)a[i] - (int)b[i]);
+		absoluteSum += d;
+		squaredSum += (double)d * d;
+		if (d > threshold) ++differing;
+	}
+
+	double meanSquaredError = squaredSum / bytes;
+	difference.meanAbsoluteError = absoluteSum / bytes;
+	if (meanSquaredError > 0) {
+		difference.psnr = 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+	}
+	difference.differingFraction = (double)differing / bytes;
+	return difference;
+}
@@ -0,0 +1,16 @@
+#ifndef _IMAGE_METRICS_H_
+#define _IMAGE_METRICS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Differences between two 8-bit images of `bytes` interleaved channel values
+struct ImageDifference {
+	double meanAbsoluteError;	// Per channel value, 0 to 255
+	double psnr;				// Peak signal-to-noise ratio in dB, infinite for identical images
+	double differingFraction;	// Share of values that differ by more than `threshold`
+};
+
+ImageDifference CompareImages(const uint8_t *a, const uint8_t *b, size_t bytes, int threshold = 8);
+
+#endif
@@ -0,0 +1,55 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <cstring>
+
+int MipLevelCount(int width, int height) {
+	int count = 1;
+	while (width > 1 || height > 1) {
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		++count;
+	}
+	return count;
+}
+
+static void downsample(const uint8_t *src, int srcWidth, int srcHeight, uint8_t *dst, int dstWidth, int dstHeight, int channels) {
+	for (int y = 0; y < dstHeight; ++y) {
+		const uint8_t *row0 = src + (size_t)std::min(2 * y, srcHeight - 1) * srcWidth * channels;
+		const uint8_t *row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcWidth * channels;
+		uint8_t *out = dst + (size_t)y * dstWidth * channels;
+		for (int x = 0; x < dstWidth; ++x) {
+			int x0 = std::min(2 * x, srcWidth - 1) * channels;
+			int x1 = std::min(2 * x + 1, srcWidth - 1) * channels;
+			for (int c = 0; c < channels; ++c) {
+				int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				out[x * channels + c] = (uint8_t)((sum + 2) >> 2);
+			}
+		}
+	}
+}
+
+void GenerateMipChain(const uint8_t *pixels, int width, int height, int channels, size_t alignment, 
+	std::vector<uint8_t> &chain, std::vector<MipLevel> &levels) {
+	int count = MipLevelCount(width, height);
+	levels.resize(count);
+
+	size_t offset = 0;
+	int levelWidth = width, levelHeight = height;
+	for (int i = 0; i < count; ++i) {
+		levels[i].width = levelWidth;
+		levels[i].height = levelHeight;
+		levels[i].offset = offset;
+		levels[i].size = (size_t)levelWidth * levelHeight * channels;
+		offset = (offset + levels[i].size + alignment - 1) / alignment * alignment;
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+
+	chain.assign(offset, 0);
+	memcpy(chain.data(), pixels, levels[0].size);
+	for (int i = 1; i < count; ++i) {
+		downsample(chain.data() + levels[i - 1].offset, levels[i - 1].width, levels[i - 1].height, 
+			chain.data() + levels[i].offset, levels[i].width, levels[i].height, channels);
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef _MIPMAP_H_
+#define _MIPMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One level of a mip chain stored back to back in a single buffer
+struct MipLevel {
+	int width;
+	int height;
+	size_t offset;		// Bytes from the start of the chain
+	size_t size;		// Tightly packed rows
+};
+
+// Number of levels down to 1x1, as glGenerateMipmap builds
+int MipLevelCount(int width, int height);
+
+// Build every level of an 8-bit image with `channels` interleaved channels. 
+// Each level halves the previous one (rounding down, at least 1) with a 2x2 box 
+// filter; the last row/column of an odd size is clamped. Level 0 is a copy of 
+// the input. Level offsets are aligned to `alignment` bytes.
+void GenerateMipChain(const uint8_t *pixels, int width, int height, int channels, size_t alignment, 
+	std::vector<uint8_t> &chain, std::vector<MipLevel> &levels);
+
+#endif
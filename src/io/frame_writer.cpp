@@ -0,0 +1,154 @@
+#include "frame_writer.h"
+#include "image_io.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static bool endsWith(const std::string &s, const std::string &suffix) {
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+FrameFormat FrameFormatForPath(const std::string &path) {
+	if (endsWith(path, ".y4m")) return Y4MVideo;
+	if (endsWith(path, ".rgb") || endsWith(path, ".raw")) return RawVideo;
+	return PPMSequence;
+}
+
+// Bottom-up RGB to top-down planar Y'CbCr 4:4:4, BT.601 studio range, in 
+// 8.8 fixed point
+static void convertToYUV444(const Frame &frame, unsigned char *out) {
+	size_t planeSize = (size_t)frame.width * frame.height;
+	unsigned char *yPlane = out, *uPlane = out + planeSize, *vPlane = out + 2 * planeSize;
+	for (int y = 0; y < frame.height; ++y) {
+		const unsigned char *src = frame.pixels.data() + (size_t)(frame.height - 1 - y) * frame.width * 3;
+		size_t row = (size_t)y * frame.width;
+		for (int x = 0; x < frame.width; ++x) {
+			int r = src[3 * x], g = src[3 * x + 1], b = src[3 * x + 2];
+			yPlane[row + x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			uPlane[row + x] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			vPlane[row + x] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+}
+
+void FrameWriter::start(const std::string &path, FrameFormat format, double frameRate, size_t capacity) {
+	this->path = path;
+	this->format = format;
+	this->frameRate = frameRate;
+	this->capacity = capacity;
+	stopping = false;
+	failed = false;
+	framesWritten = 0;
+	stalls = 0;
+	busySeconds = 0;
+	thread = std::thread(&FrameWriter::run, this);
+}
+
+void FrameWriter::push(Frame &&frame) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (queue.size() >= capacity) {
+		++stalls;
+		notFull.wait(lock, [this] { return queue.size() < capacity; });
+	}
+	queue.push_back(std::move(frame));
+	notEmpty.notify_one();
+}
+
+std::vector<unsigned char> FrameWriter::acquireBuffer() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (spareBuffers.empty()) return std::vector<unsigned char>();
+	std::vector<unsigned char> buffer = std::move(spareBuffers.back());
+	spareBuffers.pop_back();
+	return buffer;
+}
+
+void FrameWriter::finish() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	notEmpty.notify_one();
+	if (thread.joinable()) thread.join();
+
+	if (video) {
+		if (fclose(video) != 0 && !failed) {
+			std::cerr << "Failed to write " << path << "." << std::endl;
+			failed = true;
+		}
+		video = NULL;
+	}
+	spareBuffers.clear();
+}
+
+void FrameWriter::run() {
+	for (;;) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty()) return;
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+		notFull.notify_one();
+
+		auto begin = std::chrono::steady_clock::now();
+		if (!failed && write(frame)) {
+			++framesWritten;
+		}
+		busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (spareBuffers.size() < capacity) {
+			spareBuffers.push_back(std::move(frame.pixels));
+		}
+	}
+}
+
+bool FrameWriter::write(const Frame &frame) {
+	if (format == PPMSequence) {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "_%05d.ppm", frame.index);
+		if (!WritePPM(path + suffix, frame.width, frame.height, frame.pixels.data(), true)) {
+			// WritePPM() has reported the error
+			failed = true;
+			return false;
+		}
+		return true;
+	}
+	if (!writeVideo(frame)) {
+		std::cerr << "Failed to write " << path << "." << std::endl;
+		failed = true;
+		return false;
+	}
+	return true;
+}
+
+bool FrameWriter::writeVideo(const Frame &frame) {
+	if (!video) {
+		video = fopen(path.c_str(), "wb");
+		if (!video) return false;
+
+		if (format == Y4MVideo) {
+			// Frame rate as a fraction, exact for whole and NTSC-style rates
+			long numerator = lround(frameRate * 1001), denominator = 1001;
+			if (frameRate == floor(frameRate)) numerator = (long)frameRate, denominator = 1;
+			fprintf(video, "YUV4MPEG2 W%d H%d F%ld:%ld Ip A1:1 C444\n", frame.width, frame.height, numerator, denominator);
+		}
+	}
+
+	size_t size = (size_t)frame.width * frame.height * 3;
+	encoded.resize(size);
+	if (format == Y4MVideo) {
+		if (fputs("FRAME\n", video) < 0) return false;
+		convertToYUV444(frame, encoded.data());
+	} else {
+		size_t rowSize = (size_t)frame.width * 3;
+		for (int y = 0; y < frame.height; ++y) {
+			memcpy(encoded.data() + y * rowSize, frame.pixels.data() + (size_t)(frame.height - 1 - y) * rowSize, rowSize);
+		}
+	}
+	return fwrite(encoded.data(), 1, size, video) == size;
+}
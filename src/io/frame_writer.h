@@ -0,0 +1,71 @@
+#ifndef _FRAME_WRITER_H_
+#define _FRAME_WRITER_H_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A frame read back from OpenGL: tightly packed RGB, rows bottom-up
+struct Frame {
+	int index = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+};
+
+enum FrameFormat {
+	PPMSequence,	// <path>_<index>.ppm per frame
+	Y4MVideo,		// One YUV4MPEG2 stream, 4:4:4 BT.601, so the red/cyan edges keep full chroma
+	RawVideo,		// One headerless stream of top-down rgb24 frames
+};
+
+// Pick the format from the file extension: .y4m, .rgb or .raw, else a PPM sequence
+FrameFormat FrameFormatForPath(const std::string &path);
+
+// Encodes and writes frames on its own thread, so file I/O does not block the 
+// render loop. The queue is bounded; push() only waits when the disk cannot 
+// keep up for longer than the queue covers. Video formats need every frame 
+// the same size and pushed in order.
+struct FrameWriter {
+	std::string path;		// Prefix of a PPM sequence, else the video file
+	FrameFormat format = PPMSequence;
+	double frameRate = 30.0;	// Written to the Y4M header
+	size_t capacity = 8;
+
+	std::deque<Frame> queue;
+	std::vector<std::vector<unsigned char>> spareBuffers;	// Pixels of written frames, reused by acquireBuffer()
+	std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::thread thread;
+	bool stopping = false;
+
+	FILE *video = NULL;
+	std::vector<unsigned char> encoded;	// One frame in the output layout
+
+	int framesWritten = 0;
+	int stalls = 0;				// Number of push() calls that had to wait for space
+	double busySeconds = 0;		// Time the thread spent encoding and writing, not waiting
+	bool failed = false;
+
+	void start(const std::string &path, FrameFormat format, double frameRate, size_t capacity);
+	void push(Frame &&frame);
+
+	// A pixel buffer for the next frame, recycled from a written one when available
+	std::vector<unsigned char> acquireBuffer();
+
+	// Write everything still queued and stop the thread
+	void finish();
+
+	void run();
+
+private:
+	bool write(const Frame &frame);
+	bool writeVideo(const Frame &frame);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "image_io.h"
+
+#include <cstdio>
+#include <iostream>
+
+bool WritePPM(const std::string &path, int width, int height, const unsigned char *rgb, bool flipVertically) {
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		std::cerr << "Failed to open " << path << " for writing." << std::endl;
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	size_t rowSize = (size_t)width * 3;
+	bool ok = true;
+	for (int y = 0; y < height && ok; ++y) {
+		int row = flipVertically ? height - 1 - y : y;
+		ok = fwrite(rgb + row * rowSize, 1, rowSize, file) == rowSize;
+	}
+	fclose(file);
+
+	if (!ok) {
+		std::cerr << "Failed to write " << path << "." << std::endl;
+	}
+	return ok;
+}
+
+bool ReadPPM(const std::string &path, int &width, int &height, std::vector<unsigned char> &rgb, bool flipVertically) {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) {
+		std::cerr << "Failed to open " << path << "." << std::endl;
+		return false;
+	}
+
+	// The header is "P6", width, height and the largest value, separated by whitespace, then one whitespace byte
+	int maxValue = 0;
+	bool ok = fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) == 3 && fgetc(file) != EOF 
+		&& width > 0 && height > 0 && maxValue == 255;
+	if (ok) {
+		size_t rowSize = (size_t)width * 3;
+		rgb.resize(rowSize * height);
+		for (int y = 0; y < height && ok; ++y) {
+			int row = flipVertically ? height - 1 - y : y;
+			ok = fread(rgb.data() + row * rowSize, 1, rowSize, file) == rowSize;
+		}
+	}
+	fclose(file);
+
+	if (!ok) {
+		std::cerr << "Failed to read " << path << " as an 8-bit binary PPM." << std::endl;
+	}
+	return ok;
+}
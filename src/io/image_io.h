@@ -0,0 +1,15 @@
+#ifndef _IMAGE_IO_H_
+#define _IMAGE_IO_H_
+
+#include <string>
+#include <vector>
+
+// Write tightly packed 8-bit RGB pixels as a binary PPM (P6). OpenGL returns 
+// rows bottom-up, pass flipVertically to store them top-down.
+bool WritePPM(const std::string &path, int width, int height, const unsigned char *rgb, bool flipVertically);
+
+// Read a binary PPM (P6) with 8-bit samples into tightly packed RGB, with 
+// flipVertically returning the rows bottom-up as OpenGL would
+bool ReadPPM(const std::string &path, int &width, int &height, std::vector<unsigned char> &rgb, bool flipVertically);
+
+#endif
@@ -0,0 +1,94 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path) {
+	close();
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = NULL;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL) {
+		close();
+		return false;
+	}
+	data = (const unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle) CloseHandle(fileHandle);
+	data = NULL;
+	size = 0;
+	mappingHandle = fileHandle = NULL;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+	(void)offset;
+	(void)length;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+	close();
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+	data = (const unsigned char *)mapping;
+	size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) munmap((void *)data, size);
+	if (fd >= 0) ::close(fd);
+	data = NULL;
+	size = 0;
+	fd = -1;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+	if (!data || offset >= size) return;
+	// madvise wants a page-aligned start
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset & ~(pageSize - 1);
+	size_t end = offset + length < size ? offset + length : size;
+	madvise((void *)(data + start), end - start, MADV_WILLNEED);
+}
+
+#endif
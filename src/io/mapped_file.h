@@ -0,0 +1,32 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are read in on first touch, 
+// so opening is cheap and any thread may fault the data in.
+struct MappedFile {
+	const unsigned char *data = NULL;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void *fileHandle = NULL;
+	void *mappingHandle = NULL;
+#else
+	int fd = -1;
+#endif
+
+	bool open(const std::string &path);
+	void close();
+
+	// Hint that [offset, offset + length) will be read soon
+	void prefetch(size_t offset, size_t length) const;
+
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	~MappedFile() { close(); }
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "mesh_container.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+static const size_t alignment = 16;
+
+static size_t alignUp(size_t offset) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Whether [offset, offset + bytes) lies in a file of `size` bytes, without overflowing
+static bool fits(uint64_t offset, uint64_t bytes, size_t size) {
+	return offset <= size && bytes <= size - offset;
+}
+
+uint32_t MeshAttributeTypeSize(uint32_t type) {
+	switch (type) {
+	case MeshFloat32: return 4;
+	case MeshFloat16: case MeshSnorm16: case MeshUnorm16: return 2;
+	case MeshUnorm8: return 1;
+	default: return 0;
+	}
+}
+
+void MeshData::setLayout(const std::vector<MeshContainerAttribute> &attributes, uint32_t vertexStride) {
+	*this = MeshData();
+	this->attributes = attributes;
+	header.vertexStride = vertexStride;
+}
+
+void MeshData::finish() {
+	header.magic = meshContainerMagic;
+	header.version = meshContainerVersion;
+	header.attributeCount = (uint32_t)attributes.size();
+	header.levelCount = (uint32_t)levels.size();
+	header.vertexCount = header.vertexStride ? (uint32_t)(vertices.size() / header.vertexStride) : 0;
+	header.indexCount = (uint32_t)indices.size();
+	header.indexSize = sizeof(uint32_t);
+	shortIndices.clear();
+
+	for (int axis = 0; axis < 3; ++axis) {
+		header.boundsMin[axis] = FLT_MAX;
+		header.boundsMax[axis] = -FLT_MAX;
+	}
+	for (const MeshContainerAttribute &attribute : attributes) {
+		if (attribute.location != 0 || attribute.type != MeshFloat32) continue;
+		for (uint32_t v = 0; v < header.vertexCount; ++v) {
+			float position[3] = {};
+			memcpy(position, vertices.data() + (size_t)v * header.vertexStride + attribute.offset, sizeof(float) * std::min(attribute.components, 3u));
+			for (int axis = 0; axis < 3; ++axis) {
+				header.boundsMin[axis] = std::min(header.boundsMin[axis], position[axis]);
+				header.boundsMax[axis] = std::max(header.boundsMax[axis], position[axis]);
+			}
+		}
+	}
+}
+
+MeshView MeshData::view() const {
+	MeshView view;
+	view.header = &header;
+	view.attributes = attributes.data();
+	view.levels = levels.data();
+	view.vertices = vertices.data();
+	view.indices = header.indexSize == sizeof(uint16_t) ? (const unsigned char *)shortIndices.data() : (const unsigned char *)indices.data();
+	return view;
+}
+
+bool WriteMeshContainer(const std::string &path, const MeshData &mesh) {
+	MeshContainerHeader header = mesh.header;
+	size_t tableEnd = sizeof(header) + sizeof(MeshContainerAttribute) * mesh.attributes.size() + sizeof(MeshContainerLevel) * mesh.levels.size();
+	size_t vertexBytes = (size_t)header.vertexCount * header.vertexStride;
+	size_t indexBytes = (size_t)header.indexCount * header.indexSize;
+	header.vertexOffset = alignUp(tableEnd);
+	header.indexOffset = alignUp(header.vertexOffset + vertexBytes);
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	static const char padding[alignment] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 
+		&& fwrite(mesh.attributes.data(), sizeof(MeshContainerAttribute), mesh.attributes.size(), file) == mesh.attributes.size() 
+		&& fwrite(mesh.levels.data(), sizeof(MeshContainerLevel), mesh.levels.size(), file) == mesh.levels.size() 
+		&& fwrite(padding, 1, header.vertexOffset - tableEnd, file) == header.vertexOffset - tableEnd 
+		&& fwrite(mesh.vertices.data(), 1, vertexBytes, file) == vertexBytes 
+		&& fwrite(padding, 1, header.indexOffset - header.vertexOffset - vertexBytes, file) == header.indexOffset - header.vertexOffset - vertexBytes 
+		&& fwrite(mesh.view().indices, 1, indexBytes, file) == indexBytes;
+	return fclose(file) == 0 && ok;
+}
+
+bool MeshContainer::open(const std::string &path) {
+	close();
+	if (!file.open(path)) return false;
+
+	if (file.size < sizeof(MeshContainerHeader)) {
+		close();
+		return false;
+	}
+	const MeshContainerHeader *header = (const MeshContainerHeader *)file.data;
+	size_t tableEnd = sizeof(MeshContainerHeader) + sizeof(MeshContainerAttribute) * (size_t)header->attributeCount 
+		+ sizeof(MeshContainerLevel) * (size_t)header->levelCount;
+	if (header->magic != meshContainerMagic || header->version != meshContainerVersion || (header->indexSize != sizeof(uint16_t) && header->indexSize != sizeof(uint32_t)) 
+		|| header->vertexStride == 0 || header->levelCount == 0 || file.size < tableEnd 
+		|| header->vertexOffset < tableEnd || !fits(header->vertexOffset, (uint64_t)header->vertexCount * header->vertexStride, file.size) 
+		|| header->indexOffset % header->indexSize != 0 || !fits(header->indexOffset, (uint64_t)header->indexCount * header->indexSize, file.size)) {
+		close();
+		return false;
+	}
+	mesh.header = header;
+	mesh.attributes = (const MeshContainerAttribute *)(file.data + sizeof(MeshContainerHeader));
+	mesh.levels = (const MeshContainerLevel *)(mesh.attributes + header->attributeCount);
+	mesh.vertices = file.data + header->vertexOffset;
+	mesh.indices = file.data + header->indexOffset;
+
+	for (uint32_t i = 0; i < header->attributeCount; ++i) {
+		const MeshContainerAttribute &attribute = mesh.attributes[i];
+		if (MeshAttributeTypeSize(attribute.type) == 0 || attribute.components == 0 || attribute.components > 4 
+			|| attribute.offset + MeshAttributeTypeSize(attribute.type) * attribute.components > header->vertexStride) {
+			close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->levelCount; ++i) {
+		const MeshContainerLevel &level = mesh.levels[i];
+		if ((uint64_t)level.firstIndex + level.indexCount > header->indexCount || level.baseVertex < 0) {
+			close();
+			return false;
+		}
+		// Draws do not check their indices, so every vertex a level reaches must exist
+		uint32_t largest = 0;
+		for (uint32_t j = level.firstIndex; j < level.firstIndex + level.indexCount; ++j) {
+			uint32_t index = header->indexSize == sizeof(uint16_t) ? ((const uint16_t *)mesh.indices)[j] : ((const uint32_t *)mesh.indices)[j];
+			largest = std::max(largest, index);
+		}
+		if (level.indexCount > 0 && (uint64_t)level.baseVertex + largest >= header->vertexCount) {
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MeshContainer::close() {
+	file.close();
+	mesh = MeshView();
+}
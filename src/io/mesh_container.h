@@ -0,0 +1,103 @@
+#ifndef _MESH_CONTAINER_H_
+#define _MESH_CONTAINER_H_
+
+#include <io/mapped_file.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Mesh container (.amesh): interleaved vertices, indices, bounds and a level of 
+// detail table, laid out so the buffers can be uploaded straight from a mapping.
+//
+//   MeshContainerHeader
+//   MeshContainerAttribute[attributeCount]
+//   MeshContainerLevel[levelCount]
+//   vertex data, vertexCount * vertexStride bytes, 16-byte aligned
+//   index data, indexCount * indexSize bytes, 16-byte aligned
+struct MeshContainerHeader {
+	uint32_t magic;			// meshContainerMagic
+	uint32_t version;
+	uint32_t attributeCount;
+	uint32_t levelCount;
+	uint32_t vertexCount;
+	uint32_t vertexStride;	// Bytes per interleaved vertex
+	uint32_t indexCount;
+	uint32_t indexSize;		// Bytes per index, 2 or 4
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t vertexOffset;	// From the start of the file
+	uint64_t indexOffset;
+};
+
+enum MeshAttributeType {
+	MeshFloat32,
+	MeshFloat16,
+	MeshSnorm16,			// Normalized to [-1, 1]
+	MeshUnorm16,			// Normalized to [0, 1]
+	MeshUnorm8,				// Normalized to [0, 1]
+};
+
+// Bytes per component of an attribute type, 0 for unknown types
+uint32_t MeshAttributeTypeSize(uint32_t type);
+
+// One attribute of the interleaved vertex, read by the shader at `location`
+struct MeshContainerAttribute {
+	uint32_t location;
+	uint32_t components;
+	uint32_t type;			// MeshAttributeType
+	uint32_t offset;		// Within the vertex
+};
+
+// A level of detail: a range of the index buffer, finest level first
+struct MeshContainerLevel {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t baseVertex;
+	float error;			// Largest distance from the true surface, for a unit-sized mesh
+};
+
+static const uint32_t meshContainerMagic = 0x48534d41;	// "AMSH"
+static const uint32_t meshContainerVersion = 1;
+
+// Pointers to a mesh's contents, whether mapped from a container or built in memory
+struct MeshView {
+	const MeshContainerHeader *header = NULL;
+	const MeshContainerAttribute *attributes = NULL;
+	const MeshContainerLevel *levels = NULL;
+	const unsigned char *vertices = NULL;
+	const unsigned char *indices = NULL;
+};
+
+// A mesh being built or converted, before it is written out
+struct MeshData {
+	MeshContainerHeader header = {};
+	std::vector<MeshContainerAttribute> attributes;
+	std::vector<MeshContainerLevel> levels;
+	std::vector<unsigned char> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint16_t> shortIndices;		// Stored instead of indices when header.indexSize is 2
+
+	// Start an empty mesh whose vertices hold these attributes back to back
+	void setLayout(const std::vector<MeshContainerAttribute> &attributes, uint32_t vertexStride);
+
+	// Fill in the header's counts and the bounds of the position attribute (location 0). 
+	// Leaves 32-bit indices and needs float positions.
+	void finish();
+
+	MeshView view() const;
+};
+
+bool WriteMeshContainer(const std::string &path, const MeshData &mesh);
+
+// A mapped container. Opening validates the header, the tables and the index 
+// values; vertex pages are only read when the buffers are uploaded.
+struct MeshContainer {
+	MappedFile file;
+	MeshView mesh;
+
+	bool open(const std::string &path);
+	void close();
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "obj_import.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// OBJ indices start at 1 and count back from the end when negative. Returns -1 if out of range.
+static int resolveIndex(int index, size_t count) {
+	int resolved = index > 0 ? index - 1 : (int)count + index;
+	return resolved >= 0 && resolved < (int)count ? resolved : -1;
+}
+
+bool ImportOBJ(const std::string &path, MeshData &mesh) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cerr << "Cannot read " << path << std::endl;
+		return false;
+	}
+
+	const uint32_t stride = 32;
+	mesh.setLayout({ { 0, 3, MeshFloat32, 0 }, { 1, 3, MeshFloat32, 12 }, { 2, 2, MeshFloat32, 24 } }, stride);
+
+	std::vector<float> positions, colors, uvs;
+	std::map<std::pair<int, int>, uint32_t> vertexIndices;	// (position, uv) -> vertex
+	std::vector<uint32_t> polygon;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		++lineNumber;
+		std::istringstream in(line);
+		std::string keyword;
+		in >> keyword;
+
+		if (keyword == "v") {
+			float p[3] = {}, c[3] = { 1.0f, 1.0f, 1.0f };
+			in >> p[0] >> p[1] >> p[2];
+			if (!in) {
+				std::cerr << path << ":" << lineNumber << ": bad vertex" << std::endl;
+				return false;
+			}
+			if (!(in >> c[0] >> c[1] >> c[2])) {
+				c[0] = c[1] = c[2] = 1.0f;
+			}
+			positions.insert(positions.end(), p, p + 3);
+			colors.insert(colors.end(), c, c + 3);
+		} else if (keyword == "vt") {
+			float u = 0, v = 0;
+			in >> u >> v;
+			// OBJ puts v = 0 at the bottom of the image, our textures start at the top row
+			uvs.push_back(u);
+			uvs.push_back(1.0f - v);
+		} else if (keyword == "f") {
+			polygon.clear();
+			std::string corner;
+			while (in >> corner) {
+				// p, p/t, p//n or p/t/n
+				int p = resolveIndex(atoi(corner.c_str()), positions.size() / 3);
+				int t = -1;
+				size_t slash = corner.find('/');
+				if (slash != std::string::npos && slash + 1 < corner.size() && corner[slash + 1] != '/') {
+					t = resolveIndex(atoi(corner.c_str() + slash + 1), uvs.size() / 2);
+					if (t < 0) p = -1;
+				}
+				if (p < 0) {
+					std::cerr << path << ":" << lineNumber << ": bad face index " << corner << std::endl;
+					return false;
+				}
+
+				auto inserted = vertexIndices.insert(std::make_pair(std::make_pair(p, t), (uint32_t)(mesh.vertices.size() / stride)));
+				if (inserted.second) {
+					float vertex[8] = { positions[3 * p], positions[3 * p + 1], positions[3 * p + 2], 
+						colors[3 * p], colors[3 * p + 1], colors[3 * p + 2], 
+						t >= 0 ? uvs[2 * t] : 0.0f, t >= 0 ? uvs[2 * t + 1] : 0.0f };
+					const unsigned char *bytes = (const unsigned char *)vertex;
+					mesh.vertices.insert(mesh.vertices.end(), bytes, bytes + stride);
+				}
+				polygon.push_back(inserted.first->second);
+			}
+			for (size_t i = 2; i < polygon.size(); ++i) {
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i - 1]);
+				mesh.indices.push_back(polygon[i]);
+			}
+		}
+	}
+
+	if (mesh.indices.empty()) {
+		std::cerr << path << ": no faces" << std::endl;
+		return false;
+	}
+	MeshContainerLevel level = { 0, (uint32_t)mesh.indices.size(), 0, 0.0f };
+	mesh.levels.push_back(level);
+	mesh.finish();
+	return true;
+}
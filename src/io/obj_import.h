@@ -0,0 +1,14 @@
+#ifndef _OBJ_IMPORT_H_
+#define _OBJ_IMPORT_H_
+
+#include <io/mesh_container.h>
+
+#include <string>
+
+// Read the triangles of a Wavefront OBJ file into one level of interleaved 
+// position (location 0), color (1) and UV (2), the layout of the box. Vertex 
+// colors come from the common "v x y z r g b" extension, white otherwise. 
+// Polygons are split into fans, normals, groups and materials are ignored.
+bool ImportOBJ(const std::string &path, MeshData &mesh);
+
+#endif
@@ -0,0 +1,4 @@
+// Single translation unit holding the stb_image implementation, shared by the 
+// renderer and the command line tools.
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
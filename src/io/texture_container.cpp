@@ -0,0 +1,75 @@
+#include "texture_container.h"
+
+#include <image/mipmap.h>
+
+#include <cstdio>
+#include <vector>
+
+bool WriteTextureContainer(const std::string &path, int width, int height, const unsigned char *rgb) {
+	const size_t alignment = 16;
+	std::vector<uint8_t> chain;
+	std::vector<MipLevel> mips;
+	GenerateMipChain(rgb, width, height, 3, alignment, chain, mips);
+
+	TextureContainerHeader header;
+	header.magic = textureContainerMagic;
+	header.version = textureContainerVersion;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.channels = 3;
+	header.levelCount = (uint32_t)mips.size();
+
+	size_t tableEnd = sizeof(header) + sizeof(TextureContainerLevel) * mips.size();
+	size_t dataStart = (tableEnd + alignment - 1) / alignment * alignment;
+	std::vector<TextureContainerLevel> table(mips.size());
+	for (size_t i = 0; i < mips.size(); ++i) {
+		table[i].width = (uint32_t)mips[i].width;
+		table[i].height = (uint32_t)mips[i].height;
+		table[i].offset = dataStart + mips[i].offset;
+		table[i].size = mips[i].size;
+	}
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	static const char padding[16] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 
+		&& fwrite(table.data(), sizeof(TextureContainerLevel), table.size(), file) == table.size() 
+		&& fwrite(padding, 1, dataStart - tableEnd, file) == dataStart - tableEnd 
+		&& fwrite(chain.data(), 1, chain.size(), file) == chain.size();
+	return fclose(file) == 0 && ok;
+}
+
+// Whether [offset, offset + bytes) lies in a file of `size` bytes, without overflowing
+static bool fits(uint64_t offset, uint64_t bytes, size_t size) {
+	return offset <= size && bytes <= size - offset;
+}
+
+bool TextureContainer::open(const std::string &path) {
+	close();
+	if (!file.open(path)) return false;
+
+	if (file.size < sizeof(TextureContainerHeader)) {
+		close();
+		return false;
+	}
+	header = (const TextureContainerHeader *)file.data;
+	if (header->magic != textureContainerMagic || header->version != textureContainerVersion || header->channels != 3 
+		|| header->levelCount == 0 || file.size < sizeof(TextureContainerHeader) + sizeof(TextureContainerLevel) * header->levelCount) {
+		close();
+		return false;
+	}
+	levels = (const TextureContainerLevel *)(file.data + sizeof(TextureContainerHeader));
+	for (uint32_t i = 0; i < header->levelCount; ++i) {
+		if (!fits(levels[i].offset, levels[i].size, file.size) || levels[i].size != (uint64_t)levels[i].width * levels[i].height * 3) {
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void TextureContainer::close() {
+	file.close();
+	header = NULL;
+	levels = NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef _TEXTURE_CONTAINER_H_
+#define _TEXTURE_CONTAINER_H_
+
+#include <io/mapped_file.h>
+
+#include <cstdint>
+#include <string>
+
+// Texture container (.atex): an 8-bit RGB image with its whole mip chain baked 
+// offline, laid out so levels can be copied straight from a mapping into GL.
+//
+//   TextureContainerHeader
+//   TextureContainerLevel[levelCount]
+//   level data, each level tightly packed and 16-byte aligned
+struct TextureContainerHeader {
+	uint32_t magic;			// textureContainerMagic
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;		// Always 3
+	uint32_t levelCount;
+};
+
+struct TextureContainerLevel {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;		// From the start of the file
+	uint64_t size;
+};
+
+static const uint32_t textureContainerMagic = 0x58455441;	// "ATEX"
+static const uint32_t textureContainerVersion = 1;
+
+// Bake the mip chain of a tightly packed RGB image and write it out
+bool WriteTextureContainer(const std::string &path, int width, int height, const unsigned char *rgb);
+
+// A mapped container. Opening validates the header and level table; pixel 
+// pages are only read when a level is touched.
+struct TextureContainer {
+	MappedFile file;
+	const TextureContainerHeader *header = NULL;
+	const TextureContainerLevel *levels = NULL;
+
+	bool open(const std::string &path);
+	void close();
+
+	const unsigned char *levelData(int level) const { return file.data + levels[level].offset; }
+};
+
+#endif
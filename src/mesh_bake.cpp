@@ -0,0 +1,65 @@
+// Offline mesh baker: converts OBJ files, or builds the renderer's box and 
+// sphere, into mesh containers (.amesh) that the renderer maps and uploads. 
+// Every mesh is reordered for the vertex cache and quantized on the way.
+
+#include <io/mesh_container.h>
+#include <io/obj_import.h>
+#include <scene/primitives.h>
+#include <scene/mesh_optimize.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static void printUsage() {
+	std::cout << "Usage: mesh_bake INPUT.obj|--box|--sphere OUTPUT.amesh [INPUT OUTPUT.amesh ...]" << std::endl;
+}
+
+static bool bake(const std::string &input, const char *outputPath) {
+	auto start = std::chrono::steady_clock::now();
+
+	MeshData mesh;
+	if (input == "--box") {
+		BuildBoxMesh(mesh);
+	} else if (input == "--sphere") {
+		// The seed the viewer uses, so baked and built spheres have the same colors
+		srand(2024);
+		BuildSphereMesh(mesh);
+	} else if (!ImportOBJ(input, mesh)) {
+		return false;
+	}
+	MeshOptimizeStats stats;
+	OptimizeMesh(mesh, &stats);
+	if (!WriteMeshContainer(outputPath, mesh)) {
+		std::cerr << "Cannot write " << outputPath << std::endl;
+		return false;
+	}
+
+	MeshContainer container;
+	if (!container.open(outputPath)) {
+		std::cerr << "Written container does not validate: " << outputPath << std::endl;
+		return false;
+	}
+	const MeshContainerHeader &header = *container.mesh.header;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << input << " -> " << outputPath << ": " << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles, " 
+		<< header.levelCount << " levels, " << container.file.size / 1024 << " KiB, " << seconds * 1e3 << " ms" << std::endl;
+	std::cout << "  ACMR " << stats.before.acmr << " -> " << stats.after.acmr << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr 
+		<< ", " << stats.strideBefore << " -> " << stats.strideAfter << " bytes per vertex, " 
+		<< stats.indexSizeBefore << " -> " << stats.indexSizeAfter << " bytes per index" << std::endl;
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3 || (argc - 1) % 2 != 0) {
+		printUsage();
+		return -1;
+	}
+
+	int failures = 0;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!bake(argv[i], argv[i + 1])) ++failures;
+	}
+	return failures == 0 ? 0 : -1;
+}
@@ -7,6 +7,14 @@
 
 #include <render/shader.h>
 #include <render/texture.h>
+#include <render/render_state.h>
+#include <render/draw_list.h>
+#include <render/texture_streamer.h>
+#include <render/instance_data.h>
+#include <render/stream_buffer.h>
+#include <render/mesh_buffers.h>
+#include <scene/primitives.h>
+#include <scene/mesh_optimize.h>
 
 #include <vector>
 #include <iostream>
@@ -15,179 +23,49 @@
 
 struct Box {
 	
-	GLfloat vertex_buffer_data[72] = {	// Vertex definition for a canonical box
-		// Front face
-		-1.0f, -1.0f, 1.0f, 
-		1.0f, -1.0f, 1.0f, 
-		1.0f, 1.0f, 1.0f, 
-		-1.0f, 1.0f, 1.0f, 
-		
-		// Back face 
-		1.0f, -1.0f, -1.0f, 
-		-1.0f, -1.0f, -1.0f, 
-		-1.0f, 1.0f, -1.0f, 
-		1.0f, 1.0f, -1.0f,
-		
-		// Left face
-		-1.0f, -1.0f, -1.0f, 
-		-1.0f, -1.0f, 1.0f, 
-		-1.0f, 1.0f, 1.0f, 
-		-1.0f, 1.0f, -1.0f, 
-
-		// Right face 
-		1.0f, -1.0f, 1.0f, 
-		1.0f, -1.0f, -1.0f, 
-		1.0f, 1.0f, -1.0f, 
-		1.0f, 1.0f, 1.0f,
-
-		// Top face
-		-1.0f, 1.0f, 1.0f, 
-		1.0f, 1.0f, 1.0f, 
-		1.0f, 1.0f, -1.0f, 
-		-1.0f, 1.0f, -1.0f, 
-
-		// Bottom face
-		-1.0f, -1.0f, -1.0f, 
-		1.0f, -1.0f, -1.0f, 
-		1.0f, -1.0f, 1.0f, 
-		-1.0f, -1.0f, 1.0f, 
-	};
-
-	GLfloat color_buffer_data[72] = {
-		// Front, red
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-
-		// Back, yellow
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-
-		// Left, green
-		0.0f, 1.0f, 0.0f, 
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		// Right, cyan
-		0.0f, 1.0f, 1.0f, 
-		0.0f, 1.0f, 1.0f, 
-		0.0f, 1.0f, 1.0f, 
-		0.0f, 1.0f, 1.0f, 
-
-		// Top, blue
-		0.0f, 0.0f, 1.0f, 
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-
-		// Bottom, magenta
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f, 
-		1.0f, 0.0f, 1.0f, 
-		1.0f, 0.0f, 1.0f,  
-	};
-
-	GLfloat uv_buffer_data[48] = {
-		// Front
-		0.0f, 1.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f, 
-		0.0f, 0.0f,
-
-		// Back
-		0.0f, 1.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f, 
-		0.0f, 0.0f,
-
-		// Left
-		0.0f, 1.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f, 
-		0.0f, 0.0f,
-
-		// Right
-		0.0f, 1.0f,
-		1.0f, 1.0f,
-		1.0f, 0.0f, 
-		0.0f, 0.0f,
-
-		// Top - we do not want texture the top
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-
-		// Bottom - we do not want texture the bottom
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-	};
-
-	GLuint index_buffer_data[36] = {		// 12 triangle faces of a box
-		0, 1, 2, 	
-		0, 2, 3, 
-		
-		4, 5, 6, 
-		4, 6, 7, 
-
-		8, 9, 10, 
-		8, 10, 11, 
-
-		12, 13, 14, 
-		12, 14, 15, 
-
-		16, 17, 18, 
-		16, 18, 19, 
-
-		20, 21, 22, 
-		20, 22, 23, 
-	};
+	// Interleaved position, color and UV from box.amesh, 36 indices
+	MeshBuffers mesh;
+	GLsizei indexCount = 0;
 
 	GLuint vertexArrayID; 
-	GLuint vertexBufferID; 
-	GLuint indexBufferID; 
-	GLuint colorBufferID;
-	GLuint uvBufferID;
 
 	GLuint textureID;
 
 	GLuint mvpMatrixID;
+	GLuint tintID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
-	void initialize() {
-		// Temporarily disable color 
-		for (int i = 0; i < 72; ++i) color_buffer_data[i] = 1.0f;
+	// Instanced drawing: one model matrix and tint per instance (InstanceData), 
+	// read with an attribute divisor instead of uniforms per draw. The whole 
+	// scene sits in instanceBufferID; per-frame subsets stream through instanceStream.
+	GLuint instanceArrayID;
+	GLuint instanceBufferID;
+	GLsizei instanceCount = 0;
+	GLsizei staticInstanceCount = 0;
+
+	GLuint vpMatrixID;
+	GLuint stereoID;
+	GLuint instancedSamplerID;
+	GLuint instancedProgramID;
+
+	// optimizeMesh false builds the mesh as generated, with float attributes, 
+	// 32-bit indices and no reordering, to compare against
+	void initialize(bool optimizeMesh = true) {
+		// Map the baked mesh if there is one, else build it here
+		if (!optimizeMesh || !mesh.load("../src/box.amesh"))
+		{
+			MeshData data;
+			BuildBoxMesh(data);
+			if (optimizeMesh) OptimizeMesh(data);
+			mesh.upload(data.view());
+		}
+		indexCount = (GLsizei)mesh.levels[0].indexCount;
 
-		// Create a vertex array object
+		// Create a vertex array object. The attribute layout is stored in it, so render() only binds it
 		glGenVertexArrays(1, &vertexArrayID);
 		glBindVertexArray(vertexArrayID);
-
-		// Create a vertex buffer object to store the vertex data		
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the UV data
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data, GL_STATIC_DRAW);
-
-		// Create an index buffer object to store the index data that defines triangle faces
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
+		mesh.bindAttributes();
 
 		// Create and compile our GLSL program from the shaders
 		programID = LoadShaders("../src/box.vert", "../src/box.frag");
@@ -196,62 +74,182 @@ struct Box {
 			std::cerr << "Failed to load shaders." << std::endl;
 		}
 
-		textureID = LoadTexture("../src/facade4.jpg");
+		// Stream the baked container if there is one, else decode the JPEG here
+		textureID = textureStreamer.request("../src/facade4.atex");
+		if (textureID == 0)
+		{
+			textureID = LoadTexture("../src/facade4.jpg");
+		}
+
+		// Create a second vertex array object for instanced drawing. It reads the 
+		// same vertex data and one InstanceData per instance in locations 3 to 7.
+		glGenVertexArrays(1, &instanceArrayID);
+		glBindVertexArray(instanceArrayID);
+		mesh.bindAttributes();
+
+		glGenBuffers(1, &instanceBufferID);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+		glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_DYNAMIC_DRAW);
+		EnableInstanceAttributes();
+		PointInstanceAttributes(0);
+
+		instancedProgramID = LoadShaders("../src/box_instanced.vert", "../src/box.frag");
+		if (instancedProgramID == 0)
+		{
+			std::cerr << "Failed to load instanced shaders." << std::endl;
+		}
+
+		// The bindings above bypassed renderState
+		renderState.invalidate();
+		loadUniforms();
+	}
 
+	// Get the uniform handles of both programs and set the ones that never change. 
+	// Called again when a program is rebuilt.
+	void loadUniforms() {
 		// Get a handle for our "MVP" uniform
 		mvpMatrixID = glGetUniformLocation(programID, "MVP");
 
+		tintID = glGetUniformLocation(programID, "tint");
+
 		// Get a handle for our "textureSampler" uniform
 		textureSamplerID  = glGetUniformLocation(programID, "textureSampler");
+
+		// textureSampler always reads texture unit 0, set it once instead of per draw. 
+		// Draw lists set the tint per box, render() leaves it white.
+		renderState.useProgram(programID);
+		glUniform1i(textureSamplerID, 0);
+		glUniform4f(tintID, 1.0f, 1.0f, 1.0f, 1.0f);
+
+		vpMatrixID = glGetUniformLocation(instancedProgramID, "VP");
+		stereoID = glGetUniformLocation(instancedProgramID, "stereo");
+		instancedSamplerID = glGetUniformLocation(instancedProgramID, "textureSampler");
+		renderState.useProgram(instancedProgramID);
+		glUniform1i(instancedSamplerID, 0);
 	}
 
-	void render(glm::mat4 cameraMatrix, glm::mat4 modelMatrix) {
-		glUseProgram(programID);
+	// Upload the attributes of all instances. Call again whenever the scene changes.
+	void uploadInstances(const glm::mat4 *transforms, const uint32_t *colors, size_t count) {
+		renderState.bindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * count, NULL, GL_DYNAMIC_DRAW);
+		if (count > 0) {
+			InstanceData *data = (InstanceData*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * count, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (data) {
+				PackInstances(transforms, colors, NULL, count, data);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+		}
+		staticInstanceCount = (GLsizei)count;
+		useStaticInstances();
+	}
 
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	// Draw the instances of the last uploadInstances() again
+	void useStaticInstances() {
+		renderState.bindVertexArray(instanceArrayID);
+		renderState.bindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+		PointInstanceAttributes(0);
+		instanceCount = staticInstanceCount;
+	}
 
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	// Draw the listed instances until the next upload. Their attributes go through 
+	// instanceStream, so this has to be repeated every frame they are drawn.
+	void streamInstances(const glm::mat4 *transforms, const uint32_t *colors, const int *indices, size_t count) {
+		instanceCount = (GLsizei)count;
+		if (count == 0) return;
+
+		GLintptr offset;
+		InstanceData *data = (InstanceData*)instanceStream.map(sizeof(InstanceData) * count, offset);
+		if (!data) {
+			instanceCount = 0;
+			return;
+		}
+		PackInstances(transforms, colors, indices, count, data);
+		instanceStream.unmap();
 
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		renderState.bindVertexArray(instanceArrayID);
+		PointInstanceAttributes(offset);
+	}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	void render(glm::mat4 cameraMatrix, glm::mat4 modelMatrix) {
+		renderState.useProgram(programID);
+		renderState.bindVertexArray(vertexArrayID);
+		renderState.bindTexture(0, textureID);
 		
 		// Set model-view-projection matrix
 		glm::mat4 mvp = cameraMatrix * modelMatrix;
 		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
 
-		// Set textureSampler to use texture unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);	
-
 		// Draw the box
 		glDrawElements(
 			GL_TRIANGLES,      // mode
-			36,    			   // number of indices
-			GL_UNSIGNED_INT,   // type
+			indexCount,        // number of indices
+			mesh.indexType,    // type
 			(void*)0           // element array buffer offset
 		);
+		renderState.countDraw(indexCount);
+	}
+
+	// Queue the box, already transformed by mvpMatrix, in a draw list instead of drawing it right away
+	void addDraw(DrawList &drawList, const glm::mat4 &mvpMatrix, uint32_t color, float zFar) {
+		DrawCommand command;
+		command.program = programID;
+		command.vertexArray = vertexArrayID;
+		command.texture = textureID;
+		command.mvpLocation = mvpMatrixID;
+		command.tintLocation = tintID;
+		command.color = color;
+		command.indexCount = indexCount;
+		command.firstIndex = 0;
+		command.indexType = mesh.indexType;
+		command.baseVertex = 0;
+		command.mvp = mvpMatrix;
+		drawList.add(command, command.mvp[3][3] / zFar);	// Clip w of the box center
+	}
+
+	// Draw all uploaded instances with a single draw call
+	void renderInstanced(const glm::mat4 &cameraMatrix) {
+		if (instanceCount == 0) return;
+
+		renderState.useProgram(instancedProgramID);
+		renderState.bindVertexArray(instanceArrayID);
+		renderState.bindTexture(0, textureID);
+
+		glUniformMatrix4fv(vpMatrixID, 1, GL_FALSE, &cameraMatrix[0][0]);
+		glUniform1i(stereoID, 0);
+
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, mesh.indexType, (void*)0, instanceCount);
+		renderState.countDraw((long long)indexCount * instanceCount);
+	}
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+	// Draw all uploaded instances for both eyes with a single draw call. Every 
+	// instance is submitted twice and the shader picks the eye from gl_InstanceID, 
+	// so the target must be a StereoTarget and GL_CLIP_DISTANCE0 enabled.
+	void renderStereoInstanced(const glm::mat4 &leftCameraMatrix, const glm::mat4 &rightCameraMatrix) {
+		if (instanceCount == 0) return;
+
+		renderState.useProgram(instancedProgramID);
+		renderState.bindVertexArray(instanceArrayID);
+		renderState.bindTexture(0, textureID);
+
+		glm::mat4 cameraMatrices[2] = { leftCameraMatrix, rightCameraMatrix };
+		glUniformMatrix4fv(vpMatrixID, 2, GL_FALSE, &cameraMatrices[0][0][0]);
+		glUniform1i(stereoID, 1);
+
+		// Advance the model matrix every second instance
+		SetInstanceDivisor(2);
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, mesh.indexType, (void*)0, 2 * instanceCount);
+		renderState.countDraw(2LL * indexCount * instanceCount);
+		SetInstanceDivisor(1);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
+		mesh.cleanup();
+		glDeleteBuffers(1, &instanceBufferID);
 		glDeleteVertexArrays(1, &vertexArrayID);
+		glDeleteVertexArrays(1, &instanceArrayID);
 		glDeleteTextures(1, &textureID);
 		glDeleteProgram(programID);
+		glDeleteProgram(instancedProgramID);
 	}
 }; 
 
@@ -6,161 +6,411 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <render/shader.h>
+#include <render/render_state.h>
+#include <render/draw_list.h>
+#include <render/instance_data.h>
+#include <render/stream_buffer.h>
+#include <render/mesh_buffers.h>
+#include <scene/primitives.h>
+#include <scene/mesh_optimize.h>
 
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <cstdlib> // For random colors
+
+// One tessellation level of the sphere inside the shared vertex/index buffers
+struct SphereLevel
+{
+    float error;        // Silhouette deviation of the unit sphere
+    GLsizei firstIndex;
+    GLsizei indexCount;
+    GLint baseVertex;
+};
 
 struct Sphere
 {
-    // Vertex data
-    std::vector<GLfloat> vertexBuffer;
-    std::vector<GLfloat> colorBuffer;
-    std::vector<GLuint> indexBuffer;
+    // Interleaved position and color from sphere.amesh, all levels of detail back to back
+    MeshBuffers mesh;
+
+    // Level of detail chain, finest first. The finest level is the original 20x20 mesh.
+    std::vector<SphereLevel> levels;
+    float maxErrorPixels = 0.5f;    // Allowed silhouette error when picking a level
+
+    // Range of the instances being drawn at each level, for instanced drawing
+    std::vector<GLsizei> levelInstanceFirst;
+    std::vector<GLsizei> levelInstanceCount;
 
     // OpenGL object IDs
     GLuint vaoID = 0;
-    GLuint vboVerticesID = 0;
-    GLuint vboColorsID = 0;
-    GLuint eboID = 0;
+    GLuint instanceBufferID = 0;        // InstanceData of the whole scene
+    GLsizei instanceCount = 0;
+    GLsizei staticInstanceCount = 0;
+    GLuint levelBufferID = 0;           // InstanceData grouped by level, see useLevelGroups()
+    unsigned levelBufferVersion = 0;    // Version of the grouping in levelBufferID, 0 for none
+    GLsizei levelBufferCount = 0;
+
+    // Where the instances being drawn live: instanceBufferID, levelBufferID, or a range of instanceStream
+    GLuint instanceSourceID = 0;
+    GLintptr instanceSourceOffset = 0;
 
     // Shader program and uniform handle
     GLuint programID = 0;
     GLuint mvpMatrixID = 0;
+    GLint tintID = -1;
+
+    // Instanced shader program, takes the model matrix as a per-instance attribute
+    GLuint instancedProgramID = 0;
+    GLuint vpMatrixID = 0;
+    GLuint stereoID = 0;
 
-    // Generate sphere geometry with random colors
-    void generateGeometry(int stackCount, int sectorCount)
+    // Impostors: one quad per instance, ray-cast in the fragment shader. The vertex 
+    // array only holds the instance attributes, the corners come from gl_VertexID.
+    GLuint impostorArrayID = 0;
+    GLuint impostorProgramID = 0;
+    GLint impostorVPID = -1;
+    GLint impostorEyeID = -1;
+    GLint impostorStereoID = -1;
+
+    // optimizeMesh false builds the mesh as generated, with float attributes, 
+    // 32-bit indices and no reordering, to compare against
+    void initialize(bool optimizeMesh = true)
     {
-        vertexBuffer.clear();
-        colorBuffer.clear();
-        indexBuffer.clear();
+        // Map the baked mesh if there is one, else build it here
+        if (!optimizeMesh || !mesh.load("../src/sphere.amesh"))
+        {
+            MeshData data;
+            BuildSphereMesh(data);
+            if (optimizeMesh)
+                OptimizeMesh(data);
+            mesh.upload(data.view());
+        }
+        levels.clear();
+        for (const MeshContainerLevel &l : mesh.levels)
+        {
+            SphereLevel level = {l.error, (GLsizei)l.firstIndex, (GLsizei)l.indexCount, (GLint)l.baseVertex};
+            levels.push_back(level);
+        }
+        levelInstanceFirst.assign(levels.size(), 0);
+        levelInstanceCount.assign(levels.size(), 0);
 
-        float radius = 1.0f;
-        float pi = 3.14159265358979f;
-        float sectorStep = 2.0f * pi / sectorCount;
-        float stackStep = pi / stackCount;
+        // Create VAO
+        glGenVertexArrays(1, &vaoID);
+        glBindVertexArray(vaoID);
+        mesh.bindAttributes();
+
+        // Create VBO for per-instance attributes (InstanceData, locations 3 to 7)
+        glGenBuffers(1, &instanceBufferID);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+        glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_DYNAMIC_DRAW);
+        EnableInstanceAttributes();
+        PointInstanceAttributes(0);
+        instanceSourceID = instanceBufferID;
+        glGenBuffers(1, &levelBufferID);
+
+        glGenVertexArrays(1, &impostorArrayID);
+        glBindVertexArray(impostorArrayID);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+        EnableInstanceAttributes();
+        PointInstanceAttributes(0);
+
+        // Load shaders (ensure it handles color attributes)
+        programID = LoadShaders("../src/sphere.vert", "../src/sphere.frag");
+        instancedProgramID = LoadShaders("../src/sphere_instanced.vert", "../src/sphere.frag");
+        impostorProgramID = LoadShaders("../src/sphere_impostor.vert", "../src/sphere_impostor.frag");
+        loadUniforms();
+
+        // The bindings above bypassed renderState
+        glBindVertexArray(0);
+        renderState.invalidate();
+    }
 
-        for (int i = 0; i <= stackCount; ++i)
+    // Get the uniform handles of all programs. Called again when a program is rebuilt.
+    void loadUniforms()
+    {
+        mvpMatrixID = glGetUniformLocation(programID, "MVP");
+
+        // Draw lists set the tint per sphere, render() leaves it white
+        tintID = glGetUniformLocation(programID, "tint");
+        renderState.useProgram(programID);
+        glUniform4f(tintID, 1.0f, 1.0f, 1.0f, 1.0f);
+
+        vpMatrixID = glGetUniformLocation(instancedProgramID, "VP");
+        stereoID = glGetUniformLocation(instancedProgramID, "stereo");
+
+        impostorVPID = glGetUniformLocation(impostorProgramID, "VP");
+        impostorEyeID = glGetUniformLocation(impostorProgramID, "eyePosition");
+        impostorStereoID = glGetUniformLocation(impostorProgramID, "stereo");
+    }
+
+    // Coarsest level whose silhouette error stays below maxErrorPixels in both eyes. 
+    // pixelScale converts size over distance to pixels: viewportHeight / (2 tan(fovy / 2)).
+    // Both eyes get the same level so the two views never show different meshes.
+    int selectLevel(const glm::mat4 &modelMatrix, const glm::mat4 &leftCameraMatrix, const glm::mat4 &rightCameraMatrix, float pixelScale) const
+    {
+        glm::vec4 center = modelMatrix[3];
+        float radius = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+        // Clip w is the distance along the view axis; the nearer eye sees the sphere larger
+        float distance = std::min((leftCameraMatrix * center).w, (rightCameraMatrix * center).w);
+        if (distance <= radius)
+            return 0;
+        float radiusPixels = radius * pixelScale / distance;
+
+        // Level errors are for the unit sphere and scale with its size on screen
+        for (int i = (int)levels.size() - 1; i > 0; --i)
         {
-            float stackAngle = pi / 2 - i * stackStep; // from +pi/2 to -pi/2
-            float xy = radius * cosf(stackAngle);
-            float z = radius * sinf(stackAngle);
+            float error = radiusPixels * levels[i].error;
+            if (error <= maxErrorPixels)
+                return i;
+        }
+        return 0;
+    }
+
+    void render(const glm::mat4 &cameraMatrix, const glm::mat4 &modelMatrix, int level = 0)
+    {
+        // Attributes and indices are stored in the VAO
+        renderState.useProgram(programID);
+        renderState.bindVertexArray(vaoID);
 
-            for (int j = 0; j <= sectorCount; ++j)
+        // Compute and set MVP matrix
+        glm::mat4 mvp = cameraMatrix * modelMatrix;
+        glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+
+        // Draw the sphere
+        const SphereLevel &l = levels[level];
+        glDrawElementsBaseVertex(GL_TRIANGLES, l.indexCount, mesh.indexType, mesh.indexOffset(l.firstIndex), l.baseVertex);
+        renderState.countDraw(l.indexCount);
+    }
+
+    // Queue the sphere, already transformed by mvpMatrix, in a draw list instead of drawing it right away
+    void addDraw(DrawList &drawList, const glm::mat4 &mvpMatrix, uint32_t color, float zFar, int level = 0)
+    {
+        const SphereLevel &l = levels[level];
+        DrawCommand command;
+        command.program = programID;
+        command.vertexArray = vaoID;
+        command.texture = 0;
+        command.mvpLocation = mvpMatrixID;
+        command.tintLocation = tintID;
+        command.color = color;
+        command.indexCount = l.indexCount;
+        command.firstIndex = l.firstIndex;
+        command.indexType = mesh.indexType;
+        command.baseVertex = l.baseVertex;
+        command.mvp = mvpMatrix;
+        drawList.add(command, command.mvp[3][3] / zFar); // Clip w of the sphere center
+    }
+
+    // Upload the attributes of all instances, drawn at the finest level. Call again whenever the scene changes.
+    void uploadInstances(const glm::mat4 *transforms, const uint32_t *colors, size_t count)
+    {
+        renderState.bindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * count, NULL, GL_DYNAMIC_DRAW);
+        if (count > 0)
+        {
+            InstanceData *data = (InstanceData *)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * count, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (data)
             {
-                float sectorAngle = j * sectorStep;
-
-                // Vertex position
-                float x = xy * cosf(sectorAngle);
-                float y = xy * sinf(sectorAngle);
-                vertexBuffer.push_back(x);
-                vertexBuffer.push_back(y);
-                vertexBuffer.push_back(z);
-
-                // Generate random colors
-                float r = static_cast<float>(rand()) / RAND_MAX;
-                float g = static_cast<float>(rand()) / RAND_MAX;
-                float b = static_cast<float>(rand()) / RAND_MAX;
-                colorBuffer.push_back(r);
-                colorBuffer.push_back(g);
-                colorBuffer.push_back(b);
+                PackInstances(transforms, colors, NULL, count, data);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
             }
         }
+        staticInstanceCount = (GLsizei)count;
+        levelBufferVersion = 0;     // Groupings index the old scene
+        levelBufferCount = 0;
+        useStaticInstances();
+    }
 
-        // Generate indices for drawing with GL_TRIANGLES
-        for (int i = 0; i < stackCount; ++i)
-        {
-            int k1 = i * (sectorCount + 1);
-            int k2 = k1 + sectorCount + 1;
+    // Draw the instances of the last uploadInstances() again
+    void useStaticInstances()
+    {
+        instanceSourceID = instanceBufferID;
+        instanceSourceOffset = 0;
+        instanceCount = staticInstanceCount;
 
-            for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+        levelInstanceFirst.assign(levels.size(), 0);
+        levelInstanceCount.assign(levels.size(), 0);
+        levelInstanceCount[0] = instanceCount;
+    }
+
+    // Draw instances already grouped by level: `order` lists them level by level, `first` 
+    // and `count` give each level's range of it. They are uploaded only when `version` 
+    // differs from the grouping in levelBufferID, so both eyes of a frame, and frames 
+    // whose grouping did not change, draw the same buffer.
+    void useLevelGroups(const glm::mat4 *transforms, const uint32_t *colors, const std::vector<int> &order, 
+                        const std::vector<int> &first, const std::vector<int> &count, unsigned version)
+    {
+        if (version != levelBufferVersion)
+        {
+            renderState.bindBuffer(GL_ARRAY_BUFFER, levelBufferID);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * order.size(), NULL, GL_STREAM_DRAW);
+            levelBufferCount = 0;
+            if (!order.empty())
             {
-                if (i != 0)
-                {
-                    indexBuffer.push_back(k1);
-                    indexBuffer.push_back(k2);
-                    indexBuffer.push_back(k1 + 1);
-                }
-                if (i != (stackCount - 1))
+                InstanceData *data = (InstanceData *)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * order.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+                if (data)
                 {
-                    indexBuffer.push_back(k1 + 1);
-                    indexBuffer.push_back(k2);
-                    indexBuffer.push_back(k2 + 1);
+                    PackInstances(transforms, colors, order.data(), order.size(), data);
+                    glUnmapBuffer(GL_ARRAY_BUFFER);
+                    levelBufferCount = (GLsizei)order.size();
                 }
             }
+            levelBufferVersion = version;
+        }
+
+        instanceSourceID = levelBufferID;
+        instanceSourceOffset = 0;
+        instanceCount = levelBufferCount;
+        for (size_t l = 0; l < levels.size(); ++l)
+        {
+            levelInstanceFirst[l] = levelBufferCount > 0 ? first[l] : 0;
+            levelInstanceCount[l] = levelBufferCount > 0 ? count[l] : 0;
         }
     }
 
-    void initialize()
+    // Stream the listed instances, in that order, without regrouping them
+    void streamInstances(const glm::mat4 *transforms, const uint32_t *colors, const int *indices, size_t count)
     {
-        generateGeometry(20, 20);
+        instanceCount = (GLsizei)count;
+        if (count == 0)
+            return;
 
-        // Create VAO
-        glGenVertexArrays(1, &vaoID);
-        glBindVertexArray(vaoID);
+        InstanceData *data = (InstanceData *)instanceStream.map(sizeof(InstanceData) * count, instanceSourceOffset);
+        if (!data)
+        {
+            instanceCount = 0;
+            return;
+        }
+        PackInstances(transforms, colors, indices, count, data);
+        instanceStream.unmap();
+        instanceSourceID = instanceStream.bufferID;
+    }
+
+    // Stream the listed instances, all drawn at the finest level
+    void streamInstancesFinest(const glm::mat4 *transforms, const uint32_t *colors, const int *indices, size_t count)
+    {
+        levelInstanceFirst.assign(levels.size(), 0);
+        levelInstanceCount.assign(levels.size(), 0);
+        levelInstanceCount[0] = (GLsizei)count;
+        streamInstances(transforms, colors, indices, count);
+    }
+
+    // One instanced draw per non-empty level. GL 3.3 has no base instance, so the 
+    // per-instance attributes are re-pointed at the level's range of the buffer.
+    void drawLevels(int instanceMultiplier)
+    {
+        renderState.bindBuffer(GL_ARRAY_BUFFER, instanceSourceID);
+        for (size_t l = 0; l < levels.size(); ++l)
+        {
+            if (levelInstanceCount[l] == 0)
+                continue;
+            PointInstanceAttributes(instanceSourceOffset + sizeof(InstanceData) * levelInstanceFirst[l]);
 
-        // Create VBO for vertices
-        glGenBuffers(1, &vboVerticesID);
-        glBindBuffer(GL_ARRAY_BUFFER, vboVerticesID);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertexBuffer.size(), vertexBuffer.data(), GL_STATIC_DRAW);
+            const SphereLevel &level = levels[l];
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, mesh.indexType, mesh.indexOffset(level.firstIndex),
+                                              instanceMultiplier * levelInstanceCount[l], level.baseVertex);
+            renderState.countDraw((long long)level.indexCount * instanceMultiplier * levelInstanceCount[l]);
+        }
+    }
 
-        // Create VBO for colors
-        glGenBuffers(1, &vboColorsID);
-        glBindBuffer(GL_ARRAY_BUFFER, vboColorsID);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * colorBuffer.size(), colorBuffer.data(), GL_STATIC_DRAW);
+    // Draw all uploaded instances, one instanced draw call per level in use
+    void renderInstanced(const glm::mat4 &cameraMatrix)
+    {
+        if (instanceCount == 0)
+            return;
 
-        // Create EBO for indices
-        glGenBuffers(1, &eboID);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexBuffer.size(), indexBuffer.data(), GL_STATIC_DRAW);
+        renderState.useProgram(instancedProgramID);
+        renderState.bindVertexArray(vaoID);
 
-        // Load shaders (ensure it handles color attributes)
-        programID = LoadShaders("../src/sphere.vert", "../src/sphere.frag");
+        glUniformMatrix4fv(vpMatrixID, 1, GL_FALSE, &cameraMatrix[0][0]);
+        glUniform1i(stereoID, 0);
+        drawLevels(1);
+    }
 
-        // Get uniform handle
-        mvpMatrixID = glGetUniformLocation(programID, "MVP");
+    // Draw all uploaded instances for both eyes, one draw call per level in use (see Box::renderStereoInstanced)
+    void renderStereoInstanced(const glm::mat4 &leftCameraMatrix, const glm::mat4 &rightCameraMatrix)
+    {
+        if (instanceCount == 0)
+            return;
 
-        // Unbind VAO
-        glBindVertexArray(0);
+        renderState.useProgram(instancedProgramID);
+        renderState.bindVertexArray(vaoID);
+
+        glm::mat4 cameraMatrices[2] = {leftCameraMatrix, rightCameraMatrix};
+        glUniformMatrix4fv(vpMatrixID, 2, GL_FALSE, &cameraMatrices[0][0][0]);
+        glUniform1i(stereoID, 1);
+
+        // Advance the model matrix every second instance
+        SetInstanceDivisor(2);
+        drawLevels(2);
+        SetInstanceDivisor(1);
     }
 
-    void render(const glm::mat4 &cameraMatrix, const glm::mat4 &modelMatrix)
+    // World position of the eye of a view-projection matrix: the point that maps to 
+    // clip x = y = w = 0, for the symmetric and the off-axis frusta alike
+    static glm::vec3 eyePosition(const glm::mat4 &cameraMatrix)
     {
-        glUseProgram(programID);
-        glBindVertexArray(vaoID);
+        glm::vec4 eye = glm::inverse(cameraMatrix)[2];
+        return glm::vec3(eye) / eye.w;
+    }
 
-        // Enable attributes and bind buffers
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, vboVerticesID);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+    // One instanced draw of 4 vertices per instance, whatever level the instances were grouped by
+    void drawImpostors(int instanceMultiplier)
+    {
+        renderState.useProgram(impostorProgramID);
+        renderState.bindVertexArray(impostorArrayID);
+        renderState.bindBuffer(GL_ARRAY_BUFFER, instanceSourceID);
+        PointInstanceAttributes(instanceSourceOffset);
 
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, vboColorsID);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceMultiplier * instanceCount);
+        renderState.countDraw(4LL * instanceMultiplier * instanceCount);
+    }
 
-        // Bind indices
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID);
+    // Draw all uploaded instances as impostors
+    void renderImpostors(const glm::mat4 &cameraMatrix)
+    {
+        if (instanceCount == 0)
+            return;
 
-        // Compute and set MVP matrix
-        glm::mat4 mvp = cameraMatrix * modelMatrix;
-        glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+        renderState.useProgram(impostorProgramID);
+        glm::vec3 eye = eyePosition(cameraMatrix);
+        glUniformMatrix4fv(impostorVPID, 1, GL_FALSE, &cameraMatrix[0][0]);
+        glUniform3fv(impostorEyeID, 1, &eye[0]);
+        glUniform1i(impostorStereoID, 0);
+        drawImpostors(1);
+    }
 
-        // Draw the sphere
-        glDrawElements(GL_TRIANGLES, (GLsizei)indexBuffer.size(), GL_UNSIGNED_INT, 0);
+    // Draw all uploaded instances as impostors for both eyes (see Box::renderStereoInstanced). 
+    // Each eye ray-casts from its own position, which gives the parallax of either stereo mode.
+    void renderStereoImpostors(const glm::mat4 &leftCameraMatrix, const glm::mat4 &rightCameraMatrix)
+    {
+        if (instanceCount == 0)
+            return;
 
-        // Cleanup
-        glBindVertexArray(0);
-        glUseProgram(0);
+        renderState.useProgram(impostorProgramID);
+        glm::mat4 cameraMatrices[2] = {leftCameraMatrix, rightCameraMatrix};
+        glm::vec3 eyes[2] = {eyePosition(leftCameraMatrix), eyePosition(rightCameraMatrix)};
+        glUniformMatrix4fv(impostorVPID, 2, GL_FALSE, &cameraMatrices[0][0][0]);
+        glUniform3fv(impostorEyeID, 2, &eyes[0][0]);
+        glUniform1i(impostorStereoID, 1);
+
+        renderState.bindVertexArray(impostorArrayID);
+        SetInstanceDivisor(2);
+        drawImpostors(2);
+        SetInstanceDivisor(1);
     }
 
     void cleanup()
     {
-        glDeleteBuffers(1, &vboVerticesID);
-        glDeleteBuffers(1, &vboColorsID);
-        glDeleteBuffers(1, &eboID);
+        mesh.cleanup();
+        glDeleteBuffers(1, &instanceBufferID);
+        glDeleteBuffers(1, &levelBufferID);
         glDeleteVertexArrays(1, &vaoID);
+        glDeleteVertexArrays(1, &impostorArrayID);
         glDeleteProgram(programID);
+        glDeleteProgram(instancedProgramID);
+        glDeleteProgram(impostorProgramID);
     }
 };
 
@@ -0,0 +1,496 @@
+#include "soft_rasterizer.h"
+
+#include <scene/bvh.h>
+#include <scene/culling.h>
+#include <util/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const int subpixelBits = 4;
+static const int subpixels = 1 << subpixelBits;
+
+bool SoftMesh::load(const MeshView &mesh) {
+	const MeshContainerHeader &header = *mesh.header;
+	if (header.indexSize != sizeof(uint32_t)) return false;
+
+	const MeshContainerAttribute *position = NULL, *color = NULL, *uv = NULL;
+	for (uint32_t i = 0; i < header.attributeCount; ++i) {
+		const MeshContainerAttribute &attribute = mesh.attributes[i];
+		if (attribute.type != MeshFloat32) return false;
+		if (attribute.location == 0 && attribute.components >= 3) position = &attribute;
+		if (attribute.location == 1 && attribute.components >= 3) color = &attribute;
+		if (attribute.location == 2 && attribute.components >= 2) uv = &attribute;
+	}
+	if (!position) return false;
+
+	vertices.resize(header.vertexCount);
+	for (uint32_t v = 0; v < header.vertexCount; ++v) {
+		const unsigned char *vertex = mesh.vertices + (size_t)v * header.vertexStride;
+		SoftVertex &out = vertices[v];
+		memcpy(&out.position, vertex + position->offset, sizeof(glm::vec3));
+		out.color = glm::vec3(1.0f);
+		if (color) memcpy(&out.color, vertex + color->offset, sizeof(glm::vec3));
+		out.uv = glm::vec2(0.0f);
+		if (uv) memcpy(&out.uv, vertex + uv->offset, sizeof(glm::vec2));
+	}
+	indices.resize(header.indexCount);
+	memcpy(indices.data(), mesh.indices, sizeof(uint32_t) * header.indexCount);
+	levels.assign(mesh.levels, mesh.levels + header.levelCount);
+
+	levelVertexCounts.assign(levels.size(), 0);
+	for (size_t l = 0; l < levels.size(); ++l) {
+		for (uint32_t i = levels[l].firstIndex; i < levels[l].firstIndex + levels[l].indexCount; ++i) {
+			levelVertexCounts[l] = std::max(levelVertexCounts[l], indices[i] + 1);
+		}
+		if (levels[l].baseVertex + (uint64_t)levelVertexCounts[l] > vertices.size()) return false;
+	}
+	return true;
+}
+
+int SoftMesh::selectLevel(const glm::mat4 &modelMatrix, const glm::mat4 &leftCameraMatrix, const glm::mat4 &rightCameraMatrix,
+	float pixelScale, float maxErrorPixels) const {
+	glm::vec4 center = modelMatrix[3];
+	float radius = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+	float distance = std::min((leftCameraMatrix * center).w, (rightCameraMatrix * center).w);
+	if (distance <= radius) return 0;
+	float radiusPixels = radius * pixelScale / distance;
+
+	for (int i = (int)levels.size() - 1; i > 0; --i) {
+		if (radiusPixels * levels[i].error <= maxErrorPixels) return i;
+	}
+	return 0;
+}
+
+void SoftTexture::load(const uint8_t *rgb, int width, int height) {
+	GenerateMipChain(rgb, width, height, 3, 1, chain, levels);
+}
+
+glm::vec3 SoftTexture::bilinear(int level, const glm::vec2 &uv) const {
+	const MipLevel &mip = levels[level];
+	const uint8_t *pixels = chain.data() + mip.offset;
+
+	float s = uv.x * mip.width - 0.5f, t = uv.y * mip.height - 0.5f;
+	float s0 = floorf(s), t0 = floorf(t);
+	float fs = s - s0, ft = t - t0;
+
+	// GL_REPEAT
+	auto wrap = [](int i, int size) { i %= size; return i < 0 ? i + size : i; };
+	int x0 = wrap((int)s0, mip.width), x1 = x0 + 1 < mip.width ? x0 + 1 : 0;
+	int y0 = wrap((int)t0, mip.height), y1 = y0 + 1 < mip.height ? y0 + 1 : 0;
+
+	auto texel = [&](int x, int y) {
+		const uint8_t *p = pixels + ((size_t)y * mip.width + x) * 3;
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+	glm::vec3 bottom = glm::mix(texel(x0, y0), texel(x1, y0), fs);
+	glm::vec3 top = glm::mix(texel(x0, y1), texel(x1, y1), fs);
+	return glm::mix(bottom, top, ft) / 255.0f;
+}
+
+glm::vec3 SoftTexture::sample(const glm::vec2 &uv, const glm::vec2 &uvDx, const glm::vec2 &uvDy) const {
+	if (levels.empty()) return glm::vec3(1.0f);
+
+	// Level of detail from the larger footprint axis, as the GL specification's scale factor
+	glm::vec2 size(levels[0].width, levels[0].height);
+	float rho = std::max(glm::length(uvDx * size), glm::length(uvDy * size));
+	float lod = rho > 0.0f ? log2f(rho) : 0.0f;
+
+	int last = (int)levels.size() - 1;
+	if (lod <= 0.0f) return bilinear(0, uv);
+	if (lod >= last) return bilinear(last, uv);
+	int level = (int)lod;
+	return glm::mix(bilinear(level, uv), bilinear(level + 1, uv), lod - level);
+}
+
+void SoftTarget::resize(int width, int height) {
+	this->width = width;
+	this->height = height;
+	color.resize((size_t)width * height * 3);
+}
+
+// A vertex after the vertex shader, in clip space
+struct ClipVertex {
+	glm::vec4 position;
+	glm::vec3 color;
+	glm::vec2 uv;
+};
+
+// Signed distance to a clip plane, inside when >= 0: -w <= x, y, z <= w
+static float planeDistance(const glm::vec4 &p, int plane) {
+	switch (plane) {
+	case 0: return p.w + p.x;
+	case 1: return p.w - p.x;
+	case 2: return p.w + p.y;
+	case 3: return p.w - p.y;
+	case 4: return p.w + p.z;
+	default: return p.w - p.z;
+	}
+}
+
+static int outcode(const glm::vec4 &p) {
+	int code = 0;
+	for (int plane = 0; plane < 6; ++plane) {
+		if (planeDistance(p, plane) < 0.0f) code |= 1 << plane;
+	}
+	return code;
+}
+
+static ClipVertex lerp(const ClipVertex &a, const ClipVertex &b, float t) {
+	ClipVertex v;
+	v.position = glm::mix(a.position, b.position, t);
+	v.color = glm::mix(a.color, b.color, t);
+	v.uv = glm::mix(a.uv, b.uv, t);
+	return v;
+}
+
+// Clip a triangle against the planes in `planes`, returning the polygon's vertex count.
+// Each plane adds at most one vertex: 9 at most.
+static int clipPolygon(ClipVertex *polygon, int planes) {
+	ClipVertex buffer[9];
+	ClipVertex *in = polygon, *out = buffer;
+	int count = 3;
+	for (int plane = 0; plane < 6 && count >= 3; ++plane) {
+		if (!(planes & (1 << plane))) continue;
+		int outCount = 0;
+		for (int i = 0; i < count; ++i) {
+			const ClipVertex &a = in[i], &b = in[(i + 1) % count];
+			float da = planeDistance(a.position, plane), db = planeDistance(b.position, plane);
+			if (da >= 0.0f) out[outCount++] = a;
+			// Always from the inside vertex, so the triangles sharing the edge get the same point
+			if (da >= 0.0f && db < 0.0f) out[outCount++] = lerp(a, b, da / (da - db));
+			if (da < 0.0f && db >= 0.0f) out[outCount++] = lerp(b, a, db / (db - da));
+		}
+		std::swap(in, out);
+		count = outCount;
+	}
+	if (in != polygon) std::copy(in, in + count, polygon);
+	return count;
+}
+
+static bool outsideFrustum(const Frustum &frustum, const AABB &bounds) {
+	for (int i = 0; i < frustum.planeCount; ++i) {
+		const glm::vec4 &plane = frustum.planes[i];
+		glm::vec3 farthest(plane.x > 0 ? bounds.max.x : bounds.min.x, plane.y > 0 ? bounds.max.y : bounds.min.y, plane.z > 0 ? bounds.max.z : bounds.min.z);
+		if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f) return true;
+	}
+	return false;
+}
+
+void SoftRasterizer::render(const SoftMesh &mesh, const SoftTexture *texture, const glm::mat4 *transforms, const uint32_t *colors,
+	const unsigned char *levels, size_t count, const glm::mat4 &viewProjection, SoftTarget &target, ThreadPool *pool) {
+	stats = SoftStats();
+	if (target.width > maxViewportSize || target.height > maxViewportSize) {
+		std::cerr << "Software rasterizer targets are limited to " << maxViewportSize << " pixels per side." << std::endl;
+		return;
+	}
+
+	tilesX = (target.width + tileSize - 1) / tileSize;
+	tilesY = (target.height + tileSize - 1) / tileSize;
+	int tileCount = tilesX * tilesY;
+	int chunkCount = (int)((count + chunkInstances - 1) / chunkInstances);
+	if ((int)chunkTriangles.size() < chunkCount) chunkTriangles.resize(chunkCount);
+	if (bins.size() < (size_t)chunkCount * tileCount) bins.resize((size_t)chunkCount * tileCount);
+	chunkStats.assign(chunkCount, SoftStats());
+	tileFragments.assign(tileCount, 0);
+
+	auto start = std::chrono::steady_clock::now();
+	auto setup = [&](int begin, int end) {
+		for (int chunk = begin; chunk < end; ++chunk) {
+			setupChunk(chunk, mesh, texture, transforms, colors, levels, count, viewProjection, target.width, target.height);
+		}
+	};
+	if (pool) pool->parallelFor(0, chunkCount, 1, setup);
+	else setup(0, chunkCount);
+	auto setupEnd = std::chrono::steady_clock::now();
+
+	auto raster = [&](int begin, int end) {
+		for (int tile = begin; tile < end; ++tile) rasterizeTile(tile, chunkCount, target);
+	};
+	if (pool) pool->parallelFor(0, tileCount, 1, raster);
+	else raster(0, tileCount);
+	auto rasterEnd = std::chrono::steady_clock::now();
+
+	for (const SoftStats &chunk : chunkStats) {
+		stats.triangles += chunk.triangles;
+		stats.rasterized += chunk.rasterized;
+		stats.binned += chunk.binned;
+	}
+	for (long long fragments : tileFragments) stats.fragments += fragments;
+	stats.setupMilliseconds = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+	stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(rasterEnd - setupEnd).count();
+}
+
+void SoftRasterizer::setupChunk(int chunk, const SoftMesh &mesh, const SoftTexture *texture, const glm::mat4 *transforms, const uint32_t *colors,
+	const unsigned char *levels, size_t count, const glm::mat4 &viewProjection, int width, int height) {
+	int tileCount = tilesX * tilesY;
+	std::vector<Triangle> &triangles = chunkTriangles[chunk];
+	std::vector<uint32_t> *chunkBins = &bins[(size_t)chunk * tileCount];
+	SoftStats &chunkStat = chunkStats[chunk];
+	triangles.clear();
+	for (int tile = 0; tile < tileCount; ++tile) chunkBins[tile].clear();
+
+	Frustum frustum;
+	frustum.fromMatrix(viewProjection);
+	std::vector<ClipVertex> transformed;
+
+	// Window coordinates, snapped, and the triangle's bounds and bins
+	auto emit = [&](const ClipVertex &a, const ClipVertex &b, const ClipVertex &c) {
+		const ClipVertex *corners[3] = { &a, &b, &c };
+		Triangle triangle;
+		for (int k = 0; k < 3; ++k) {
+			const ClipVertex &v = *corners[k];
+			float invW = 1.0f / v.position.w;
+			glm::vec3 ndc = glm::vec3(v.position) * invW;
+			triangle.x[k] = std::min(std::max((int32_t)lroundf((ndc.x * 0.5f + 0.5f) * width * subpixels), 0), width * subpixels);
+			triangle.y[k] = std::min(std::max((int32_t)lroundf((ndc.y * 0.5f + 0.5f) * height * subpixels), 0), height * subpixels);
+			triangle.z[k] = ndc.z * 0.5f + 0.5f;
+			triangle.invW[k] = invW;
+			triangle.color[k] = v.color * invW;
+			triangle.uv[k] = v.uv * invW;
+		}
+
+		// Counter-clockwise in window space is front facing; back faces and slivers
+		// that snapped to nothing are dropped
+		int64_t area = (int64_t)(triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+			- (int64_t)(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area <= 0) return;
+
+		// Pixels whose centers (at +half a pixel) lie within the bounds
+		int32_t minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		int32_t maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		int32_t minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		int32_t maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		triangle.minX = (minX + subpixels / 2 - 1) >> subpixelBits;
+		triangle.minY = (minY + subpixels / 2 - 1) >> subpixelBits;
+		triangle.maxX = std::min((maxX - subpixels / 2) >> subpixelBits, width - 1);
+		triangle.maxY = std::min((maxY - subpixels / 2) >> subpixelBits, height - 1);
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+		triangle.invArea = 1.0f / (float)area;
+		triangle.texture = texture;
+
+		uint32_t index = (uint32_t)triangles.size();
+		triangles.push_back(triangle);
+		++chunkStat.rasterized;
+		for (int ty = triangle.minY / tileSize; ty <= triangle.maxY / tileSize; ++ty) {
+			for (int tx = triangle.minX / tileSize; tx <= triangle.maxX / tileSize; ++tx) {
+				chunkBins[ty * tilesX + tx].push_back(index);
+				++chunkStat.binned;
+			}
+		}
+	};
+
+	size_t end = std::min(count, (size_t)(chunk + 1) * chunkInstances);
+	for (size_t instance = (size_t)chunk * chunkInstances; instance < end; ++instance) {
+		if (outsideFrustum(frustum, TransformUnitBounds(transforms[instance]))) continue;
+
+		const int level = levels ? levels[instance] : 0;
+		const MeshContainerLevel &meshLevel = mesh.levels[level];
+		const SoftVertex *vertices = mesh.vertices.data() + meshLevel.baseVertex;
+		const uint32_t *indices = mesh.indices.data() + meshLevel.firstIndex;
+
+		// The vertex shader: MVP * position, and vertex color times the tint
+		glm::mat4 mvp = viewProjection * transforms[instance];
+		uint32_t color = colors[instance];
+		glm::vec3 tint = glm::vec3(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff) / 255.0f;
+		transformed.resize(mesh.levelVertexCounts[level]);
+		for (size_t v = 0; v < transformed.size(); ++v) {
+			transformed[v].position = mvp * glm::vec4(vertices[v].position, 1.0f);
+			transformed[v].color = vertices[v].color * tint;
+			transformed[v].uv = vertices[v].uv;
+		}
+
+		for (uint32_t i = 0; i + 2 < meshLevel.indexCount; i += 3) {
+			ClipVertex polygon[9] = { transformed[indices[i]], transformed[indices[i + 1]], transformed[indices[i + 2]] };
+			++chunkStat.triangles;
+
+			int codes[3] = { outcode(polygon[0].position), outcode(polygon[1].position), outcode(polygon[2].position) };
+			if (codes[0] & codes[1] & codes[2]) continue;		// All outside one plane
+			int crossed = codes[0] | codes[1] | codes[2];
+			if (crossed == 0) {
+				emit(polygon[0], polygon[1], polygon[2]);
+				continue;
+			}
+			int n = clipPolygon(polygon, crossed);
+			for (int k = 1; k + 1 < n; ++k) emit(polygon[0], polygon[k], polygon[k + 1]);
+		}
+	}
+}
+
+// Shade pixel (x, y) of the triangle that is visible there
+static void shadePixel(const SoftRasterizer::Triangle &triangle, int x, int y, uint8_t *pixel) {
+	// Barycentric coordinates from the edge functions at the pixel center, and
+	// their screen derivatives
+	int32_t px = x * subpixels + subpixels / 2, py = y * subpixels + subpixels / 2;
+	glm::vec3 b, dbdx, dbdy;
+	for (int k = 0; k < 3; ++k) {
+		int from = (k + 1) % 3, to = (k + 2) % 3;
+		int32_t edgeA = triangle.y[from] - triangle.y[to], edgeB = triangle.x[to] - triangle.x[from];
+		b[k] = (float)((int64_t)edgeA * (px - triangle.x[from]) + (int64_t)edgeB * (py - triangle.y[from])) * triangle.invArea;
+		dbdx[k] = (float)(edgeA * subpixels) * triangle.invArea;
+		dbdy[k] = (float)(edgeB * subpixels) * triangle.invArea;
+	}
+
+	// Attributes were divided by w at the vertices: interpolate, then divide by the interpolated 1/w
+	float q = b.x * triangle.invW[0] + b.y * triangle.invW[1] + b.z * triangle.invW[2];
+	float w = 1.0f / q;
+	glm::vec3 color = (b.x * triangle.color[0] + b.y * triangle.color[1] + b.z * triangle.color[2]) * w;
+
+	if (triangle.texture) {
+		glm::vec2 uvOverW = b.x * triangle.uv[0] + b.y * triangle.uv[1] + b.z * triangle.uv[2];
+		glm::vec2 uv = uvOverW * w;
+
+		// Screen derivatives of uv, from the quotient rule on (uv / w) / (1 / w)
+		glm::vec2 uvOverWDx = dbdx.x * triangle.uv[0] + dbdx.y * triangle.uv[1] + dbdx.z * triangle.uv[2];
+		glm::vec2 uvOverWDy = dbdy.x * triangle.uv[0] + dbdy.y * triangle.uv[1] + dbdy.z * triangle.uv[2];
+		float qDx = dbdx.x * triangle.invW[0] + dbdx.y * triangle.invW[1] + dbdx.z * triangle.invW[2];
+		float qDy = dbdy.x * triangle.invW[0] + dbdy.y * triangle.invW[1] + dbdy.z * triangle.invW[2];
+		glm::vec2 uvDx = (uvOverWDx - uv * qDx) * w;
+		glm::vec2 uvDy = (uvOverWDy - uv * qDy) * w;
+
+		color *= triangle.texture->sample(uv, uvDx, uvDy);
+	}
+
+	color = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+	pixel[0] = (uint8_t)color.x;
+	pixel[1] = (uint8_t)color.y;
+	pixel[2] = (uint8_t)color.z;
+}
+
+void SoftRasterizer::rasterizeTile(int tile, int chunkCount, SoftTarget &target) {
+	int tileX0 = (tile % tilesX) * tileSize, tileY0 = (tile / tilesX) * tileSize;
+	int tileX1 = std::min(tileX0 + tileSize, target.width) - 1, tileY1 = std::min(tileY0 + tileSize, target.height) - 1;
+	int tileCount = tilesX * tilesY;
+
+	// The tile's depth, padded for four-pixel loads past its last pixel, and the
+	// triangle visible at each pixel, NULL where the clear color shows
+	float depth[tileSize * tileSize + 4];
+	const Triangle *visible[tileSize * tileSize];
+	std::fill(depth, depth + tileSize * tileSize + 4, 1.0f);
+	std::fill(visible, visible + tileSize * tileSize, (const Triangle *)NULL);
+
+	// Visibility: depth test every covered pixel of every triangle binned here,
+	// in submission order, but shade nothing yet
+	long long fragments = 0;
+	for (int chunk = 0; chunk < chunkCount; ++chunk) {
+		const std::vector<Triangle> &triangles = chunkTriangles[chunk];
+		for (uint32_t index : bins[(size_t)chunk * tileCount + tile]) {
+			const Triangle &triangle = triangles[index];
+			int minX = std::max(triangle.minX, tileX0), maxX = std::min(triangle.maxX, tileX1);
+			int minY = std::max(triangle.minY, tileY0), maxY = std::min(triangle.maxY, tileY1);
+			if (minX > maxX || minY > maxY) continue;
+
+			// Edge k runs between the two vertices other than k and is positive on the
+			// triangle's side. Edges that are not top or left (the interior is below
+			// or to the right) exclude pixels exactly on them: bias them by -1.
+			int32_t a[3], b[3], row[3];
+			int32_t px = minX * subpixels + subpixels / 2, py = minY * subpixels + subpixels / 2;
+			for (int k = 0; k < 3; ++k) {
+				int from = (k + 1) % 3, to = (k + 2) % 3;
+				a[k] = triangle.y[from] - triangle.y[to];
+				b[k] = triangle.x[to] - triangle.x[from];
+				bool topLeft = a[k] > 0 || (a[k] == 0 && b[k] < 0);
+				row[k] = (int32_t)((int64_t)a[k] * (px - triangle.x[from]) + (int64_t)b[k] * (py - triangle.y[from]) - (topLeft ? 0 : 1));
+			}
+
+#ifdef RASTER_SSE2
+			// Four neighboring pixels of a row at once. Lanes past maxX may wrap
+			// around; they are masked off.
+			__m128i stepX[3], groupStep[3];
+			for (int k = 0; k < 3; ++k) {
+				// step * lane (0, 1, 2, 3), without SSE4.1's 32-bit multiply
+				__m128i step = _mm_set1_epi32(a[k] * subpixels);
+				__m128i odd = _mm_and_si128(step, _mm_set_epi32(-1, 0, -1, 0));
+				__m128i high = _mm_and_si128(_mm_slli_epi32(step, 1), _mm_set_epi32(-1, -1, 0, 0));
+				stepX[k] = _mm_add_epi32(odd, high);
+				groupStep[k] = _mm_slli_epi32(step, 2);
+			}
+			__m128 invArea = _mm_set1_ps(triangle.invArea);
+			__m128 z0 = _mm_set1_ps(triangle.z[0]), z1 = _mm_set1_ps(triangle.z[1]), z2 = _mm_set1_ps(triangle.z[2]);
+#endif
+
+			for (int y = minY; y <= maxY; ++y) {
+				int rowStart = (y - tileY0) * tileSize - tileX0;
+#ifdef RASTER_SSE2
+				__m128i e0 = _mm_add_epi32(_mm_set1_epi32(row[0]), stepX[0]);
+				__m128i e1 = _mm_add_epi32(_mm_set1_epi32(row[1]), stepX[1]);
+				__m128i e2 = _mm_add_epi32(_mm_set1_epi32(row[2]), stepX[2]);
+				for (int x = minX; x <= maxX; x += 4) {
+					// A pixel is inside when no edge function is negative
+					int mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(_mm_or_si128(e0, e1), e2))) & 0xf;
+					if (maxX - x < 3) mask &= (1 << (maxX - x + 1)) - 1;
+					if (mask) {
+						__m128 z = _mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(e0), invArea), z0),
+							_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(e1), invArea), z1)),
+							_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(e2), invArea), z2));
+						float *depthPixels = depth + rowStart + x;
+						__m128 old = _mm_loadu_ps(depthPixels);
+						mask &= _mm_movemask_ps(_mm_cmplt_ps(z, old));
+						if (mask) {
+							static const int laneBits[4] = { 1, 2, 4, 8 };
+							__m128i lanes = _mm_set_epi32(mask & 8, mask & 4, mask & 2, mask & 1);
+							__m128 pass = _mm_castsi128_ps(_mm_cmpeq_epi32(lanes, _mm_loadu_si128((const __m128i *)laneBits)));
+							_mm_storeu_ps(depthPixels, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+							for (int lane = 0; lane < 4; ++lane) {
+								if (mask & (1 << lane)) {
+									visible[rowStart + x + lane] = &triangle;
+									++fragments;
+								}
+							}
+						}
+					}
+					e0 = _mm_add_epi32(e0, groupStep[0]);
+					e1 = _mm_add_epi32(e1, groupStep[1]);
+					e2 = _mm_add_epi32(e2, groupStep[2]);
+				}
+#else
+				int32_t e[3] = { row[0], row[1], row[2] };
+				for (int x = minX; x <= maxX; ++x) {
+					if ((e[0] | e[1] | e[2]) >= 0) {
+						float z = (float)e[0] * triangle.invArea * triangle.z[0] + (float)e[1] * triangle.invArea * triangle.z[1]
+							+ (float)e[2] * triangle.invArea * triangle.z[2];
+						if (z < depth[rowStart + x]) {
+							depth[rowStart + x] = z;
+							visible[rowStart + x] = &triangle;
+							++fragments;
+						}
+					}
+					if (x < maxX) {
+						for (int k = 0; k < 3; ++k) e[k] += a[k] * subpixels;
+					}
+				}
+#endif
+				for (int k = 0; k < 3; ++k) row[k] += b[k] * subpixels;
+			}
+		}
+	}
+
+	// Shading: once per pixel, however many triangles were drawn over it
+	glm::vec3 clear = glm::clamp(clearColor, 0.0f, 1.0f) * 255.0f + 0.5f;
+	for (int y = tileY0; y <= tileY1; ++y) {
+		const Triangle *const *visibleRow = visible + (y - tileY0) * tileSize;
+		uint8_t *pixel = &target.color[((size_t)y * target.width + tileX0) * 3];
+		for (int x = tileX0; x <= tileX1; ++x, pixel += 3) {
+			const Triangle *triangle = visibleRow[x - tileX0];
+			if (triangle) {
+				shadePixel(*triangle, x, y, pixel);
+			} else {
+				pixel[0] = (uint8_t)clear.x;
+				pixel[1] = (uint8_t)clear.y;
+				pixel[2] = (uint8_t)clear.z;
+			}
+		}
+	}
+	tileFragments[tile] = fragments;
+}
@@ -0,0 +1,126 @@
+#ifndef _SOFT_RASTERIZER_H_
+#define _SOFT_RASTERIZER_H_
+
+#include <io/mesh_container.h>
+#include <image/mipmap.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ThreadPool;
+
+struct SoftVertex {
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 uv;
+};
+
+// A mesh decoded for the software rasterizer: float vertices, 32-bit indices
+// relative to each level's base vertex, finest level first
+struct SoftMesh {
+	std::vector<SoftVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshContainerLevel> levels;
+	std::vector<uint32_t> levelVertexCounts;	// Vertices from each level's base vertex its indices reach
+
+	// Decode a mesh with float attributes and 32-bit indices, as built before
+	// OptimizeMesh(). Position is location 0, color 1 (white if missing) and UV 2.
+	bool load(const MeshView &mesh);
+
+	// Coarsest level whose silhouette error stays below maxErrorPixels in both
+	// eyes, as Sphere::selectLevel() picks it for the GL renderer
+	int selectLevel(const glm::mat4 &modelMatrix, const glm::mat4 &leftCameraMatrix, const glm::mat4 &rightCameraMatrix,
+		float pixelScale, float maxErrorPixels) const;
+};
+
+// An RGB texture and its mip chain, sampled like GL_LINEAR_MIPMAP_LINEAR with GL_REPEAT
+struct SoftTexture {
+	std::vector<uint8_t> chain;
+	std::vector<MipLevel> levels;
+
+	void load(const uint8_t *rgb, int width, int height);
+
+	// Trilinear sample at the level of detail the UV derivatives (in pixels of the target) give
+	glm::vec3 sample(const glm::vec2 &uv, const glm::vec2 &uvDx, const glm::vec2 &uvDy) const;
+
+private:
+	glm::vec3 bilinear(int level, const glm::vec2 &uv) const;
+};
+
+// The color of one eye: tightly packed RGB rows, bottom-up like glReadPixels
+struct SoftTarget {
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> color;
+
+	void resize(int width, int height);
+};
+
+struct SoftStats {
+	long long triangles = 0;		// Triangles of the instances not rejected whole
+	long long rasterized = 0;		// Left after clipping and back-face culling
+	long long binned = 0;			// Triangle-tile pairs
+	long long fragments = 0;		// Depth test passes, overdraw included
+	double setupMilliseconds = 0;
+	double rasterMilliseconds = 0;
+};
+
+// Renders the scene's instances without a GPU, the way the GL box and sphere
+// programs draw them: vertex color times the instance tint, times the texture
+// when there is one, with counter-clockwise front faces, back faces culled and
+// a less-than depth test.
+//
+// A frame is drawn in two parallel phases. Setup transforms, clips and sets
+// up the triangles of fixed chunks of instances and bins them to the tiles
+// their bounds touch. Rasterization then gives each thread whole tiles, with
+// a depth buffer of the tile's own, so no two threads write the same pixels
+// and nothing is locked. Tiles walk the bins in chunk order, so the result
+// does not depend on the thread count. A tile first finds the triangle
+// visible at each pixel and only then shades, once per pixel, so overdraw
+// costs depth tests but no texture samples.
+//
+// Edge functions are exact integers on 28.4 fixed point vertices, with the
+// top-left fill rule, so triangles sharing an edge cover each pixel once.
+// They are evaluated four pixels at a time with SSE2, scalar elsewhere.
+struct SoftRasterizer {
+	static const int tileSize = 64;
+	static const int maxViewportSize = 2048;		// Keeps the edge functions within 32 bits
+	static const int chunkInstances = 256;
+
+	glm::vec3 clearColor = glm::vec3(163, 227, 255) / 255.0f;
+	SoftStats stats;
+
+	// Clear the target and draw `count` instances of the mesh, instance i with
+	// transforms[i], tint colors[i] (RGBA8, red in the low byte) and mesh level
+	// levels[i] (the finest for all when NULL). texture may be NULL.
+	void render(const SoftMesh &mesh, const SoftTexture *texture, const glm::mat4 *transforms, const uint32_t *colors,
+		const unsigned char *levels, size_t count, const glm::mat4 &viewProjection, SoftTarget &target, ThreadPool *pool);
+
+	// A triangle set up for rasterization
+	struct Triangle {
+		int32_t x[3], y[3];				// Window position, 28.4 fixed point, counter-clockwise
+		int minX, minY, maxX, maxY;		// Pixels whose centers the bounds cover, inside the viewport
+		float z[3];						// Window depth
+		float invW[3];
+		glm::vec3 color[3];				// Divided by w, for perspective-correct interpolation
+		glm::vec2 uv[3];
+		float invArea;					// 1 / twice the area, in fixed point units
+		const SoftTexture *texture;
+	};
+
+private:
+	int tilesX = 0, tilesY = 0;
+	std::vector<std::vector<Triangle>> chunkTriangles;		// Set up triangles of each chunk
+	std::vector<std::vector<uint32_t>> bins;				// [chunk * tiles + tile], indices into chunkTriangles[chunk]
+	std::vector<SoftStats> chunkStats;
+	std::vector<long long> tileFragments;
+
+	void setupChunk(int chunk, const SoftMesh &mesh, const SoftTexture *texture, const glm::mat4 *transforms, const uint32_t *colors,
+		const unsigned char *levels, size_t count, const glm::mat4 &viewProjection, int width, int height);
+	void rasterizeTile(int tile, int chunkCount, SoftTarget &target);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "draw_list.h"
+#include "render_state.h"
+#include "instance_data.h"
+
+#include <algorithm>
+
+void DrawList::add(const DrawCommand &command, float depth) {
+	// Key layout, most significant first: program 16 bits, vertex array 8, texture 16, depth 24
+	uint64_t quantizedDepth = (uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * 0xffffff);
+	commands.push_back(command);
+	commands.back().sortKey = ((uint64_t)(command.program & 0xffff) << 48) | ((uint64_t)(command.vertexArray & 0xff) << 40) 
+		| ((uint64_t)(command.texture & 0xffff) << 24) | quantizedDepth;
+}
+
+void DrawList::sort() {
+	std::sort(commands.begin(), commands.end(), [](const DrawCommand &a, const DrawCommand &b) { return a.sortKey < b.sortKey; });
+}
+
+void DrawList::mergeSorted(const std::vector<DrawList> &parts) {
+	commands.clear();
+	std::vector<size_t> bounds(1, 0);
+	for (const DrawList &part : parts) {
+		commands.insert(commands.end(), part.commands.begin(), part.commands.end());
+		bounds.push_back(commands.size());
+	}
+
+	// Merge neighbouring runs pairwise until one is left
+	auto byKey = [](const DrawCommand &a, const DrawCommand &b) { return a.sortKey < b.sortKey; };
+	for (size_t width = 1; width + 1 < bounds.size(); width *= 2) {
+		for (size_t i = 0; i + width + 1 < bounds.size(); i += 2 * width) {
+			size_t last = std::min(i + 2 * width, bounds.size() - 1);
+			std::inplace_merge(commands.begin() + bounds[i], commands.begin() + bounds[i + width], commands.begin() + bounds[last], byKey);
+		}
+	}
+}
+
+void DrawList::submit() const {
+	for (const DrawCommand &command : commands) {
+		renderState.useProgram(command.program);
+		renderState.bindVertexArray(command.vertexArray);
+		if (command.texture) renderState.bindTexture(0, command.texture);
+
+		glUniformMatrix4fv(command.mvpLocation, 1, GL_FALSE, &command.mvp[0][0]);
+		if (command.tintLocation >= 0) {
+			glm::vec4 tint = UnpackColor(command.color);
+			glUniform4fv(command.tintLocation, 1, &tint[0]);
+		}
+		GLsizeiptr indexSize = command.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		glDrawElementsBaseVertex(GL_TRIANGLES, command.indexCount, command.indexType, (void*)(indexSize * command.firstIndex), command.baseVertex);
+		renderState.countDraw(command.indexCount);
+	}
+}
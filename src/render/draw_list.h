@@ -0,0 +1,44 @@
+#ifndef _DRAW_LIST_H_
+#define _DRAW_LIST_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// One indexed draw with everything needed to issue it
+struct DrawCommand {
+	uint64_t sortKey;
+	GLuint program;
+	GLuint vertexArray;
+	GLuint texture;			// 0 for untextured programs
+	GLint mvpLocation;
+	GLint tintLocation;		// -1 for programs without a tint
+	uint32_t color;			// RGBA8 tint of the object
+	GLsizei indexCount;
+	GLsizei firstIndex;
+	GLenum indexType;		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLint baseVertex;
+	glm::mat4 mvp;
+};
+
+// Collects draws for one pass, sorts them by program, vertex array, texture 
+// and then front to back, and submits them through renderState so consecutive 
+// draws sharing state do not rebind it.
+struct DrawList {
+	std::vector<DrawCommand> commands;
+
+	void clear() { commands.clear(); }
+
+	// depth is the view distance normalized to [0, 1] (clip w / zFar)
+	void add(const DrawCommand &command, float depth);
+
+	void sort();
+	void submit() const;
+
+	// Replace the commands with the union of lists that are each sorted already
+	void mergeSorted(const std::vector<DrawList> &parts);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void DynamicResolution::initialize() {
+	glGenQueries(2 * queryFrames, &queries[0][0]);
+	reset();
+}
+
+void DynamicResolution::cleanup() {
+	glDeleteQueries(2 * queryFrames, &queries[0][0]);
+	for (int i = 0; i < queryFrames; ++i) issued[i] = false;
+}
+
+void DynamicResolution::reset() {
+	scale = maxScale;
+	gpuMilliseconds = 0;
+	changes = 0;
+	settleFrames = queryFrames - 1;
+}
+
+void DynamicResolution::beginFrame() {
+	// This slot was issued queryFrames frames ago and is almost always done. A
+	// result that is not is dropped rather than waited for.
+	int slot = frame % queryFrames;
+	if (issued[slot]) {
+		issued[slot] = false;
+		GLuint available = 0;
+		glGetQueryObjectuiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+			update((end - begin) * 1e-6);
+		}
+	}
+	glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::endFrame() {
+	int slot = frame % queryFrames;
+	glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+	issued[slot] = true;
+	++frame;
+}
+
+void DynamicResolution::update(double milliseconds) {
+	// Frames already submitted at the old scale
+	if (settleFrames > 0) {
+		--settleFrames;
+		return;
+	}
+	gpuMilliseconds = gpuMilliseconds > 0 ? 0.8 * gpuMilliseconds + 0.2 * milliseconds : milliseconds;
+
+	float ideal = scale * (float)sqrt(budgetMilliseconds * headroom / std::max(gpuMilliseconds, 1e-3));
+	float next = scale;
+	if (ideal < scale) {
+		// Over budget: drop straight to the scale that fits
+		next = floorf(ideal / scaleStep) * scaleStep;
+	} else if (ideal >= scale + scaleStep) {
+		// Under budget: grow a step at a time, and only when the larger step fits too
+		next = scale + scaleStep;
+	}
+	next = std::min(std::max(next, minScale), maxScale);
+	if (fabsf(next - scale) < 0.5f * scaleStep) return;
+
+	if (logChanges) {
+		std::cout << "Resolution scale " << scale << " -> " << next << " (GPU " << gpuMilliseconds
+			<< " ms, budget " << budgetMilliseconds << " ms)" << std::endl;
+	}
+	scale = next;
+	++changes;
+	gpuMilliseconds = 0;
+	settleFrames = queryFrames - 1;
+}
+
+void DynamicResolution::eyeSize(int width, int height, int &eyeWidth, int &eyeHeight) const {
+	eyeWidth = std::max(1, (int)lroundf(width * scale));
+	eyeHeight = std::max(1, (int)lroundf(height * scale));
+}
@@ -0,0 +1,54 @@
+#ifndef _DYNAMIC_RESOLUTION_H_
+#define _DYNAMIC_RESOLUTION_H_
+
+#include <glad/gl.h>
+
+// Picks the resolution of the eyes so the GPU time of a frame stays within a
+// budget. The time comes from timestamp queries around the frame, read a few
+// frames late so they never stall. Timestamps, unlike GL_TIME_ELAPSED, can
+// overlap the profiler's sections.
+//
+// The cost of a frame is taken as proportional to its pixels, so the scale
+// (per axis) moves by the square root of budget / time. Scales are multiples
+// of scaleStep, so the eye targets are only reallocated when the choice
+// really moves, and after a change the controller waits for frames drawn at
+// the new scale before judging it.
+struct DynamicResolution {
+	static const int queryFrames = 4;
+
+	// Tuning
+	double budgetMilliseconds = 16.6;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float scaleStep = 0.05f;
+	double headroom = 0.9;				// Aim below the budget, so noise does not push frames over it
+	bool logChanges = false;			// Print every change of scale with the time that caused it
+
+	float scale = 1.0f;					// Per axis, of the window size
+	double gpuMilliseconds = 0;			// Smoothed GPU time of recent frames
+	int changes = 0;
+
+	GLuint queries[queryFrames][2] = {};
+	bool issued[queryFrames] = {};
+	int frame = 0;
+	int settleFrames = 0;				// Frames to skip until results are at the current scale
+
+	void initialize();
+	void cleanup();
+
+	// Start over at maxScale, ignoring frames already in flight
+	void reset();
+
+	// Bracket the GPU work of a frame. beginFrame() also reads finished results
+	// and updates the scale.
+	void beginFrame();
+	void endFrame();
+
+	// Size of each eye for a window of width x height at the current scale
+	void eyeSize(int width, int height, int &eyeWidth, int &eyeHeight) const;
+
+private:
+	void update(double milliseconds);
+};
+
+#endif
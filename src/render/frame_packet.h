@@ -0,0 +1,60 @@
+#ifndef _FRAME_PACKET_H_
+#define _FRAME_PACKET_H_
+
+#include <glm/glm.hpp>
+
+#include <render/draw_list.h>
+#include <image/anaglyph_compose.h>
+#include <scene/culling.h>
+#include <scene/stereo_camera.h>
+
+#include <vector>
+
+// Instances grouped by sphere level for instanced drawing, built once per frame 
+// and drawn by both eyes
+struct SphereLevelGroups {
+	unsigned version = 0;			// Changes whenever the grouping does, 0 before the first
+	std::vector<int> order;			// Instances, finest level's first
+	std::vector<int> first, count;	// Range of `order` at each level
+};
+
+// Everything a frame's pixels depend on, compared between frames to find out 
+// whether the last one can be shown again instead of rendering a new one
+struct FrameInputs {
+	glm::mat4 projectionMatrix = glm::mat4(0);
+	int width = 0, height = 0;
+	glm::vec3 eyeCenter, lookat, up;
+	float FoV = 0, zNear = 0, zFar = 0, aspect = 0, viewDistance = 0, ipd = 0;
+	AnaglyphMode anaglyphMode = None;
+	AnaglyphMatrix compositeMatrix = PureRedCyan;
+	unsigned sceneVersion = 0;
+	bool useSphereScene = false, useInstancing = false, useSphereLOD = false, useSphereImpostors = false;
+	bool useSinglePassStereo = false, useReprojection = false, useCulling = false, useDynamicResolution = false;
+
+	bool operator==(const FrameInputs &other) const;
+	bool operator!=(const FrameInputs &other) const { return !(*this == other); }
+};
+
+// The CPU side of one frame: per-eye matrices, visible instances, sphere 
+// levels and sorted draws, prepared off the render thread from a snapshot of 
+// the renderer's inputs. The render thread only reads it while submitting.
+struct FramePacket {
+	FrameInputs inputs;
+
+	glm::mat4 vpLeft, vpRight;					// Both the mono view-projection without an anaglyph mode
+	std::vector<int> visibleLeft, visibleRight, visibleEither;	// Filled when culling
+	CullStats cullStats;
+	std::vector<unsigned char> sphereLevels;	// Level of every instance, when spheres use level of detail
+	SphereLevelGroups sphereGroups;				// The instances drawn by level, when those are instanced
+
+	// Per-object draws of each pass, sorted. Empty when the pass is instanced.
+	DrawList drawsLeft, drawsRight;
+
+	// Scratch of the preparation, kept to reuse its memory
+	std::vector<glm::mat4> mvpsLeft, mvpsRight;
+	std::vector<DrawList> partsLeft, partsRight;
+
+	double prepareMilliseconds = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "frame_pipeline.h"
+
+void FramePipeline::start(const std::function<void(FramePacket &)> &prepare) {
+	this->prepare = prepare;
+	stopping = false;
+	requested = released = 0;
+	thread = std::thread(&FramePipeline::run, this);
+}
+
+void FramePipeline::stop() {
+	if (!thread.joinable()) return;
+	discard();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	requestSignal.notify_one();
+	thread.join();
+}
+
+void FramePipeline::request() {
+	requests.push(requested % packetCount);
+	++requested;
+
+	// Taking the lock orders the push before the worker's check for requests, so the wakeup cannot be lost
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	requestSignal.notify_one();
+}
+
+FramePacket &FramePipeline::waitPrepared() {
+	int index;
+	while (!prepared.pop(index)) {
+		std::unique_lock<std::mutex> lock(mutex);
+		preparedSignal.wait(lock, [this] { return !prepared.empty(); });
+	}
+	return packets[index];
+}
+
+void FramePipeline::release() {
+	++released;
+}
+
+void FramePipeline::discard() {
+	while (outstanding() > 0) {
+		waitPrepared();
+		release();
+	}
+}
+
+void FramePipeline::run() {
+	for (;;) {
+		int index;
+		while (!requests.pop(index)) {
+			std::unique_lock<std::mutex> lock(mutex);
+			requestSignal.wait(lock, [this] { return stopping || !requests.empty(); });
+			if (stopping) return;
+		}
+
+		prepare(packets[index]);
+		prepared.push(index);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+		}
+		preparedSignal.notify_one();
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef _FRAME_PIPELINE_H_
+#define _FRAME_PIPELINE_H_
+
+#include <render/frame_packet.h>
+#include <util/spsc_queue.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Prepares frame packets on a worker thread while the render thread submits 
+// earlier ones. Two packets alternate: the render thread fills the inputs of 
+// the free one and requests it, the worker prepares it and hands it back 
+// through a lock-free queue, and the render thread submits and releases it. 
+// So frame N+1 can be prepared while frame N is submitted.
+struct FramePipeline {
+	static const int packetCount = 2;
+	FramePacket packets[packetCount];
+
+	SPSCQueue<int, packetCount> requests;	// Render thread -> worker
+	SPSCQueue<int, packetCount> prepared;	// Worker -> render thread
+	std::function<void(FramePacket &)> prepare;
+
+	// Only for sleeping when a queue is empty; the packets go through the queues
+	std::mutex mutex;
+	std::condition_variable requestSignal;
+	std::condition_variable preparedSignal;
+	std::atomic<bool> stopping{false};
+	std::thread thread;
+
+	// Render thread only
+	int requested = 0;
+	int released = 0;
+
+	void start(const std::function<void(FramePacket &)> &prepare);
+	void stop();
+
+	int outstanding() const { return requested - released; }
+	bool full() const { return outstanding() == packetCount; }
+
+	// The packet to fill next. The pipeline must not be full.
+	FramePacket &nextFree() { return packets[requested % packetCount]; }
+
+	// Hand nextFree() to the worker
+	void request();
+
+	// Wait until the oldest outstanding packet is prepared and return it
+	FramePacket &waitPrepared();
+
+	// Done with the packet from waitPrepared(), it may be reused
+	void release();
+
+	// Wait for all outstanding packets and drop them
+	void discard();
+
+	void run();
+};
+
+#endif
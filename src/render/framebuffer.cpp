@@ -0,0 +1,45 @@
+#include "framebuffer.h"
+#include "render_state.h"
+
+#include <iostream>
+
+void Framebuffer::initialize(int width, int height) {
+	glGenFramebuffers(1, &framebufferID);
+	glGenTextures(1, &colorTextureID);
+	glGenRenderbuffers(1, &depthRenderbufferID);
+	resize(width, height);
+}
+
+void Framebuffer::resize(int width, int height) {
+	this->width = width;
+	this->height = height;
+
+	renderState.bindTexture(0, colorTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbufferID);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Offscreen framebuffer is incomplete." << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::bind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glViewport(0, 0, width, height);
+}
+
+void Framebuffer::cleanup() {
+	glDeleteFramebuffers(1, &framebufferID);
+	glDeleteTextures(1, &colorTextureID);
+	glDeleteRenderbuffers(1, &depthRenderbufferID);
+}
@@ -0,0 +1,25 @@
+#ifndef _FRAMEBUFFER_H_
+#define _FRAMEBUFFER_H_
+
+#include <glad/gl.h>
+
+// Offscreen render target with an RGB color texture and a depth renderbuffer
+struct Framebuffer {
+	GLuint framebufferID = 0;
+	GLuint colorTextureID = 0;
+	GLuint depthRenderbufferID = 0;
+	int width = 0;
+	int height = 0;
+
+	void initialize(int width, int height);
+
+	// (Re)allocate the attachments
+	void resize(int width, int height);
+
+	// Bind for drawing and set the viewport to cover the whole target
+	void bind();
+
+	void cleanup();
+};
+
+#endif
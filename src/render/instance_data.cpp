@@ -0,0 +1,33 @@
+#include "instance_data.h"
+
+void PackInstances(const glm::mat4 *transforms, const uint32_t *colors, const int *indices, size_t count, InstanceData *out) {
+	for (size_t i = 0; i < count; ++i) {
+		size_t instance = indices ? indices[i] : i;
+		out[i].model = transforms[instance];
+		out[i].color = colors[instance];
+	}
+}
+
+void PointInstanceAttributes(GLintptr offset) {
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + sizeof(glm::vec4) * i));
+	}
+	glVertexAttribPointer(7, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, color)));
+}
+
+void EnableInstanceAttributes() {
+	for (int i = 3; i <= 7; ++i) {
+		glEnableVertexAttribArray(i);
+	}
+	SetInstanceDivisor(1);
+}
+
+void SetInstanceDivisor(GLuint divisor) {
+	for (int i = 3; i <= 7; ++i) {
+		glVertexAttribDivisor(i, divisor);
+	}
+}
+
+glm::vec4 UnpackColor(uint32_t color) {
+	return glm::vec4(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, color >> 24) / 255.0f;
+}
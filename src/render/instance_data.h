@@ -0,0 +1,34 @@
+#ifndef _INSTANCE_DATA_H_
+#define _INSTANCE_DATA_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-instance vertex attributes of the instanced programs: the model matrix 
+// in locations 3 to 6, one column each, and an RGBA8 tint in location 7.
+struct InstanceData {
+	glm::mat4 model;
+	uint32_t color;
+};
+
+// Interleave the attributes of `count` instances into out: instance i is 
+// indices[i], or i when indices is NULL
+void PackInstances(const glm::mat4 *transforms, const uint32_t *colors, const int *indices, size_t count, InstanceData *out);
+
+// Point the instance attributes of the bound vertex array at the InstanceData 
+// starting `offset` bytes into the buffer bound to GL_ARRAY_BUFFER
+void PointInstanceAttributes(GLintptr offset);
+
+// Enable the instance attributes of the bound vertex array, advancing once per instance
+void EnableInstanceAttributes();
+
+// Advance the instance attributes every `divisor` instances
+void SetInstanceDivisor(GLuint divisor);
+
+// Tint as the vec4 the shaders see
+glm::vec4 UnpackColor(uint32_t color);
+
+#endif
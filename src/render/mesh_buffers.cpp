@@ -0,0 +1,64 @@
+#include "mesh_buffers.h"
+#include "render_state.h"
+
+bool MeshBuffers::upload(const MeshView &mesh) {
+	cleanup();
+	const MeshContainerHeader &header = *mesh.header;
+	if (header.vertexCount == 0 || header.indexCount == 0 || header.levelCount == 0) return false;
+
+	attributes.assign(mesh.attributes, mesh.attributes + header.attributeCount);
+	levels.assign(mesh.levels, mesh.levels + header.levelCount);
+	vertexStride = (GLsizei)header.vertexStride;
+	indexType = header.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+	glGenBuffers(1, &vertexBufferID);
+	renderState.bindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)header.vertexCount * header.vertexStride, mesh.vertices, GL_STATIC_DRAW);
+
+	// The element binding belongs to the vertex array, keep whichever one is bound out of it
+	renderState.bindVertexArray(0);
+	glGenBuffers(1, &indexBufferID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)header.indexCount * header.indexSize, mesh.indices, GL_STATIC_DRAW);
+	return true;
+}
+
+bool MeshBuffers::load(const std::string &path) {
+	MeshContainer container;
+	if (!container.open(path)) return false;
+	return upload(container.mesh);
+}
+
+static GLenum attributeType(uint32_t type) {
+	switch (type) {
+	case MeshFloat16: return GL_HALF_FLOAT;
+	case MeshSnorm16: return GL_SHORT;
+	case MeshUnorm16: return GL_UNSIGNED_SHORT;
+	case MeshUnorm8: return GL_UNSIGNED_BYTE;
+	default: return GL_FLOAT;
+	}
+}
+
+// Integer types are read by float shader inputs normalized to [0, 1] or [-1, 1]
+static GLboolean attributeNormalized(uint32_t type) {
+	return (type == MeshSnorm16 || type == MeshUnorm16 || type == MeshUnorm8) ? GL_TRUE : GL_FALSE;
+}
+
+void MeshBuffers::bindAttributes() const {
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	for (const MeshContainerAttribute &attribute : attributes) {
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.components, attributeType(attribute.type), attributeNormalized(attribute.type), vertexStride, (void *)(uintptr_t)attribute.offset);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+}
+
+void MeshBuffers::cleanup() {
+	if (vertexBufferID) glDeleteBuffers(1, &vertexBufferID);
+	if (indexBufferID) glDeleteBuffers(1, &indexBufferID);
+	vertexBufferID = indexBufferID = 0;
+	attributes.clear();
+	levels.clear();
+}
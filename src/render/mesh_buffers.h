@@ -0,0 +1,40 @@
+#ifndef _MESH_BUFFERS_H_
+#define _MESH_BUFFERS_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <io/mesh_container.h>
+
+#include <string>
+#include <vector>
+
+// A mesh's interleaved vertex buffer and index buffer on the GPU. Only the 
+// layout, bounds and level table stay in memory, none of the vertex data.
+struct MeshBuffers {
+	GLuint vertexBufferID = 0;
+	GLuint indexBufferID = 0;
+	std::vector<MeshContainerAttribute> attributes;
+	GLsizei vertexStride = 0;
+	GLenum indexType = GL_UNSIGNED_INT;			// GL_UNSIGNED_SHORT when the mesh fits 16-bit indices
+	std::vector<MeshContainerLevel> levels;		// Finest first
+	glm::vec3 boundsMin = glm::vec3(0), boundsMax = glm::vec3(0);
+
+	// Upload a mesh built in memory or mapped from a container
+	bool upload(const MeshView &mesh);
+
+	// Map a container and upload its buffers straight from the mapping, then unmap it
+	bool load(const std::string &path);
+
+	// Point the attributes of the bound vertex array at the vertex buffer and bind the index buffer
+	void bindAttributes() const;
+
+	// Element buffer offset of an index, for glDrawElements
+	const void *indexOffset(GLsizei firstIndex) const {
+		return (const void *)(uintptr_t)((indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)) * firstIndex);
+	}
+
+	void cleanup();
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+
+Profiler profiler;
+
+double Profiler::now() const {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+int Profiler::section(const char *name, bool gpu) {
+	for (size_t i = 0; i < sections.size(); ++i) {
+		if (sections[i].name == name) return (int)i;
+	}
+	Section section;
+	section.name = name;
+	section.gpu = gpu;
+	if (gpu) glGenQueries(2, section.queries);
+	section.cpuHistory.resize(historySize);
+	section.gpuHistory.resize(historySize);
+	sections.push_back(section);
+	return (int)sections.size() - 1;
+}
+
+void Profiler::record(int id, bool gpu, double begin, double duration) {
+	Section &section = sections[id];
+	if (gpu) {
+		section.gpuHistory[section.gpuCount++ % historySize] = duration * 1e-3;
+	} else {
+		section.cpuHistory[section.cpuCount++ % historySize] = duration * 1e-3;
+	}
+	if (tracing && traceEvents.size() < maxTraceEvents) {
+		TraceEvent event = { id, gpu, begin, duration };
+		traceEvents.push_back(event);
+	}
+}
+
+void Profiler::beginFrame() {
+	if (!enabled) return;
+	frameParity ^= 1;
+
+	// These queries were issued two frames ago and are almost always done. A 
+	// result that is not is dropped rather than waited for.
+	for (size_t i = 0; i < sections.size(); ++i) {
+		Section &section = sections[i];
+		if (!section.gpu || !section.issued[frameParity]) continue;
+		section.issued[frameParity] = false;
+
+		GLuint available = 0;
+		glGetQueryObjectuiv(section.queries[frameParity], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(section.queries[frameParity], GL_QUERY_RESULT, &nanoseconds);
+		record((int)i, true, section.traceBegin[frameParity], nanoseconds * 1e-3);
+	}
+}
+
+void Profiler::begin(int id) {
+	Section &section = sections[id];
+	section.cpuBegin = now();
+	// A GPU section inside another one only gets CPU time
+	if (section.gpu && gpuSectionOpen < 0 && !section.issued[frameParity]) {
+		glBeginQuery(GL_TIME_ELAPSED, section.queries[frameParity]);
+		gpuSectionOpen = id;
+		section.traceBegin[frameParity] = section.cpuBegin;
+	}
+}
+
+void Profiler::end(int id) {
+	Section &section = sections[id];
+	if (gpuSectionOpen == id) {
+		glEndQuery(GL_TIME_ELAPSED);
+		section.issued[frameParity] = true;
+		gpuSectionOpen = -1;
+	}
+	record(id, false, section.cpuBegin, now() - section.cpuBegin);
+}
+
+static Profiler::Stats computeStats(const std::vector<double> &history, int count) {
+	Profiler::Stats stats;
+	int n = std::min(count, (int)history.size());
+	if (n == 0) return stats;
+
+	std::vector<double> samples(history.begin(), history.begin() + n);
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (double sample : samples) sum += sample;
+	stats.samples = n;
+	stats.min = samples.front();
+	stats.average = sum / n;
+	stats.p99 = samples[std::min(n - 1, (int)(0.99 * n))];
+	return stats;
+}
+
+Profiler::Stats Profiler::cpuStats(int id) const {
+	return computeStats(sections[id].cpuHistory, sections[id].cpuCount);
+}
+
+Profiler::Stats Profiler::gpuStats(int id) const {
+	return computeStats(sections[id].gpuHistory, sections[id].gpuCount);
+}
+
+void Profiler::report(std::ostream &out) const {
+	out << std::fixed << std::setprecision(3);
+	out << "Section              CPU min/avg/p99 ms         GPU min/avg/p99 ms" << std::endl;
+	for (size_t i = 0; i < sections.size(); ++i) {
+		Stats cpu = cpuStats((int)i);
+		out << std::left << std::setw(20) << sections[i].name << std::right << " " 
+			<< std::setw(7) << cpu.min << " " << std::setw(7) << cpu.average << " " << std::setw(7) << cpu.p99;
+		if (sections[i].gpu) {
+			Stats gpu = gpuStats((int)i);
+			out << "    " << std::setw(7) << gpu.min << " " << std::setw(7) << gpu.average << " " << std::setw(7) << gpu.p99;
+		}
+		out << std::endl;
+	}
+	out.unsetf(std::ios::floatfield);
+	out << std::setprecision(6);
+}
+
+bool Profiler::writeTrace(const std::string &path) const {
+	FILE *file = fopen(path.c_str(), "w");
+	if (!file) return false;
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+	for (const TraceEvent &event : traceEvents) {
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", 
+			sections[event.section].name.c_str(), event.gpu ? 2 : 1, event.begin, event.duration);
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+void Profiler::cleanup() {
+	for (Section &section : sections) {
+		if (section.gpu) glDeleteQueries(2, section.queries);
+	}
+	sections.clear();
+	traceEvents.clear();
+}
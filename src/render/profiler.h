@@ -0,0 +1,89 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <glad/gl.h>
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// CPU and GPU timing of named sections of the frame. CPU time is wall time 
+// between begin() and end(); GPU time comes from GL_TIME_ELAPSED queries, two 
+// sets per section used on alternate frames, so results are read two frames 
+// later and never stall the pipeline. GPU sections must not nest (one 
+// GL_TIME_ELAPSED query can be active at a time); CPU-only sections may.
+struct Profiler {
+	static const int historySize = 256;		// Frames kept for the statistics
+	static const size_t maxTraceEvents = 1 << 20;
+
+	struct Section {
+		std::string name;
+		bool gpu = false;
+		GLuint queries[2] = { 0, 0 };
+		bool issued[2] = { false, false };
+		double cpuBegin = 0;				// Microseconds since start, of the open scope
+		double traceBegin[2] = { 0, 0 };	// CPU begin of each query set, to place GPU trace events
+
+		std::vector<double> cpuHistory;		// Milliseconds, ring buffers
+		std::vector<double> gpuHistory;
+		int cpuCount = 0;
+		int gpuCount = 0;
+	};
+
+	struct TraceEvent {
+		int section;
+		bool gpu;
+		double begin;			// Microseconds since start
+		double duration;
+	};
+
+	struct Stats {
+		double min = 0, average = 0, p99 = 0;
+		int samples = 0;
+	};
+
+	bool enabled = false;
+	bool tracing = false;		// Also keep every event for writeTrace()
+	int frameParity = 0;
+	std::vector<Section> sections;
+	std::vector<TraceEvent> traceEvents;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	int gpuSectionOpen = -1;
+
+	// Id of a section, created on first use
+	int section(const char *name, bool gpu);
+
+	// Flip query sets and collect the GPU results of two frames ago
+	void beginFrame();
+
+	void begin(int section);
+	void end(int section);
+
+	Stats cpuStats(int section) const;
+	Stats gpuStats(int section) const;
+
+	// One line per section: CPU and GPU min/avg/p99 in milliseconds
+	void report(std::ostream &out) const;
+
+	// Chrome trace-event JSON (chrome://tracing, Perfetto). CPU and GPU sections 
+	// are on separate rows; GPU events are placed at their submission time.
+	bool writeTrace(const std::string &path) const;
+
+	void cleanup();
+
+private:
+	double now() const;
+	void record(int section, bool gpu, double begin, double duration);
+};
+
+extern Profiler profiler;
+
+// Times the enclosing block as one section
+struct ProfileScope {
+	int id;
+	ProfileScope(const char *name, bool gpu) : id(profiler.enabled ? profiler.section(name, gpu) : -1) { if (id >= 0) profiler.begin(id); }
+	~ProfileScope() { if (id >= 0) profiler.end(id); }
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "readback.h"
+#include "render_state.h"
+
+#include <cstring>
+#include <iostream>
+
+void ReadbackRing::initialize(int width, int height, int count) {
+	this->width = width;
+	this->height = height;
+	head = 0;
+	pending = 0;
+	failures = 0;
+
+	pixelBufferIDs.resize(count);
+	fences.assign(count, (GLsync)0);
+	frameIndices.assign(count, -1);
+
+	glGenBuffers(count, pixelBufferIDs.data());
+	for (int i = 0; i < count; ++i) {
+		renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 3, NULL, GL_STREAM_READ);
+	}
+	renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ReadbackRing::request(int frameIndex) {
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[head]);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+	renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frameIndices[head] = frameIndex;
+
+	head = (head + 1) % (int)pixelBufferIDs.size();
+	++pending;
+}
+
+ReadbackResult ReadbackRing::collect(std::vector<unsigned char> &pixels, int &frameIndex, bool wait) {
+	if (pending == 0) return ReadbackNotReady;
+
+	int count = (int)pixelBufferIDs.size();
+	int oldest = (head - pending + count) % count;
+
+	GLenum status = glClientWaitSync(fences[oldest], wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+	if (status == GL_TIMEOUT_EXPIRED) return ReadbackNotReady;
+	glDeleteSync(fences[oldest]);
+	fences[oldest] = (GLsync)0;
+	frameIndex = frameIndices[oldest];
+	--pending;
+
+	if (status == GL_WAIT_FAILED) {
+		std::cerr << "Waiting for the readback of frame " << frameIndex << " failed" << std::endl;
+		++failures;
+		return ReadbackFailed;
+	}
+
+	size_t size = (size_t)width * height * 3;
+	pixels.resize(size);
+
+	renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[oldest]);
+	void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (data) {
+		memcpy(pixels.data(), data, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (!data) {
+		std::cerr << "Mapping the readback of frame " << frameIndex << " failed" << std::endl;
+		++failures;
+		return ReadbackFailed;
+	}
+	return ReadbackCollected;
+}
+
+void ReadbackRing::cleanup() {
+	for (GLsync fence : fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	glDeleteBuffers((GLsizei)pixelBufferIDs.size(), pixelBufferIDs.data());
+	pixelBufferIDs.clear();
+	fences.clear();
+	frameIndices.clear();
+	pending = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef _READBACK_H_
+#define _READBACK_H_
+
+#include <glad/gl.h>
+
+#include <vector>
+
+enum ReadbackResult {
+	ReadbackNotReady,		// Nothing pending, or the oldest frame is still on the GPU
+	ReadbackCollected,
+	ReadbackFailed,			// The oldest frame was lost; it is no longer pending
+};
+
+// Ring of pixel buffer objects for asynchronous glReadPixels. A frame is 
+// requested into the next free buffer and collected a few frames later, once 
+// its fence has signaled, so the copy overlaps with rendering the next frames.
+struct ReadbackRing {
+	std::vector<GLuint> pixelBufferIDs;
+	std::vector<GLsync> fences;
+	std::vector<int> frameIndices;
+	int width = 0;
+	int height = 0;
+	int head = 0;		// Next buffer to read into
+	int pending = 0;	// Requested but not yet collected
+	int failures = 0;	// Frames lost to a failed fence wait or buffer mapping
+
+	void initialize(int width, int height, int count);
+
+	bool full() const { return pending == (int)pixelBufferIDs.size(); }
+	bool empty() const { return pending == 0; }
+
+	// Start reading the RGB color of the bound read framebuffer. Must not be full.
+	void request(int frameIndex);
+
+	// Copy out the oldest pending frame (rows bottom-up, tightly packed RGB). 
+	// Without wait, returns ReadbackNotReady if the GPU has not finished it yet. 
+	// frameIndex is set for collected and failed frames.
+	ReadbackResult collect(std::vector<unsigned char> &pixels, int &frameIndex, bool wait);
+
+	void cleanup();
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "render_state.h"
+
+#include <cassert>
+#include <cstddef>
+
+RenderState renderState;
+
+void RenderState::useProgram(GLuint program) {
+	if (valid && this->program == program) {
+		++elided;
+		return;
+	}
+	if (!valid) invalidate();
+	glUseProgram(program);
+	this->program = program;
+	++issued;
+}
+
+void RenderState::bindVertexArray(GLuint vertexArray) {
+	if (valid && this->vertexArray == vertexArray) {
+		++elided;
+		return;
+	}
+	if (!valid) invalidate();
+	glBindVertexArray(vertexArray);
+	this->vertexArray = vertexArray;
+	++issued;
+}
+
+void RenderState::bindBuffer(GLenum target, GLuint buffer) {
+	GLuint *cached = NULL;
+	switch (target) {
+	case GL_ARRAY_BUFFER: cached = &arrayBuffer; break;
+	case GL_PIXEL_PACK_BUFFER: cached = &pixelPackBuffer; break;
+	case GL_PIXEL_UNPACK_BUFFER: cached = &pixelUnpackBuffer; break;
+	default: break;		// Element array bindings belong to the vertex array, not tracked
+	}
+
+	if (!valid) invalidate();
+	if (cached && *cached == buffer) {
+		++elided;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (cached) *cached = buffer;
+	++issued;
+}
+
+void RenderState::bindTexture(int unit, GLuint texture) {
+	assert(unit >= 0 && unit < maxTextureUnits);
+	if (!valid) invalidate();
+	// Callers edit the texture after binding it, so the unit is selected even when the bind is elided
+	if (activeTextureUnit != (GLenum)(GL_TEXTURE0 + unit)) {
+		activeTextureUnit = GL_TEXTURE0 + unit;
+		glActiveTexture(activeTextureUnit);
+		++issued;
+	}
+	if (textures[unit] == texture) {
+		++elided;
+		return;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	textures[unit] = texture;
+	++issued;
+}
+
+void RenderState::invalidate() {
+	// Values no real binding can have, so the next call of each kind goes through
+	program = vertexArray = arrayBuffer = pixelPackBuffer = pixelUnpackBuffer = ~0u;
+	activeTextureUnit = 0;
+	for (int i = 0; i < maxTextureUnits; ++i) textures[i] = ~0u;
+	valid = true;
+}
+
+void RenderState::beginFrame() {
+	lastIssued = issued;
+	lastElided = elided;
+	lastDrawCalls = drawCalls;
+	lastVertices = vertices;
+	issued = elided = drawCalls = 0;
+	vertices = 0;
+}
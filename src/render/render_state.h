@@ -0,0 +1,50 @@
+#ifndef _RENDER_STATE_H_
+#define _RENDER_STATE_H_
+
+#include <glad/gl.h>
+
+// Shadow copy of the GL bindings the renderer changes per draw. Binding calls 
+// go through here and are skipped when the object is already bound. Code that 
+// binds behind its back must call invalidate().
+struct RenderState {
+	static const int maxTextureUnits = 8;
+
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint arrayBuffer = 0;
+	GLuint pixelPackBuffer = 0;
+	GLuint pixelUnpackBuffer = 0;
+	GLenum activeTextureUnit = GL_TEXTURE0;
+	GLuint textures[maxTextureUnits] = {};
+	bool valid = false;		// False until the first call, or after invalidate()
+
+	// Counters, reset by beginFrame()
+	int issued = 0;
+	int elided = 0;
+	int drawCalls = 0;
+	long long vertices = 0;		// Vertices submitted: indices (or array vertices) times instances
+
+	// Totals of the previous frame, for reporting
+	int lastIssued = 0;
+	int lastElided = 0;
+	int lastDrawCalls = 0;
+	long long lastVertices = 0;
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindTexture(int unit, GLuint texture);		// GL_TEXTURE_2D on texture unit `unit`, which is left active
+
+	// Count a draw call issued by the caller, submitting `vertexCount` vertices
+	void countDraw(long long vertexCount) { ++drawCalls; vertices += vertexCount; }
+
+	// Forget every cached binding
+	void invalidate();
+
+	void beginFrame();
+};
+
+// The renderer has a single GL context
+extern RenderState renderState;
+
+#endif
@@ -0,0 +1,126 @@
+#include "reprojection.h"
+#include "stereo_target.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <iostream>
+
+void Reprojection::initialize(int width, int height) {
+	glGenFramebuffers(1, &framebufferID);
+	glGenTextures(1, &colorTextureID);
+	glGenTextures(1, &depthTextureID);
+	resize(width, height);
+
+	glGenVertexArrays(1, &vertexArrayID);
+
+	warpProgramID = LoadShaders("../src/reproject.vert", "../src/reproject.frag");
+	fillProgramID = LoadShaders("../src/composite.vert", "../src/hole_fill.frag");
+	if (warpProgramID == 0 || fillProgramID == 0) {
+		std::cerr << "Failed to load reprojection shaders." << std::endl;
+	}
+	loadUniforms();
+}
+
+void Reprojection::loadUniforms() {
+	warpColorSamplerID = glGetUniformLocation(warpProgramID, "colorTexture");
+	warpDepthSamplerID = glGetUniformLocation(warpProgramID, "depthTexture");
+	warpMatrixID = glGetUniformLocation(warpProgramID, "reprojection");
+	warpWidthID = glGetUniformLocation(warpProgramID, "eyeWidth");
+	renderState.useProgram(warpProgramID);
+	glUniform1i(warpColorSamplerID, 0);
+	glUniform1i(warpDepthSamplerID, 1);
+
+	fillColorSamplerID = glGetUniformLocation(fillProgramID, "warpedColor");
+	fillDepthSamplerID = glGetUniformLocation(fillProgramID, "warpedDepth");
+	fillRadiusID = glGetUniformLocation(fillProgramID, "searchRadius");
+	renderState.useProgram(fillProgramID);
+	glUniform1i(fillColorSamplerID, 0);
+	glUniform1i(fillDepthSamplerID, 1);
+}
+
+static void setNearestClamp() {
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void Reprojection::resize(int width, int height) {
+	this->width = width;
+	this->height = height;
+
+	renderState.bindTexture(0, colorTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	setNearestClamp();
+
+	renderState.bindTexture(0, depthTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	setNearestClamp();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Reprojection framebuffer is incomplete." << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Reprojection::warp(const StereoTarget &stereoTarget, const glm::mat4 &reprojection) {
+	if (stereoTarget.eyeWidth != width || stereoTarget.eyeHeight != height) {
+		resize(stereoTarget.eyeWidth, stereoTarget.eyeHeight);
+	}
+
+	// Clear to alpha 0, marking every pixel a hole until a point lands on it
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glViewport(0, 0, width, height);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+	// Background pixels sit on the far plane: keep them from being clipped, and 
+	// let them pass against the cleared depth
+	glEnable(GL_DEPTH_CLAMP);
+	glDepthFunc(GL_LEQUAL);
+
+	renderState.useProgram(warpProgramID);
+	renderState.bindVertexArray(vertexArrayID);
+	renderState.bindTexture(0, stereoTarget.colorTextureID);
+	renderState.bindTexture(1, stereoTarget.depthTextureID);
+	glUniformMatrix4fv(warpMatrixID, 1, GL_FALSE, &reprojection[0][0]);
+	glUniform1i(warpWidthID, width);
+
+	glDrawArrays(GL_POINTS, 0, width * height);
+	renderState.countDraw((long long)width * height);
+
+	glDepthFunc(GL_LESS);
+	glDisable(GL_DEPTH_CLAMP);
+}
+
+void Reprojection::fill(StereoTarget &stereoTarget) {
+	glBindFramebuffer(GL_FRAMEBUFFER, stereoTarget.framebufferID);
+	glViewport(width, 0, width, height);
+	glDisable(GL_DEPTH_TEST);
+
+	renderState.useProgram(fillProgramID);
+	renderState.bindVertexArray(vertexArrayID);
+	renderState.bindTexture(0, colorTextureID);
+	renderState.bindTexture(1, depthTextureID);
+	glUniform1i(fillRadiusID, fillRadius);
+
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	renderState.countDraw(3);
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+void Reprojection::cleanup() {
+	glDeleteFramebuffers(1, &framebufferID);
+	glDeleteTextures(1, &colorTextureID);
+	glDeleteTextures(1, &depthTextureID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(warpProgramID);
+	glDeleteProgram(fillProgramID);
+}
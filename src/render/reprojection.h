@@ -0,0 +1,53 @@
+#ifndef _REPROJECTION_H_
+#define _REPROJECTION_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+struct StereoTarget;
+
+// Synthesizes the right eye from the left eye's color and depth instead of 
+// rendering the scene again (depth-image-based rendering). warp() splats one 
+// point per left-eye pixel at its right-eye position, with the depth test 
+// keeping the nearest surface. fill() then covers the disocclusions, pixels 
+// no left-eye pixel landed on, with the farther of the nearest written pixels 
+// to either side, i.e. the background the foreground moved away from.
+struct Reprojection {
+	GLuint framebufferID = 0;
+	GLuint colorTextureID = 0;			// RGBA, alpha 0 where nothing landed
+	GLuint depthTextureID = 0;
+	int width = 0;
+	int height = 0;
+
+	GLuint vertexArrayID = 0;			// Empty, points and the fullscreen triangle come from gl_VertexID
+
+	GLuint warpProgramID = 0;
+	GLint warpColorSamplerID = -1;
+	GLint warpDepthSamplerID = -1;
+	GLint warpMatrixID = -1;
+	GLint warpWidthID = -1;
+
+	GLuint fillProgramID = 0;
+	GLint fillColorSamplerID = -1;
+	GLint fillDepthSamplerID = -1;
+	GLint fillRadiusID = -1;
+	int fillRadius = 32;				// How far to look sideways for a written pixel
+
+	void initialize(int width, int height);
+
+	// Get the uniform handles, again after a program is rebuilt
+	void loadUniforms();
+
+	void resize(int width, int height);
+
+	// Warp the left half of the stereo target into this target. `reprojection` 
+	// maps left-eye NDC to right-eye clip space: vpRight * inverse(vpLeft).
+	void warp(const StereoTarget &stereoTarget, const glm::mat4 &reprojection);
+
+	// Fill the holes and write the result into the right half of the stereo target
+	void fill(StereoTarget &stereoTarget);
+
+	void cleanup();
+};
+
+#endif
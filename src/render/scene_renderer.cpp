@@ -0,0 +1,691 @@
+#include "scene_renderer.h"
+#include "render_state.h"
+#include "profiler.h"
+#include "stream_buffer.h"
+
+#include <scene/transform_batch.h>
+#include <scene/scene_snapshot.h>
+#include <image/image_metrics.h>
+
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <math.h>
+
+std::string strAnaglyphMode[] = {
+	"None", 
+	"Toe-in", 
+	"Asymmetric view frustum", 
+	"Invalid",
+};
+
+void SceneRenderer::initialize(int framebufferWidth, int framebufferHeight) {
+	// Create a box
+	box.initialize(useOptimizedMeshes);
+
+	sphere.initialize(useOptimizedMeshes);
+
+	stereoTarget.initialize(framebufferWidth, framebufferHeight);
+	reprojection.initialize(framebufferWidth, framebufferHeight);
+	dynamicResolution.initialize();
+
+	instanceStream.initialize();
+
+	scenePool.initialize();
+	framePipeline.start([this](FramePacket &packet) { preparePacket(packet); });
+}
+
+void SceneRenderer::cleanup() {
+	framePipeline.stop();
+	stereoTarget.cleanup();
+	reprojection.cleanup();
+	dynamicResolution.cleanup();
+	instanceStream.cleanup();
+	sphere.cleanup();
+	box.cleanup();
+}
+
+void SceneRenderer::resetCamera() {
+	rotating = false;
+	eyeCenter = originalEyeCenter;
+	viewAzimuth = M_PI / 2;
+	viewPolar = M_PI / 2;
+}
+
+glm::mat4 SceneRenderer::projectionMatrix() const {
+	return glm::perspective(glm::radians(FoV), aspect, zNear, zFar);
+}
+
+// Helper functions 
+
+void SceneRenderer::nextAnaglyphMode() {
+	anaglyphMode = (AnaglyphMode)(((int)anaglyphMode + 1) % (int)AnaglyphModeCount);
+}
+
+void SceneRenderer::nextCompositeMatrix() {
+	compositeMatrix = (AnaglyphMatrix)(((int)compositeMatrix + 1) % (int)AnaglyphMatrixCount);
+}
+
+// Row-major 3x3 to glm's column-major
+static glm::mat3 toMat3(const float rows[3][3]) {
+	glm::mat3 m;
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 3; ++col) {
+			m[col][row] = rows[row][col];
+		}
+	}
+	return m;
+}
+
+void SceneRenderer::generateScene() {
+	// Prepared frames index the old instances, and the worker must not read them while they change
+	framePipeline.discard();
+
+	ProfileScope scope("scene generation", true);
+	bvhStale = true;
+	if (!scenePath.empty() && loadSnapshot()) {
+		// The snapshot's arrays replace the instances, and its BVH the stale one
+	} else if (numBoxes == 1) {
+		// Use this for debugging: one box of scale 16 at the origin
+		instances.resize(1);
+		instances.positionX[0] = instances.positionY[0] = instances.positionZ[0] = 0.0f;
+		instances.scale[0] = 16.0f;
+		instances.axisX[0] = instances.axisY[0] = 0.0f;
+		instances.axisZ[0] = 1.0f;
+		instances.angle[0] = 0.0f;
+		instances.colors[0] = 0xffffffffu;
+		instances.updateTransform(0);
+	} else {
+		// Generate boxes based on random position, rotation, and scale. 
+		// Store their transforms.
+		GenerateRandomInstances(instances, numBoxes, sceneSeed, &scenePool);
+	}
+
+	// Keep the per-instance buffer of the model in use in sync with the scene. 
+	// Switching models regenerates the scene, so the other one is never stale.
+	if (!useSphereScene) {
+		box.uploadInstances(instances.transforms.data(), instances.colors.data(), instances.size());
+	} else {
+		sphere.uploadInstances(instances.transforms.data(), instances.colors.data(), instances.size());
+	}
+	instancesCompacted = false;
+	++sceneVersion;
+}
+
+// Copy the instances and BVH of the snapshot at scenePath, or forget the path if it does not open
+bool SceneRenderer::loadSnapshot() {
+	SceneSnapshot snapshot;
+	if (!snapshot.open(scenePath)) {
+		std::cerr << "Failed to open scene snapshot " << scenePath << ", generating the scene instead" << std::endl;
+		scenePath.clear();
+		return false;
+	}
+	auto start = std::chrono::steady_clock::now();
+	bvhStale = !snapshot.load(instances, &sceneBVH);
+	std::cout << "Loaded " << instances.size() << " instances" << (bvhStale ? "" : " and their BVH") << " from " << scenePath << " in " 
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	return true;
+}
+
+bool SceneRenderer::loadScene(const std::string &path) {
+	SceneSnapshot snapshot;
+	if (!snapshot.open(path)) {
+		std::cerr << "Failed to open scene snapshot " << path << std::endl;
+		return false;
+	}
+	useSphereScene = snapshot.header->mesh == SnapshotSphere;
+	snapshot.close();
+	scenePath = path;
+	generateScene();
+	return true;
+}
+
+bool SceneRenderer::saveScene(const std::string &path) {
+	// The worker builds the BVH while culling
+	framePipeline.discard();
+	if (bvhStale) {
+		sceneBVH.build(instances.bounds);
+		bvhStale = false;
+	}
+	if (!WriteSceneSnapshot(path, instances, &sceneBVH, useSphereScene ? SnapshotSphere : SnapshotBox)) {
+		std::cerr << "Failed to write scene snapshot " << path << std::endl;
+		return false;
+	}
+	std::cout << "Saved " << instances.size() << " instances to " << path << std::endl;
+	return true;
+}
+
+// Cull the scene against both eyes in one BVH traversal. The render thread reports the statistics.
+void SceneRenderer::cullScene(FramePacket &packet) {
+	if (bvhStale) {
+		sceneBVH.build(instances.bounds);
+		bvhStale = false;
+	}
+	CullStereo(sceneBVH, packet.vpLeft, packet.vpRight, packet.visibleLeft, packet.visibleRight, packet.visibleEither, packet.cullStats);
+}
+
+// Print the culling statistics of a submitted frame once a second
+void SceneRenderer::reportCullStats(const CullStats &cullStats) {
+	static double lastReport = 0;
+	double now = glfwGetTime();
+	if (now - lastReport >= 1.0) {
+		lastReport = now;
+		std::cout << "Culling: " << cullStats.nodesTested << " nodes tested, " << cullStats.eyeTests << " eye tests, visible " 
+			<< cullStats.visibleLeft << " left / " << cullStats.visibleRight << " right / " << cullStats.visibleEither 
+			<< " either of " << cullStats.instances << ", " << cullStats.milliseconds << " ms" << std::endl;
+	}
+}
+
+// Choose the sphere level of every instance that will be drawn, the same for both eyes
+void SceneRenderer::selectSphereLevels(FramePacket &packet, const std::vector<int> *visible) {
+	const FrameInputs &inputs = packet.inputs;
+	if (!inputs.useSphereScene || !inputs.useSphereLOD || inputs.useSphereImpostors) return;
+
+	float pixelScale = 0.5f * inputs.height / tan(glm::radians(inputs.FoV / 2.0f));
+	packet.sphereLevels.resize(instances.size());
+	int count = visible ? (int)visible->size() : (int)instances.size();
+	scenePool.parallelFor(0, count, 4096, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			int instance = visible ? (*visible)[i] : i;
+			packet.sphereLevels[instance] = (unsigned char)sphere.selectLevel(instances.transforms[instance], packet.vpLeft, packet.vpRight, pixelScale);
+		}
+	});
+}
+
+// Group the instances of selectSphereLevels() by level, once for both eyes. Instanced 
+// draws upload the grouping, so an unchanged one keeps its version and is not uploaded again.
+void SceneRenderer::groupSphereLevels(FramePacket &packet, const std::vector<int> *visible) {
+	const FrameInputs &inputs = packet.inputs;
+	if (!inputs.useSphereScene || !inputs.useSphereLOD || inputs.useSphereImpostors) return;
+	if (!drawsInstanced(inputs) && !inputs.useSinglePassStereo) return;
+
+	int count = visible ? (int)visible->size() : (int)instances.size();
+	bool same = lastSphereGroups.version != 0 && lastGroupedScene == inputs.sceneVersion && lastGroupedAll == (visible == NULL)
+		&& (!visible || *visible == lastGroupedVisible) && (int)lastGroupedLevels.size() == count;
+	for (int i = 0; i < count && same; ++i) {
+		same = packet.sphereLevels[visible ? (*visible)[i] : i] == lastGroupedLevels[i];
+	}
+	if (!same) {
+		// Counting sort by level
+		SphereLevelGroups &groups = lastSphereGroups;
+		int levelCount = (int)sphere.levels.size();
+		groups.count.assign(levelCount, 0);
+		groups.first.assign(levelCount, 0);
+		lastGroupedLevels.resize(count);
+		for (int i = 0; i < count; ++i) {
+			lastGroupedLevels[i] = packet.sphereLevels[visible ? (*visible)[i] : i];
+			++groups.count[lastGroupedLevels[i]];
+		}
+		for (int l = 1; l < levelCount; ++l) {
+			groups.first[l] = groups.first[l - 1] + groups.count[l - 1];
+		}
+		std::vector<int> cursor = groups.first;
+		groups.order.resize(count);
+		for (int i = 0; i < count; ++i) {
+			groups.order[cursor[lastGroupedLevels[i]]++] = visible ? (*visible)[i] : i;
+		}
+
+		// Skip 0, which Sphere takes as no grouping uploaded
+		if (++groups.version == 0) ++groups.version;
+		lastGroupedScene = inputs.sceneVersion;
+		lastGroupedAll = visible == NULL;
+		if (visible) {
+			lastGroupedVisible = *visible;
+		} else {
+			lastGroupedVisible.clear();
+		}
+	}
+	packet.sphereGroups = lastSphereGroups;
+}
+
+// Batch the model-view-projections of the per-object passes and turn them into 
+// sorted draw lists. Chunks of instances are spread over scenePool, each sorted 
+// on its own, and merged at the end. `visibleLeft` and `visibleRight` list the 
+// instances of each pass, NULL for all of them.
+void SceneRenderer::buildDraws(FramePacket &packet, bool bothEyes, const std::vector<int> *visibleLeft, const std::vector<int> *visibleRight) {
+	const int grain = 4096;
+	const FrameInputs &inputs = packet.inputs;
+	int total = (int)instances.size();
+	int countLeft = visibleLeft ? (int)visibleLeft->size() : total;
+	int countRight = !bothEyes ? 0 : visibleRight ? (int)visibleRight->size() : total;
+	packet.mvpsLeft.resize(countLeft);
+	packet.mvpsRight.resize(countRight);
+	packet.partsLeft.resize((countLeft + grain - 1) / grain);
+	packet.partsRight.resize((countRight + grain - 1) / grain);
+
+	// Draws of items [begin, end) of one pass
+	auto addDraws = [&](const std::vector<int> *visible, const glm::mat4 *mvps, int begin, int end, DrawList &part) {
+		part.clear();
+		if (!inputs.useSphereScene) {
+			for (int i = begin; i < end; ++i) {
+				box.addDraw(part, mvps[i], instances.colors[visible ? (*visible)[i] : i], inputs.zFar);
+			}
+		} else {
+			// Note: the sphere scene re-uses the box instances for its positions/scales
+			for (int i = begin; i < end; ++i) {
+				int instance = visible ? (*visible)[i] : i;
+				sphere.addDraw(part, mvps[i], instances.colors[instance], inputs.zFar, inputs.useSphereLOD ? packet.sphereLevels[instance] : 0);
+			}
+		}
+		part.sort();
+	};
+
+	auto buildPass = [&](const glm::mat4 &vp, const std::vector<int> *visible, int count, std::vector<glm::mat4> &mvps, std::vector<DrawList> &parts) {
+		scenePool.parallelFor(0, count, grain, [&](int begin, int end) {
+			const glm::mat4 *models = visible ? instances.transforms.data() : instances.transforms.data() + begin;
+			TransformBatch(vp, models, visible ? visible->data() + begin : NULL, end - begin, mvps.data() + begin);
+			addDraws(visible, mvps.data(), begin, end, parts[begin / grain]);
+		});
+	};
+
+	if (bothEyes && !visibleLeft && !visibleRight) {
+		// Both eyes draw every instance, so their products come from one pass over the transforms
+		scenePool.parallelFor(0, total, grain, [&](int begin, int end) {
+			TransformBatchStereo(packet.vpLeft, packet.vpRight, instances.transforms.data() + begin, NULL, end - begin, 
+				packet.mvpsLeft.data() + begin, packet.mvpsRight.data() + begin);
+			addDraws(NULL, packet.mvpsLeft.data(), begin, end, packet.partsLeft[begin / grain]);
+			addDraws(NULL, packet.mvpsRight.data(), begin, end, packet.partsRight[begin / grain]);
+		});
+	} else {
+		buildPass(packet.vpLeft, visibleLeft, countLeft, packet.mvpsLeft, packet.partsLeft);
+		buildPass(packet.vpRight, visibleRight, countRight, packet.mvpsRight, packet.partsRight);
+	}
+
+	packet.drawsLeft.mergeSorted(packet.partsLeft);
+	packet.drawsRight.mergeSorted(packet.partsRight);
+}
+
+// Compute everything the render thread needs to draw packet.inputs
+void SceneRenderer::preparePacket(FramePacket &packet) {
+	auto start = std::chrono::steady_clock::now();
+	const FrameInputs &inputs = packet.inputs;
+
+	computeStereoViewProjections(inputs, packet.vpLeft, packet.vpRight);
+
+	const std::vector<int> *visibleLeft = NULL, *visibleRight = NULL, *visibleEither = NULL;
+	if (inputs.useCulling) {
+		cullScene(packet);
+		visibleLeft = &packet.visibleLeft;
+		visibleRight = &packet.visibleRight;
+		visibleEither = &packet.visibleEither;
+	}
+	const std::vector<int> *visibleLevels = inputs.anaglyphMode == None ? visibleLeft : visibleEither;
+	selectSphereLevels(packet, visibleLevels);
+	groupSphereLevels(packet, visibleLevels);
+
+	if (!drawsInstanced(inputs)) {
+		// Single-pass stereo is always instanced, reprojection only draws the left eye
+		bool bothEyes = inputs.anaglyphMode != None && !inputs.useReprojection && !inputs.useSinglePassStereo;
+		buildDraws(packet, bothEyes, visibleLeft, visibleRight);
+	} else {
+		packet.drawsLeft.clear();
+		packet.drawsRight.clear();
+	}
+
+	packet.prepareMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Point the instances of the current model at a visible subset, or back at the 
+// whole scene. Subsets go through instanceStream and are rewritten every pass, 
+// except spheres with level of detail, which draw the packet's grouping.
+void SceneRenderer::uploadVisibleInstances(const FramePacket &packet, const std::vector<int> *visible) {
+	const FrameInputs &inputs = packet.inputs;
+
+	// Spheres with level of detail were grouped by level on the worker, over the 
+	// instances either eye sees, so both passes of a frame draw the same upload
+	if (inputs.useSphereScene && inputs.useSphereLOD && !inputs.useSphereImpostors) {
+		const SphereLevelGroups &groups = packet.sphereGroups;
+		sphere.useLevelGroups(instances.transforms.data(), instances.colors.data(), groups.order, groups.first, groups.count, groups.version);
+		instancesCompacted = true;
+		return;
+	}
+
+	if (!visible) {
+		if (instancesCompacted) {
+			if (!inputs.useSphereScene) {
+				box.useStaticInstances();
+			} else {
+				sphere.useStaticInstances();
+			}
+			instancesCompacted = false;
+		}
+		return;
+	}
+
+	if (!inputs.useSphereScene) {
+		box.streamInstances(instances.transforms.data(), instances.colors.data(), visible->data(), visible->size());
+	} else {
+		sphere.streamInstancesFinest(instances.transforms.data(), instances.colors.data(), visible->data(), visible->size());
+	}
+	instancesCompacted = true;
+}
+
+// Draw the scene with the given view-projection matrix: the instances listed in 
+// `visible` (NULL for all) with one instanced draw call, or the prepared 
+// per-object `draws` of the pass.
+void SceneRenderer::renderScene(const FramePacket &packet, const glm::mat4 &vp, const std::vector<int> *visible, const DrawList &draws) {
+	const FrameInputs &inputs = packet.inputs;
+	if (drawsInstanced(inputs)) {
+		uploadVisibleInstances(packet, visible);
+		if (!inputs.useSphereScene) {
+			box.renderInstanced(vp);
+		} else if (inputs.useSphereImpostors) {
+			sphere.renderImpostors(vp);
+		} else {
+			sphere.renderInstanced(vp);
+		}
+		return;
+	}
+
+	// One draw per object, sorted so binds are shared and near objects fill depth first
+	draws.submit();
+}
+
+// Start counting state changes for a new frame, printing the last frame's counts once a second
+void SceneRenderer::beginFrameStats() {
+	renderState.beginFrame();
+	if (!showStateStats) return;
+
+	static double lastReport = 0;
+	double now = glfwGetTime();
+	if (now - lastReport >= 1.0) {
+		lastReport = now;
+		std::cout << "GL state: " << renderState.lastIssued << " changes issued, " << renderState.lastElided 
+			<< " elided, " << renderState.lastDrawCalls << " draw calls, " << renderState.lastVertices << " vertices" << std::endl;
+		std::cout << "Frame preparation: " << lastPrepareMilliseconds << " ms on " << scenePool.threadCount() << " threads" << std::endl;
+		if (useDynamicResolution) {
+			std::cout << "Resolution scale: " << dynamicResolution.scale << " (GPU " << dynamicResolution.gpuMilliseconds 
+				<< " ms, budget " << dynamicResolution.budgetMilliseconds << " ms, " << dynamicResolution.changes << " changes)" << std::endl;
+		}
+		std::cout << "Instance stream: " << instanceStream.fenceWaits << " fence waits in " << instanceStream.frames << " frames (" 
+			<< instanceStream.fenceWaitMilliseconds << " ms), " << instanceStream.grows << " grows, " << instanceStream.orphans << " orphans" << std::endl;
+	}
+}
+
+// Draw the scene once per eye with a single instanced draw call. Expects the 
+// stereo target to be bound. `visible` as in renderScene().
+void SceneRenderer::renderSceneStereo(const FramePacket &packet, const std::vector<int> *visible) {
+	const FrameInputs &inputs = packet.inputs;
+	uploadVisibleInstances(packet, visible);
+	if (!inputs.useSphereScene) {
+		box.renderStereoInstanced(packet.vpLeft, packet.vpRight);
+	} else if (inputs.useSphereImpostors) {
+		sphere.renderStereoImpostors(packet.vpLeft, packet.vpRight);
+	} else {
+		sphere.renderStereoInstanced(packet.vpLeft, packet.vpRight);
+	}
+}
+
+// Render the left eye into the left half of the stereo target and warp it into 
+// the right half, drawing the scene geometry once
+void SceneRenderer::renderReprojected(const FramePacket &packet, int eyeWidth, int eyeHeight) {
+	const FrameInputs &inputs = packet.inputs;
+	{
+		ProfileScope scope("left eye", true);
+		stereoTarget.begin(eyeWidth, eyeHeight);
+		glViewport(0, 0, eyeWidth, eyeHeight);
+		renderScene(packet, packet.vpLeft, inputs.useCulling ? &packet.visibleLeft : NULL, packet.drawsLeft);
+	}
+	ProfileScope scope("reprojection", true);
+	reprojection.warp(stereoTarget, packet.vpRight * glm::inverse(packet.vpLeft));
+	reprojection.fill(stereoTarget);
+}
+
+// Read a region of a framebuffer's color attachment into tightly packed rows
+static void readPixels(GLuint framebufferID, int x, int width, int height, GLenum format, std::vector<uint8_t> &pixels) {
+	pixels.resize((size_t)width * height * (format == GL_RGBA ? 4 : 3));
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	renderState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(x, 0, width, height, format, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+ReprojectionQuality SceneRenderer::measureReprojection(const glm::mat4 &projectionMatrix, int width, int height) {
+	// Both eyes of the whole scene, prepared on this thread once the worker is idle
+	framePipeline.discard();
+	FramePacket packet;
+	packet.inputs = frameInputs(projectionMatrix, width, height);
+	packet.inputs.useCulling = false;
+	packet.inputs.useReprojection = false;
+	packet.inputs.useSinglePassStereo = false;
+	preparePacket(packet);
+	const DrawList &drawsRight = packet.inputs.anaglyphMode == None ? packet.drawsLeft : packet.drawsRight;
+
+	// Synthesized right eye, and the holes it had before filling
+	ReprojectionQuality quality;
+	std::vector<uint8_t> warped, synthesized, reference;
+	stereoTarget.begin(width, height);
+	glViewport(0, 0, width, height);
+	renderScene(packet, packet.vpLeft, NULL, packet.drawsLeft);
+	reprojection.warp(stereoTarget, packet.vpRight * glm::inverse(packet.vpLeft));
+	readPixels(reprojection.framebufferID, 0, width, height, GL_RGBA, warped);
+	reprojection.fill(stereoTarget);
+	readPixels(stereoTarget.framebufferID, width, width, height, GL_RGB, synthesized);
+
+	size_t holes = 0;
+	for (size_t i = 3; i < warped.size(); i += 4) {
+		if (warped[i] == 0) ++holes;
+	}
+	quality.holeFraction = (double)holes / ((size_t)width * height);
+
+	// True right eye, rendered over the synthesized one
+	glBindFramebuffer(GL_FRAMEBUFFER, stereoTarget.framebufferID);
+	glViewport(width, 0, width, height);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(width, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+	renderScene(packet, packet.vpRight, NULL, drawsRight);
+	readPixels(stereoTarget.framebufferID, width, width, height, GL_RGB, reference);
+
+	quality.difference = CompareImages(synthesized.data(), reference.data(), synthesized.size());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return quality;
+}
+
+void SceneRenderer::computeStereoViewProjections(const FrameInputs &inputs, glm::mat4 &vpLeft, glm::mat4 &vpRight) {
+	StereoCamera camera;
+	camera.projectionMatrix = inputs.projectionMatrix;
+	camera.eyeCenter = inputs.eyeCenter;
+	camera.lookat = inputs.lookat;
+	camera.up = inputs.up;
+	camera.FoV = inputs.FoV;
+	camera.zNear = inputs.zNear;
+	camera.zFar = inputs.zFar;
+	camera.aspect = inputs.aspect;
+	camera.viewDistance = inputs.viewDistance;
+	camera.ipd = inputs.ipd;
+	camera.anaglyphMode = inputs.anaglyphMode;
+	ComputeStereoViewProjections(camera, vpLeft, vpRight);
+}
+
+bool FrameInputs::operator==(const FrameInputs &other) const {
+	return projectionMatrix == other.projectionMatrix && width == other.width && height == other.height 
+		&& eyeCenter == other.eyeCenter && lookat == other.lookat && up == other.up 
+		&& FoV == other.FoV && zNear == other.zNear && zFar == other.zFar && aspect == other.aspect 
+		&& viewDistance == other.viewDistance && ipd == other.ipd 
+		&& anaglyphMode == other.anaglyphMode && compositeMatrix == other.compositeMatrix && sceneVersion == other.sceneVersion 
+		&& useSphereScene == other.useSphereScene && useInstancing == other.useInstancing && useSphereLOD == other.useSphereLOD 
+		&& useSphereImpostors == other.useSphereImpostors && useSinglePassStereo == other.useSinglePassStereo 
+		&& useReprojection == other.useReprojection && useCulling == other.useCulling 
+		&& useDynamicResolution == other.useDynamicResolution;
+}
+
+FrameInputs SceneRenderer::frameInputs(const glm::mat4 &projectionMatrix, int width, int height) const {
+	FrameInputs inputs;
+	inputs.projectionMatrix = projectionMatrix;
+	inputs.width = width;
+	inputs.height = height;
+	inputs.eyeCenter = eyeCenter;
+	inputs.lookat = lookat;
+	inputs.up = up;
+	inputs.FoV = FoV;
+	inputs.zNear = zNear;
+	inputs.zFar = zFar;
+	inputs.aspect = aspect;
+	inputs.viewDistance = viewDistance;
+	inputs.ipd = ipd;
+	inputs.anaglyphMode = anaglyphMode;
+	inputs.compositeMatrix = compositeMatrix;
+	inputs.sceneVersion = sceneVersion;
+	inputs.useSphereScene = useSphereScene;
+	inputs.useInstancing = useInstancing;
+	inputs.useSphereLOD = useSphereLOD;
+	inputs.useSphereImpostors = useSphereImpostors;
+	inputs.useSinglePassStereo = useSinglePassStereo;
+	inputs.useReprojection = useReprojection;
+	inputs.useCulling = useCulling;
+	inputs.useDynamicResolution = useDynamicResolution;
+	return inputs;
+}
+
+bool SceneRenderer::needsFrame(const glm::mat4 &projectionMatrix, int width, int height) const {
+	return frameInvalid || rotating || frameInputs(projectionMatrix, width, height) != lastFrameInputs;
+}
+
+// Render one anaglyph frame of the current scene into the given framebuffer (0 for the window)
+void SceneRenderer::renderFrame(const glm::mat4 &projectionMatrix, GLuint targetFramebufferID, int width, int height) {
+	prepareFrame(projectionMatrix, width, height);
+	submitFrame(targetFramebufferID);
+}
+
+void SceneRenderer::prepareFrame(const glm::mat4 &projectionMatrix, int width, int height) {
+	lastFrameInputs = frameInputs(projectionMatrix, width, height);
+	frameInvalid = false;
+
+	framePipeline.nextFree().inputs = lastFrameInputs;
+	framePipeline.request();
+}
+
+void SceneRenderer::submitFrame(GLuint targetFramebufferID) {
+	const FramePacket &packet = framePipeline.waitPrepared();
+	submitPacket(packet, targetFramebufferID);
+	lastPrepareMilliseconds = packet.prepareMilliseconds;
+	if (packet.inputs.useCulling && reportCulling) {
+		reportCullStats(packet.cullStats);
+	}
+	framePipeline.release();
+}
+
+// Issue the GL commands of a prepared frame
+void SceneRenderer::submitPacket(const FramePacket &packet, GLuint targetFramebufferID) {
+	const FrameInputs &inputs = packet.inputs;
+	int width = inputs.width, height = inputs.height;
+
+	// Dynamic resolution renders the eyes into the stereo target at a scale of 
+	// the window and upsamples them in the composite
+	bool scaled = inputs.useDynamicResolution && inputs.anaglyphMode != None;
+	int eyeWidth = width, eyeHeight = height;
+
+	beginFrameStats();
+	profiler.beginFrame();
+	ProfileScope scope("frame", false);
+	instanceStream.beginFrame();
+	if (scaled) {
+		dynamicResolution.beginFrame();
+		dynamicResolution.eyeSize(width, height, eyeWidth, eyeHeight);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebufferID);
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// TODO: Render anaglyph 
+	// --------------------------------------------------------------------
+
+	if (inputs.anaglyphMode == None)
+	{
+		// Clear the screen
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// If we’re in sphere scene, render spheres. Otherwise, render boxes.
+		ProfileScope scope("scene pass", true);
+		renderScene(packet, packet.vpLeft, inputs.useCulling ? &packet.visibleLeft : NULL, packet.drawsLeft);
+	}
+	else
+	{
+		if (inputs.useReprojection || inputs.useSinglePassStereo || scaled)
+		{
+			if (inputs.useReprojection)
+			{
+				// REPROJECTED: Render the left eye only and synthesize the right eye from its depth
+				renderReprojected(packet, eyeWidth, eyeHeight);
+			}
+			else if (inputs.useSinglePassStereo)
+			{
+				// SINGLE PASS: Render both eyes side by side with one instanced submission
+				ProfileScope scope("stereo pass", true);
+				stereoTarget.begin(eyeWidth, eyeHeight);
+				glEnable(GL_CLIP_DISTANCE0);
+				renderSceneStereo(packet, inputs.useCulling ? &packet.visibleEither : NULL);
+				glDisable(GL_CLIP_DISTANCE0);
+			}
+			else
+			{
+				// TWO PASSES, SCALED: Render each eye into its half of the stereo target
+				stereoTarget.begin(eyeWidth, eyeHeight);
+				{
+					ProfileScope scope("left eye", true);
+					glViewport(0, 0, eyeWidth, eyeHeight);
+					renderScene(packet, packet.vpLeft, inputs.useCulling ? &packet.visibleLeft : NULL, packet.drawsLeft);
+				}
+				{
+					ProfileScope scope("right eye", true);
+					glViewport(eyeWidth, 0, eyeWidth, eyeHeight);
+					renderScene(packet, packet.vpRight, inputs.useCulling ? &packet.visibleRight : NULL, packet.drawsRight);
+				}
+			}
+
+			// Then combine the two halves into red/cyan with a fullscreen composite
+			ProfileScope scope("composite", true);
+			const AnaglyphMatrices &matrices = GetAnaglyphMatrices(inputs.compositeMatrix);
+			stereoTarget.composite(toMat3(matrices.left), toMat3(matrices.right), targetFramebufferID, width, height);
+		}
+		else
+		{
+			// TODO: Implement two-pass rendering to draw the anaglyph
+			// FIRST PASS: Render the Left Eye in Red only
+			glColorMask(GL_TRUE, GL_FALSE, GL_FALSE, GL_TRUE); // R only
+			glClear(GL_DEPTH_BUFFER_BIT);					   // Clear depth but keep color
+			{
+				ProfileScope scope("left eye", true);
+				renderScene(packet, packet.vpLeft, inputs.useCulling ? &packet.visibleLeft : NULL, packet.drawsLeft);
+			}
+
+			// SECOND PASS: Render the Right Eye in Cyan (G+B) only
+			// SECOND PASS: Render the Right Eye in Cyan (G+B) only
+			glColorMask(GL_FALSE, GL_TRUE, GL_TRUE, GL_TRUE); // G+B
+			glClear(GL_DEPTH_BUFFER_BIT);					  // Clear depth again
+			{
+				ProfileScope scope("right eye", true);
+				renderScene(packet, packet.vpRight, inputs.useCulling ? &packet.visibleRight : NULL, packet.drawsRight);
+			}
+
+			// Finally, restore normal color masking
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		}
+
+		// ----------------------------------------------------------------
+	}
+
+	// --------------------------------------------------------------------
+
+	if (scaled) dynamicResolution.endFrame();
+	instanceStream.endFrame();
+}
+
+// Move the camera along its orbit when rotation is on
+void SceneRenderer::advanceOrbit(float deltaTime) {
+	if (rotating) {
+		viewAzimuth += 1.0f * deltaTime;
+		eyeCenter.x = viewDistance * cos(viewAzimuth);
+		eyeCenter.z = viewDistance * sin(viewAzimuth);
+	}
+}
+
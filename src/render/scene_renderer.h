@@ -0,0 +1,188 @@
+#ifndef _SCENE_RENDERER_H_
+#define _SCENE_RENDERER_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <render/stereo_target.h>
+#include <render/reprojection.h>
+#include <render/dynamic_resolution.h>
+#include <render/draw_list.h>
+#include <render/frame_packet.h>
+#include <render/frame_pipeline.h>
+#include <image/anaglyph_compose.h>
+#include <image/image_metrics.h>
+#include <scene/culling.h>
+#include <scene/instance_store.h>
+#include <util/thread_pool.h>
+#include <models/box.h>
+#include <models/sphere.h>
+
+#include <string>
+#include <vector>
+
+extern std::string strAnaglyphMode[];
+
+// How close a reprojected right eye comes to rendering it
+struct ReprojectionQuality {
+	double holeFraction = 0;		// Share of pixels no left-eye pixel landed on, before filling
+	ImageDifference difference = {};	// Filled result against the rendered eye
+};
+
+// The scene (a box or sphere model drawn at many transforms), the orbiting 
+// camera and every way of rendering them as an anaglyph. Shared by the viewer 
+// and the benchmark, which only differ in where frames go and what drives them.
+struct SceneRenderer {
+	// Scene control 
+	bool useSphereScene = false;			// false => boxes, true => spheres
+	int numBoxes = 1;						// Debug: set numBoxes to 1.
+	InstanceStore instances;				// We represent the scene by a single box and a number of transforms for drawing the box at different locations.
+	uint64_t sceneSeed = 2024;				// Key of the scene's random numbers
+	unsigned sceneVersion = 0;				// Bumped by every generateScene()
+	std::string scenePath;					// Snapshot generateScene() loads instead of generating, empty to generate
+	ThreadPool scenePool;					// Generates the instances and prepares frames in parallel
+
+	Sphere sphere;
+	Box box;
+
+	bool useOptimizedMeshes = true;			// Cache-ordered, quantized meshes; false builds them as generated. Read by initialize().
+
+	bool useInstancing = false;				// false => one draw call per box, true => one instanced draw call per eye
+
+	bool useSphereLOD = true;				// Pick a sphere tessellation level per instance from its size on screen
+
+	bool useSphereImpostors = false;		// Draw spheres as ray-cast quads, always instanced and without levels
+
+	bool useSinglePassStereo = false;		// false => one pass per eye with color masks, true => both eyes in one submission
+	StereoTarget stereoTarget;
+
+	bool useReprojection = false;			// Stereo modes render the left eye only and warp it into the right eye
+	Reprojection reprojection;
+
+	bool useDynamicResolution = false;		// Stereo modes render the eyes below window size to hold a GPU time budget
+	DynamicResolution dynamicResolution;
+
+	// Frame preparation: matrices, culling, sphere levels and sorted per-object 
+	// draws are computed on a worker (spread over scenePool) into packets that 
+	// this thread submits, so preparing one frame can overlap submitting another
+	FramePipeline framePipeline;
+	double lastPrepareMilliseconds = 0;		// Worker time spent on the last submitted frame
+
+	// The worker's last sphere level grouping and what it was built from, reused while 
+	// the scene, the instances drawn and their levels stay the same
+	SphereLevelGroups lastSphereGroups;
+	unsigned lastGroupedScene = 0;
+	bool lastGroupedAll = false;			// Grouped every instance, not lastGroupedVisible
+	std::vector<int> lastGroupedVisible;
+	std::vector<unsigned char> lastGroupedLevels;	// Level of each grouped instance, in visible order
+	bool showStateStats = false;			// Print issued/elided state changes once a second
+
+	// OpenGL camera view parameters
+	glm::vec3 originalEyeCenter = glm::vec3(0, 0, 100);
+	glm::vec3 eyeCenter = originalEyeCenter;
+	glm::vec3 lookat = glm::vec3(0, 0, 0);
+	glm::vec3 up = glm::vec3(0, 1, 0);
+
+	glm::float32 FoV = 45;
+	glm::float32 zNear = 0.1f; 
+	glm::float32 zFar = 1000.0f;
+	float aspect = 4.0f / 3.0f;
+
+	// View control 
+	float viewAzimuth = M_PI / 2;
+	float viewPolar = M_PI / 2;
+	float viewDistance = 100.0f;
+	bool rotating = false;
+
+	// Culling control 
+	bool useCulling = false;				// Only draw instances inside the eye frusta
+	bool reportCulling = true;				// Print culling statistics once a second
+	BVH sceneBVH;							// Built over the instance bounds on the first cull after the scene changes
+	bool bvhStale = true;
+	bool instancesCompacted = false;		// Instanced draws read a streamed subset, not the whole scene
+
+	// Anaglyph control 
+	float ipd = 2.0f;						// Distance between left/right eye.
+	// After you implement the anaglyph, adjust the IPD value to control the red/cyan offsets and depth perception. 
+	AnaglyphMode anaglyphMode = AnaglyphMode::None;
+
+	// Color matrices of the single-pass composite. The default feeds red from the left 
+	// eye and green and blue from the right eye, the same as the two-pass color masks.
+	AnaglyphMatrix compositeMatrix = PureRedCyan;
+
+	// Dirty tracking 
+	FrameInputs lastFrameInputs;			// What the last rendered frame was drawn from
+	bool frameInvalid = true;				// Something outside the inputs changed the picture
+
+	// Load the models and size the stereo target. Needs a current context.
+	void initialize(int framebufferWidth, int framebufferHeight);
+	void cleanup();
+
+	void nextAnaglyphMode();
+	void nextCompositeMatrix();
+
+	// Put the camera back at its starting point
+	void resetCamera();
+
+	glm::mat4 projectionMatrix() const;
+
+	// Regenerate numBoxes random instances from sceneSeed, or reload scenePath when it is set. 
+	// Drops frames still being prepared.
+	void generateScene();
+
+	// Replace the scene with a snapshot's, drawn with the snapshot's model
+	bool loadScene(const std::string &path);
+
+	// Write the instances, their BVH (built if stale) and the model to a snapshot
+	bool saveScene(const std::string &path);
+
+	// Render one anaglyph frame of the current scene into the given framebuffer (0 for the window)
+	void renderFrame(const glm::mat4 &projectionMatrix, GLuint targetFramebufferID, int width, int height);
+
+	// The two halves of renderFrame(), for callers that overlap them: start preparing a 
+	// frame of the current state on the worker, and submit the oldest prepared frame. 
+	// At most FramePipeline::packetCount frames may be prepared and not yet submitted.
+	void prepareFrame(const glm::mat4 &projectionMatrix, int width, int height);
+	void submitFrame(GLuint targetFramebufferID);
+
+	// Whether a frame rendered now would differ from the last one: the camera, 
+	// IPD, mode, scene or target size changed, the orbit is animating, or 
+	// invalidateFrame() was called. Otherwise the last frame can be shown again.
+	bool needsFrame(const glm::mat4 &projectionMatrix, int width, int height) const;
+	void invalidateFrame() { frameInvalid = true; }
+
+	// Move the camera along its orbit when rotation is on
+	void advanceOrbit(float deltaTime);
+
+	// Compute the left and right eye view-projection matrices for the anaglyph mode of the inputs
+	static void computeStereoViewProjections(const FrameInputs &inputs, glm::mat4 &vpLeft, glm::mat4 &vpRight);
+
+	// Compare the reprojected right eye of the current view with a rendered one. 
+	// Leaves the stereo target holding the rendered eyes; the next frame redraws it.
+	ReprojectionQuality measureReprojection(const glm::mat4 &projectionMatrix, int width, int height);
+
+private:
+	bool loadSnapshot();
+
+	// Preparation, on the pipeline's worker
+	void preparePacket(FramePacket &packet);
+	void cullScene(FramePacket &packet);
+	void selectSphereLevels(FramePacket &packet, const std::vector<int> *visible);
+	void groupSphereLevels(FramePacket &packet, const std::vector<int> *visible);
+	void buildDraws(FramePacket &packet, bool bothEyes, const std::vector<int> *visibleLeft, const std::vector<int> *visibleRight);
+
+	// Submission, on the render thread
+	void submitPacket(const FramePacket &packet, GLuint targetFramebufferID);
+	void uploadVisibleInstances(const FramePacket &packet, const std::vector<int> *visible);
+	void renderScene(const FramePacket &packet, const glm::mat4 &vp, const std::vector<int> *visible, const DrawList &draws);
+	void renderSceneStereo(const FramePacket &packet, const std::vector<int> *visible);
+	void renderReprojected(const FramePacket &packet, int eyeWidth, int eyeHeight);
+	void beginFrameStats();
+	void reportCullStats(const CullStats &cullStats);
+	FrameInputs frameInputs(const glm::mat4 &projectionMatrix, int width, int height) const;
+
+	static bool drawsImpostors(const FrameInputs &inputs) { return inputs.useSphereScene && inputs.useSphereImpostors; }
+	static bool drawsInstanced(const FrameInputs &inputs) { return inputs.useInstancing || drawsImpostors(inputs); }
+};
+
+#endif
@@ -1,28 +1,187 @@
 #include "shader.h"
 
+#include <GLFW/glfw3.h>
+
 #include <string> 
 #include <iostream> 
 #include <fstream>
 #include <sstream> 
 #include <vector>
+#include <filesystem>
+#include <cstdint>
+#include <cstdio>
 
-GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
+// Program binaries are core in GL 4.1 (ARB_get_program_binary) and are loaded 
+// at runtime, since the context only guarantees 3.3
+#ifndef APIENTRYP
+#define APIENTRYP *
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+
+static ProgramParameteriProc programParameteri = NULL;
+static GetProgramBinaryProc getProgramBinary = NULL;
+static ProgramBinaryProc programBinary = NULL;
+static bool programBinaryChecked = false;
+
+static std::string shaderCacheDirectory = "shader_cache";
+
+static const uint32_t programCacheMagic = 0x43505341;	// "ASPC"
+static const uint32_t programCacheVersion = 1;
+
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t binaryFormat;
+	uint32_t length;
+};
+
+void SetShaderCacheDirectory(const char *directory)
 {
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+	shaderCacheDirectory = directory ? directory : "";
+}
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if (VertexShaderStream.is_open())
+// Look the entry points up once, with a current context
+static bool programBinarySupported()
+{
+	if (!programBinaryChecked)
 	{
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
+		programBinaryChecked = true;
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		glGetError();	// GL_INVALID_ENUM on drivers without the extension
+		if (formatCount > 0)
+		{
+			programParameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+			getProgramBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+			programBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+		}
 	}
-	else
+	return programParameteri && getProgramBinary && programBinary;
+}
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const std::string &bytes)
+{
+	for (unsigned char c : bytes)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static std::string glString(GLenum name)
+{
+	const GLubyte *value = glGetString(name);
+	return value ? std::string((const char *)value) : std::string();
+}
+
+// A binary is only valid for the exact sources and driver that produced it
+static std::string programCachePath(const std::string &vertexCode, const std::string &fragmentCode)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashBytes(hash, vertexCode);
+	hash = hashBytes(hash, std::string(1, '\0'));
+	hash = hashBytes(hash, fragmentCode);
+	hash = hashBytes(hash, glString(GL_VENDOR));
+	hash = hashBytes(hash, glString(GL_RENDERER));
+	hash = hashBytes(hash, glString(GL_VERSION));
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+	return shaderCacheDirectory + "/" + name;
+}
+
+// Returns 0 on a cache miss or if the driver rejects the binary
+static GLuint loadProgramBinary(const std::string &path)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return 0;
+	std::streamoff fileSize = file.tellg();
+	if (fileSize < (std::streamoff)sizeof(ProgramCacheHeader) || !file.seekg(0))
+		return 0;
+
+	ProgramCacheHeader header;
+	if (!file.read((char *)&header, sizeof(header)) || header.magic != programCacheMagic || header.version != programCacheVersion)
+		return 0;
+	// A truncated or corrupt file must not decide how much is allocated
+	if (header.length == 0 || (uint64_t)header.length > (uint64_t)fileSize - sizeof(header))
+		return 0;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), header.length))
+		return 0;
+
+	GLuint ProgramID = glCreateProgram();
+	programBinary(ProgramID, header.binaryFormat, binary.data(), (GLsizei)header.length);
+
+	// A driver update invalidates old binaries, they fail like a bad link
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE)
+	{
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
+
+static void saveProgramBinary(GLuint ProgramID, const std::string &path)
+{
+	GLint length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramCacheHeader header;
+	std::vector<char> binary(length);
+	GLenum binaryFormat = 0;
+	getProgramBinary(ProgramID, length, NULL, &binaryFormat, binary.data());
+	header.magic = programCacheMagic;
+	header.version = programCacheVersion;
+	header.binaryFormat = binaryFormat;
+	header.length = (uint32_t)length;
+
+	std::error_code error;
+	std::filesystem::create_directories(shaderCacheDirectory, error);
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		printf("Cannot write program cache %s.\n", path.c_str());
+		return;
+	}
+	file.write((const char *)&header, sizeof(header));
+	file.write(binary.data(), length);
+}
+
+bool ReadShaderFile(const char *file_path, std::string &code)
+{
+	std::ifstream ShaderStream(file_path, std::ios::in);
+	if (!ShaderStream.is_open())
+		return false;
+	std::stringstream sstr;
+	sstr << ShaderStream.rdbuf();
+	code = sstr.str();
+	return true;
+}
+
+GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
+{
+	// Read the Vertex Shader code from the file
+	std::string VertexShaderCode;
+	if (!ReadShaderFile(vertex_file_path, VertexShaderCode))
 	{
 		printf("Vertex shader not found %s.\n", vertex_file_path);
 		return 0;
@@ -30,20 +189,34 @@ GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
 
 	// Read the Fragment Shader code from the file
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if (FragmentShaderStream.is_open())
-	{
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
-	}
-	else
+	if (!ReadShaderFile(fragment_file_path, FragmentShaderCode))
 	{
 		printf("Fragment shader not found %s.\n", fragment_file_path);
 		return 0;
 	}
 
+	return LoadShaderSources(vertex_file_path, VertexShaderCode, fragment_file_path, FragmentShaderCode);
+}
+
+GLuint LoadShaderSources(const char *vertex_file_path, const std::string &VertexShaderCode, const char *fragment_file_path, const std::string &FragmentShaderCode)
+{
+	bool useCache = !shaderCacheDirectory.empty() && programBinarySupported();
+	std::string cachePath;
+	if (useCache)
+	{
+		cachePath = programCachePath(VertexShaderCode, FragmentShaderCode);
+		GLuint CachedProgramID = loadProgramBinary(cachePath);
+		if (CachedProgramID != 0)
+		{
+			printf("Loaded cached program : %s, %s\n", vertex_file_path, fragment_file_path);
+			return CachedProgramID;
+		}
+	}
+
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
@@ -84,6 +257,8 @@ GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
 	// Link the program
 	printf("Linking program\n");
 	GLuint ProgramID = glCreateProgram();
+	if (useCache)
+		programParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
 	glLinkProgram(ProgramID);
@@ -105,5 +280,8 @@ GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	if (useCache)
+		saveProgramBinary(ProgramID, cachePath);
+
 	return ProgramID;
 }
\ No newline at end of file
@@ -3,6 +3,20 @@
 
 #include <glad/gl.h>
 
+#include <string>
+
+// Compile and link a program from files. With a shader cache directory set 
+// (the default is "shader_cache") and program binaries supported by the driver, 
+// the linked binary is stored there, keyed by the sources and the driver, and 
+// loaded instead of compiling on the next run.
 GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path);
 
+// Same as LoadShaders() for sources already read; the paths are only used in messages
+GLuint LoadShaderSources(const char *vertex_file_path, const std::string &vertex_code, const char *fragment_file_path, const std::string &fragment_code);
+
+bool ReadShaderFile(const char *file_path, std::string &code);
+
+// NULL or "" disables the program binary cache
+void SetShaderCacheDirectory(const char *directory);
+
 #endif
@@ -0,0 +1,88 @@
+#include "shader_watcher.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <chrono>
+#include <iostream>
+
+static std::filesystem::file_time_type modificationTime(const std::string &path) {
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+void ShaderWatcher::watch(GLuint *programID, const char *vertexPath, const char *fragmentPath, std::function<void()> onReload) {
+	WatchedProgram program;
+	program.programID = programID;
+	program.vertexPath = vertexPath;
+	program.fragmentPath = fragmentPath;
+	program.onReload = onReload;
+	program.vertexTime = modificationTime(vertexPath);
+	program.fragmentTime = modificationTime(fragmentPath);
+	programs.push_back(program);
+}
+
+void ShaderWatcher::start(int intervalMilliseconds) {
+	this->intervalMilliseconds = intervalMilliseconds;
+	running = true;
+	thread = std::thread(&ShaderWatcher::run, this);
+}
+
+void ShaderWatcher::run() {
+	while (running) {
+		for (WatchedProgram &program : programs) {
+			std::filesystem::file_time_type vertexTime = modificationTime(program.vertexPath);
+			std::filesystem::file_time_type fragmentTime = modificationTime(program.fragmentPath);
+			if (vertexTime == program.vertexTime && fragmentTime == program.fragmentTime) continue;
+
+			// Editors often save in several writes; read on the next poll that sees no change
+			program.vertexTime = vertexTime;
+			program.fragmentTime = fragmentTime;
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			if (modificationTime(program.vertexPath) != vertexTime || modificationTime(program.fragmentPath) != fragmentTime) continue;
+
+			std::string vertexCode, fragmentCode;
+			if (!ReadShaderFile(program.vertexPath.c_str(), vertexCode) || !ReadShaderFile(program.fragmentPath.c_str(), fragmentCode)) continue;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			program.vertexCode = std::move(vertexCode);
+			program.fragmentCode = std::move(fragmentCode);
+			program.changed = true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMilliseconds));
+	}
+}
+
+int ShaderWatcher::poll() {
+	int reloaded = 0;
+	for (WatchedProgram &program : programs) {
+		std::string vertexCode, fragmentCode;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!program.changed) continue;
+			program.changed = false;
+			vertexCode.swap(program.vertexCode);
+			fragmentCode.swap(program.fragmentCode);
+		}
+
+		std::cout << "Reloading " << program.vertexPath << ", " << program.fragmentPath << std::endl;
+		GLuint programID = LoadShaderSources(program.vertexPath.c_str(), vertexCode, program.fragmentPath.c_str(), fragmentCode);
+		if (programID == 0) {
+			std::cerr << "Reload failed, keeping the previous program." << std::endl;
+			continue;
+		}
+
+		glDeleteProgram(*program.programID);
+		*program.programID = programID;
+		// The deleted program may still be the cached binding, and its name can be reused
+		renderState.invalidate();
+		if (program.onReload) program.onReload();
+		++reloaded;
+	}
+	return reloaded;
+}
+
+void ShaderWatcher::stop() {
+	running = false;
+	if (thread.joinable()) thread.join();
+}
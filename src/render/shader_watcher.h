@@ -0,0 +1,57 @@
+#ifndef _SHADER_WATCHER_H_
+#define _SHADER_WATCHER_H_
+
+#include <glad/gl.h>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Rebuilds programs when their shader files change. A background thread polls 
+// the file times and reads changed sources; poll() on the GL thread links the 
+// new program, swaps it into the watched handle and calls the owner back so it 
+// can fetch its uniform locations again. A program that fails to build keeps 
+// the old one running.
+struct ShaderWatcher {
+	struct WatchedProgram {
+		GLuint *programID;
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::function<void()> onReload;
+
+		std::filesystem::file_time_type vertexTime;
+		std::filesystem::file_time_type fragmentTime;
+
+		// Written by the watcher thread under mutex
+		bool changed = false;
+		std::string vertexCode;
+		std::string fragmentCode;
+	};
+
+	std::vector<WatchedProgram> programs;
+	std::mutex mutex;
+	std::thread thread;
+	std::atomic<bool> running{false};
+	int intervalMilliseconds = 250;
+
+	// Register before start(). onReload runs on the GL thread with the new program in *programID.
+	void watch(GLuint *programID, const char *vertexPath, const char *fragmentPath, std::function<void()> onReload);
+
+	void start(int intervalMilliseconds = 250);
+
+	// Call once per frame on the GL thread. Returns the number of programs replaced.
+	int poll();
+
+	void stop();
+
+	~ShaderWatcher() { stop(); }
+
+private:
+	void run();
+};
+
+#endif
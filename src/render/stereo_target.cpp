@@ -0,0 +1,94 @@
+#include "stereo_target.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <iostream>
+
+void StereoTarget::initialize(int width, int height) {
+	glGenFramebuffers(1, &framebufferID);
+	glGenTextures(1, &colorTextureID);
+	glGenTextures(1, &depthTextureID);
+	resize(width, height);
+
+	glGenVertexArrays(1, &vertexArrayID);
+
+	programID = LoadShaders("../src/composite.vert", "../src/anaglyph.frag");
+	if (programID == 0) {
+		std::cerr << "Failed to load composite shaders." << std::endl;
+	}
+	loadUniforms();
+}
+
+void StereoTarget::loadUniforms() {
+	stereoSamplerID = glGetUniformLocation(programID, "stereoTexture");
+	leftMatrixID = glGetUniformLocation(programID, "leftMatrix");
+	rightMatrixID = glGetUniformLocation(programID, "rightMatrix");
+
+	renderState.useProgram(programID);
+	glUniform1i(stereoSamplerID, 0);
+}
+
+void StereoTarget::resize(int width, int height) {
+	eyeWidth = width;
+	eyeHeight = height;
+
+	renderState.bindTexture(0, colorTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 2 * width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	// Linear filtering upsamples eyes rendered below the window size. At the 
+	// window size the composite samples texel centers 1:1 and gets the texels 
+	// exactly; the shader keeps samples off the seam between the eyes.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	renderState.bindTexture(0, depthTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, 2 * width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Stereo framebuffer is incomplete." << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void StereoTarget::begin(int width, int height) {
+	if (width != eyeWidth || height != eyeHeight) {
+		resize(width, height);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glViewport(0, 0, 2 * eyeWidth, eyeHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void StereoTarget::composite(const glm::mat3 &leftMatrix, const glm::mat3 &rightMatrix, GLuint targetFramebufferID, int viewportWidth, int viewportHeight) {
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebufferID);
+	glViewport(0, 0, viewportWidth, viewportHeight);
+	glDisable(GL_DEPTH_TEST);
+
+	renderState.useProgram(programID);
+	renderState.bindVertexArray(vertexArrayID);
+	renderState.bindTexture(0, colorTextureID);
+	glUniformMatrix3fv(leftMatrixID, 1, GL_FALSE, &leftMatrix[0][0]);
+	glUniformMatrix3fv(rightMatrixID, 1, GL_FALSE, &rightMatrix[0][0]);
+
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	renderState.countDraw(3);
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+void StereoTarget::cleanup() {
+	glDeleteFramebuffers(1, &framebufferID);
+	glDeleteTextures(1, &colorTextureID);
+	glDeleteTextures(1, &depthTextureID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(programID);
+}
@@ -0,0 +1,40 @@
+#ifndef _STEREO_TARGET_H_
+#define _STEREO_TARGET_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+// Offscreen target holding both eyes side by side (left half, right half) 
+// and the fullscreen pass that combines them into the anaglyph.
+struct StereoTarget {
+	GLuint framebufferID = 0;
+	GLuint colorTextureID = 0;
+	GLuint depthTextureID = 0;			// Sampled by the reprojection of the left eye
+	int eyeWidth = 0;
+	int eyeHeight = 0;
+
+	GLuint vertexArrayID = 0;			// Empty, the fullscreen triangle is generated from gl_VertexID
+	GLuint programID = 0;
+	GLuint stereoSamplerID = 0;
+	GLuint leftMatrixID = 0;
+	GLuint rightMatrixID = 0;
+
+	void initialize(int width, int height);
+
+	// Get the uniform handles, again after the program is rebuilt
+	void loadUniforms();
+
+	// (Re)allocate the attachments for a given per-eye size
+	void resize(int width, int height);
+
+	// Bind the target and clear it. Geometry must place each eye in its own half.
+	void begin(int width, int height);
+
+	// Draw the anaglyph into the target framebuffer (0 for the window). Each 
+	// matrix maps the RGB of one eye to its contribution in the output color.
+	void composite(const glm::mat3 &leftMatrix, const glm::mat3 &rightMatrix, GLuint targetFramebufferID, int viewportWidth, int viewportHeight);
+
+	void cleanup();
+};
+
+#endif
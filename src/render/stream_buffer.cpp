@@ -0,0 +1,101 @@
+#include "stream_buffer.h"
+#include "render_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+StreamBuffer instanceStream;
+
+void StreamBuffer::initialize(size_t initialRegionSize) {
+	glGenBuffers(1, &bufferID);
+	reallocate(initialRegionSize);
+	region = 0;
+	used = 0;
+}
+
+void StreamBuffer::cleanup() {
+	deleteFences();
+	glDeleteBuffers(1, &bufferID);
+	bufferID = 0;
+}
+
+void StreamBuffer::deleteFences() {
+	for (int i = 0; i < regionCount; ++i) {
+		if (fences[i]) glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+}
+
+// New storage for every region. Draws already submitted keep the old storage 
+// alive, so nothing needs to be waited for.
+void StreamBuffer::reallocate(size_t newRegionSize) {
+	regionSize = (newRegionSize + alignment - 1) / alignment * alignment;
+	renderState.bindBuffer(GL_ARRAY_BUFFER, bufferID);
+	glBufferData(GL_ARRAY_BUFFER, regionSize * regionCount, NULL, GL_STREAM_DRAW);
+	deleteFences();
+}
+
+void StreamBuffer::beginFrame() {
+	region = (region + 1) % regionCount;
+	used = 0;
+	++frames;
+
+	GLsync fence = fences[region];
+	if (!fence) return;
+	fences[region] = 0;
+
+	// Poll first so only real stalls are counted
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		++fenceWaits;
+		auto start = std::chrono::steady_clock::now();
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);	// 100 ms
+		} while (status == GL_TIMEOUT_EXPIRED);
+		fenceWaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	if (status == GL_WAIT_FAILED) {
+		std::cerr << "Waiting on a stream buffer fence failed." << std::endl;
+	}
+	glDeleteSync(fence);
+}
+
+void StreamBuffer::endFrame() {
+	if (used == 0) return;
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void *StreamBuffer::map(size_t size, GLintptr &offset) {
+	size = (size + alignment - 1) / alignment * alignment;
+	if (used + size > regionSize) {
+		if (regionSize < maxRegionSize) {
+			size_t newRegionSize = regionSize;
+			while (newRegionSize < used + size) newRegionSize *= 2;
+			reallocate(std::max(std::min(newRegionSize, maxRegionSize), size));
+			++grows;
+		} else {
+			reallocate(std::max(regionSize, size));
+			++orphans;
+		}
+		used = 0;
+	}
+
+	offset = (GLintptr)(region * regionSize + used);
+	used += size;
+
+	renderState.bindBuffer(GL_ARRAY_BUFFER, bufferID);
+	void *data = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	mapped = data != NULL;
+	if (!data) {
+		std::cerr << "Cannot map the stream buffer." << std::endl;
+	}
+	return data;
+}
+
+void StreamBuffer::unmap() {
+	if (!mapped) return;
+	renderState.bindBuffer(GL_ARRAY_BUFFER, bufferID);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	mapped = false;
+}
@@ -0,0 +1,57 @@
+#ifndef _STREAM_BUFFER_H_
+#define _STREAM_BUFFER_H_
+
+#include <glad/gl.h>
+
+#include <cstddef>
+
+// Ring buffer for vertex data that is rewritten every frame. The buffer is 
+// split into one region per frame in flight. map() sub-allocates from the 
+// current frame's region with GL_MAP_UNSYNCHRONIZED_BIT, so writing never 
+// waits for the driver; instead endFrame() puts a fence behind the frame's 
+// draws, and beginFrame() waits on it before the region comes around again. 
+// A frame that outgrows its region doubles the regions (orphaning the old 
+// storage) up to maxRegionSize, past which it orphans the buffer and starts over.
+struct StreamBuffer {
+	static const int regionCount = 3;
+	static const size_t alignment = 64;
+
+	GLuint bufferID = 0;
+	size_t regionSize = 0;
+	size_t maxRegionSize = 64 << 20;
+	int region = 0;					// Region of the current frame
+	size_t used = 0;				// Bytes allocated in it so far
+	GLsync fences[regionCount] = {};
+	bool mapped = false;
+
+	// Statistics since initialize()
+	int frames = 0;
+	int fenceWaits = 0;				// beginFrame() found the GPU still reading the region
+	double fenceWaitMilliseconds = 0;
+	int grows = 0;
+	int orphans = 0;
+
+	void initialize(size_t initialRegionSize = 1 << 20);
+	void cleanup();
+
+	// Wait until the GPU is done with the next region and make it current
+	void beginFrame();
+
+	// Fence the draws that read this frame's region
+	void endFrame();
+
+	// Map `size` bytes of the current region for writing and leave the buffer 
+	// bound to GL_ARRAY_BUFFER. `offset` receives their position in the buffer. 
+	// Call unmap() before drawing.
+	void *map(size_t size, GLintptr &offset);
+	void unmap();
+
+private:
+	void reallocate(size_t newRegionSize);
+	void deleteFences();
+};
+
+// Per-instance attributes of the models stream through a single buffer
+extern StreamBuffer instanceStream;
+
+#endif
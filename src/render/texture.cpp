@@ -1,6 +1,6 @@
 #include "texture.h"
+#include "render_state.h"
 
-#define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 #include <iostream>
@@ -10,7 +10,7 @@ GLuint LoadTexture(const char *texture_file_path) {
     uint8_t* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
     GLuint texture;
     glGenTextures(1, &texture);  
-    glBindTexture(GL_TEXTURE_2D, texture);  
+    renderState.bindTexture(0, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -0,0 +1,224 @@
+#include "texture_streamer.h"
+#include "render_state.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+TextureStreamer textureStreamer;
+
+void TextureStreamer::initialize(int pixelBufferCount) {
+	for (int i = 0; i < pixelBufferCount; ++i) {
+		std::unique_ptr<Upload> upload(new Upload);
+		glGenBuffers(1, &upload->pixelBufferID);
+		uploads.push_back(std::move(upload));
+	}
+	stopping = false;
+	worker = std::thread(&TextureStreamer::run, this);
+}
+
+GLuint TextureStreamer::request(const std::string &path) {
+	if (!std::ifstream(path).good()) return 0;
+
+	std::unique_ptr<Texture> texture(new Texture);
+	texture->path = path;
+
+	// Placeholder: one mid-grey texel until the first level arrives
+	static const unsigned char grey[3] = { 128, 128, 128 };
+	glGenTextures(1, &texture->textureID);
+	renderState.bindTexture(0, texture->textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	GLuint textureID = texture->textureID;
+	Task task = { texture.get(), NULL };
+	textures.push_back(std::move(texture));
+	push(task);
+	return textureID;
+}
+
+void TextureStreamer::push(const Task &task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+	}
+	wake.notify_one();
+}
+
+void TextureStreamer::run() {
+	for (;;) {
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping) return;
+			task = tasks.front();
+			tasks.pop_front();
+		}
+
+		if (task.texture) {
+			Texture &texture = *task.texture;
+			if (texture.container.open(texture.path)) {
+				// Levels are uploaded coarsest first, which sit at the end of the file
+				const TextureContainerLevel &last = texture.container.levels[texture.container.header->levelCount - 1];
+				texture.container.file.prefetch(texture.container.levels[0].offset, last.offset + last.size - texture.container.levels[0].offset);
+				texture.state = Ready;
+			} else {
+				std::cerr << "Cannot open texture container " << texture.path << std::endl;
+				texture.state = Failed;
+			}
+		} else {
+			// The page faults on the mapping land here, not on the GL thread
+			Upload &upload = *task.upload;
+			memcpy(upload.mapped, upload.texture->container.levelData(upload.level), upload.texture->container.levels[upload.level].size);
+			upload.copied = true;
+		}
+	}
+}
+
+// Map a free pixel buffer for the next level of a texture and queue the copy
+bool TextureStreamer::startUpload(Texture &texture, size_t &budget) {
+	const TextureContainerLevel &level = texture.container.levels[texture.nextLevel];
+	// Always let one level through, or a large level 0 would never fit the budget
+	if (level.size > budget && budget < maxBytesPerFrame) return false;
+
+	Upload *upload = NULL;
+	for (std::unique_ptr<Upload> &candidate : uploads) {
+		if (!candidate->texture) {
+			upload = candidate.get();
+			break;
+		}
+	}
+	if (!upload) return false;
+
+	renderState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, upload->pixelBufferID);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)level.size, NULL, GL_STREAM_DRAW);
+	upload->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)level.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	renderState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!upload->mapped) {
+		// Give up on the texture rather than retry every frame: it keeps the levels 
+		// it has, and the uploads already in flight still land
+		std::cerr << "Cannot map a pixel buffer for level " << texture.nextLevel << " of " << texture.path << std::endl;
+		texture.state = Failed;
+		texture.nextLevel = -1;
+		return false;
+	}
+
+	upload->texture = &texture;
+	upload->level = texture.nextLevel;
+	upload->copied = false;
+	--texture.nextLevel;
+	++texture.levelsInFlight;
+	budget = level.size > budget ? 0 : budget - (size_t)level.size;
+
+	Task task = { NULL, upload };
+	push(task);
+	return true;
+}
+
+// Define a level from its filled pixel buffer and make it the base level
+static void finishUpload(TextureStreamer::Upload &upload) {
+	TextureStreamer::Texture &texture = *upload.texture;
+	const TextureContainerLevel &level = texture.container.levels[upload.level];
+	renderState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pixelBufferID);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	renderState.bindTexture(0, texture.textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, upload.level, GL_RGB8, level.width, level.height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void *)0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	renderState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// Levels below the base are ignored, so the placeholder in level 0 stays 
+	// harmless until level 0 itself is replaced
+	if (upload.level == (int)texture.container.header->levelCount - 1) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, upload.level);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+	texture.residentLevel = upload.level;
+	--texture.levelsInFlight;
+
+	if (upload.level == 0) {
+		std::cout << "Texture resident: " << texture.path << std::endl;
+		texture.container.close();
+	}
+	upload.texture = NULL;
+	upload.mapped = NULL;
+}
+
+void TextureStreamer::update() {
+	// Finish uploads the worker has copied. A texture only takes the level right 
+	// below its current base, otherwise the levels between would be undefined.
+	bool progress = true;
+	while (progress) {
+		progress = false;
+		for (std::unique_ptr<Upload> &upload : uploads) {
+			if (upload->texture && upload->copied && upload->level == upload->texture->residentLevel - 1) {
+				finishUpload(*upload);
+				progress = true;
+			}
+		}
+	}
+
+	size_t budget = maxBytesPerFrame;
+	for (std::unique_ptr<Texture> &pointer : textures) {
+		Texture &texture = *pointer;
+		if (texture.state != Ready) continue;
+
+		if (texture.nextLevel < 0 && texture.residentLevel < 0) {
+			texture.residentLevel = (int)texture.container.header->levelCount;
+			texture.nextLevel = texture.residentLevel - 1;
+		}
+		while (texture.nextLevel >= 0 && startUpload(texture, budget)) {}
+	}
+}
+
+bool TextureStreamer::idle() const {
+	for (const std::unique_ptr<Texture> &texture : textures) {
+		if (texture->state == Opening || texture->levelsInFlight > 0) return false;
+		if (texture->state == Ready && texture->residentLevel != 0) return false;
+	}
+	return true;
+}
+
+bool TextureStreamer::finish() {
+	size_t budget = maxBytesPerFrame;
+	maxBytesPerFrame = (size_t)-1;
+	// Failed textures count as idle, so this ends even if uploads keep failing
+	while (!idle()) {
+		update();
+		std::this_thread::yield();
+	}
+	maxBytesPerFrame = budget;
+
+	for (const std::unique_ptr<Texture> &texture : textures) {
+		if (texture->state == Failed) return false;
+	}
+	return true;
+}
+
+void TextureStreamer::cleanup() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	if (worker.joinable()) worker.join();
+
+	for (std::unique_ptr<Upload> &upload : uploads) {
+		if (upload->mapped) {
+			renderState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, upload->pixelBufferID);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glDeleteBuffers(1, &upload->pixelBufferID);
+	}
+	renderState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	uploads.clear();
+	textures.clear();
+}
@@ -0,0 +1,88 @@
+#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+
+#include <glad/gl.h>
+
+#include <io/texture_container.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams baked texture containers (.atex) to the GPU without blocking the 
+// render loop. request() returns a texture at once, showing a 1x1 placeholder. 
+// A worker thread maps the file and copies level data into mapped pixel buffers, 
+// and update() hands the filled buffers to glTexImage2D, coarsest level first. 
+// GL_TEXTURE_BASE_LEVEL follows the uploads, so the texture sharpens as levels 
+// arrive instead of popping in when the last one lands.
+struct TextureStreamer {
+	struct Texture {
+		GLuint textureID = 0;
+		std::string path;
+		TextureContainer container;
+		std::atomic<int> state{0};		// Opening, Ready or Failed, set by the worker
+		int nextLevel = -1;				// Next level to upload, counting down to 0
+		int residentLevel = -1;			// Finest level defined in GL, -1 before streaming starts
+		int levelsInFlight = 0;
+	};
+
+	// A pixel buffer mapped for the worker to fill
+	struct Upload {
+		GLuint pixelBufferID = 0;
+		void *mapped = NULL;
+		Texture *texture = NULL;
+		int level = 0;
+		std::atomic<bool> copied{false};
+	};
+
+	static const int Opening = 0;
+	static const int Ready = 1;
+	static const int Failed = 2;
+
+	std::vector<std::unique_ptr<Texture>> textures;
+	std::vector<std::unique_ptr<Upload>> uploads;		// Pixel buffer ring, one upload each in flight
+	size_t maxBytesPerFrame = 4 << 20;			// Upload budget of one update()
+
+	// Work for the worker thread: Texture* to open, or Upload* to copy
+	struct Task {
+		Texture *texture;
+		Upload *upload;
+	};
+	std::deque<Task> tasks;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread worker;
+	bool stopping = false;
+
+	void initialize(int pixelBufferCount = 4);
+
+	// Start streaming a container. Returns 0 if the file does not exist.
+	GLuint request(const std::string &path);
+
+	// Call once per frame on the GL thread
+	void update();
+
+	// Upload everything still pending, blocking. For runs that must not show placeholders. 
+	// Returns false if a texture failed to open or upload; it keeps the placeholder or 
+	// the levels it got.
+	bool finish();
+
+	bool idle() const;
+
+	void cleanup();
+
+private:
+	void push(const Task &task);
+	void run();
+	bool startUpload(Texture &texture, size_t &budget);
+};
+
+// Shared by every model; textures are per context
+extern TextureStreamer textureStreamer;
+
+#endif
@@ -0,0 +1,9 @@
+#version 330 core
+
+in vec3 color;
+out vec4 warped;
+
+void main()
+{
+    warped = vec4(color, 1.0);     // Alpha 1 marks the pixel as written
+}
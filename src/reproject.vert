@@ -0,0 +1,20 @@
+#version 330 core
+
+// One point per left-eye pixel, moved to where the right eye sees it
+uniform sampler2D colorTexture;     // Stereo target, the left eye in the left half
+uniform sampler2D depthTexture;
+uniform mat4 reprojection;          // Left-eye NDC to right-eye clip space
+uniform int eyeWidth;
+
+out vec3 color;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_VertexID % eyeWidth, gl_VertexID / eyeWidth);
+    vec2 size = vec2(eyeWidth, textureSize(depthTexture, 0).y);
+    float depth = texelFetch(depthTexture, pixel, 0).r;
+    color = texelFetch(colorTexture, pixel, 0).rgb;
+
+    vec4 ndc = vec4((vec2(pixel) + 0.5) / size * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    gl_Position = reprojection * ndc;
+}
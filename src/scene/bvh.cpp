@@ -0,0 +1,77 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+AABB TransformUnitBounds(const glm::mat4 &modelMatrix) {
+	// Arvo's method: the extent along each world axis is the sum of the absolute 
+	// contributions of the three model axes.
+	glm::vec3 center(modelMatrix[3]);
+	glm::vec3 extent(0.0f);
+	for (int axis = 0; axis < 3; ++axis) {
+		extent += glm::abs(glm::vec3(modelMatrix[axis]));
+	}
+	AABB bounds;
+	bounds.min = center - extent;
+	bounds.max = center + extent;
+	return bounds;
+}
+
+void BVH::build(const std::vector<AABB> &bounds, int maxLeafSize) {
+	nodes.clear();
+	instanceBounds.clear();
+	indices.resize(bounds.size());
+	for (size_t i = 0; i < bounds.size(); ++i) indices[i] = (int)i;
+	if (bounds.empty()) return;
+
+	std::vector<glm::vec3> centers(bounds.size());
+	for (size_t i = 0; i < bounds.size(); ++i) centers[i] = bounds[i].center();
+
+	nodes.reserve(2 * bounds.size() / std::max(maxLeafSize, 1) + 1);
+	nodes.push_back(BVHNode());
+	nodes[0].first = 0;
+	nodes[0].count = (int)bounds.size();
+
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		int nodeIndex = stack.back();
+		stack.pop_back();
+
+		int first = nodes[nodeIndex].first;
+		int count = nodes[nodeIndex].count;
+
+		AABB nodeBounds, centerBounds;
+		nodeBounds.reset();
+		centerBounds.reset();
+		for (int i = first; i < first + count; ++i) {
+			nodeBounds.grow(bounds[indices[i]]);
+			centerBounds.min = glm::min(centerBounds.min, centers[indices[i]]);
+			centerBounds.max = glm::max(centerBounds.max, centers[indices[i]]);
+		}
+		nodes[nodeIndex].bounds = nodeBounds;
+
+		if (count <= maxLeafSize) continue;
+
+		glm::vec3 size = centerBounds.max - centerBounds.min;
+		int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+
+		int half = count / 2;
+		std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+			[&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+		int firstChild = (int)nodes.size();
+		nodes.push_back(BVHNode());
+		nodes.push_back(BVHNode());
+		nodes[firstChild].first = first;
+		nodes[firstChild].count = half;
+		nodes[firstChild + 1].first = first + half;
+		nodes[firstChild + 1].count = count - half;
+
+		nodes[nodeIndex].firstChild = firstChild;
+
+		stack.push_back(firstChild);
+		stack.push_back(firstChild + 1);
+	}
+
+	instanceBounds.resize(bounds.size());
+	for (size_t i = 0; i < bounds.size(); ++i) instanceBounds[i] = bounds[indices[i]];
+}
@@ -0,0 +1,43 @@
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	void reset() { min = glm::vec3(1e30f); max = glm::vec3(-1e30f); }
+	void grow(const AABB &b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+	glm::vec3 center() const { return 0.5f * (min + max); }
+};
+
+// World-space bounds of the canonical [-1, 1]^3 model (box or unit sphere) under a transform
+AABB TransformUnitBounds(const glm::mat4 &modelMatrix);
+
+// Bounding volume hierarchy over instance bounds. Every node covers a contiguous 
+// range of `indices`, internal nodes have their two children at firstChild and 
+// firstChild + 1.
+struct BVHNode {
+	AABB bounds;
+	int firstChild = -1;	// -1 for leaves
+	int first = 0;			// Range of BVH::indices in this subtree
+	int count = 0;
+
+	bool isLeaf() const { return firstChild < 0; }
+};
+
+struct BVH {
+	std::vector<BVHNode> nodes;
+	std::vector<int> indices;
+	std::vector<AABB> instanceBounds;	// Bounds of indices[i], for tests inside leaves
+
+	// Median split along the longest centroid axis, down to maxLeafSize instances per leaf
+	void build(const std::vector<AABB> &bounds, int maxLeafSize = 4);
+
+	bool empty() const { return nodes.empty(); }
+};
+
+#endif
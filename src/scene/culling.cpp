@@ -0,0 +1,209 @@
+#include "culling.h"
+
+#include <chrono>
+#include <cmath>
+
+static glm::vec4 normalizePlane(const glm::vec4 &plane) {
+	float length = glm::length(glm::vec3(plane));
+	return plane * (1.0f / length);
+}
+
+void Frustum::fromMatrix(const glm::mat4 &m) {
+	// Gribb-Hartmann: planes are sums and differences of the rows of the matrix
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i) {
+		rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+	planes[0] = normalizePlane(rows[3] + rows[0]);
+	planes[1] = normalizePlane(rows[3] - rows[0]);
+	planes[2] = normalizePlane(rows[3] + rows[1]);
+	planes[3] = normalizePlane(rows[3] - rows[1]);
+	planes[4] = normalizePlane(rows[3] + rows[2]);
+	planes[5] = normalizePlane(rows[3] - rows[2]);
+	planeCount = 6;
+}
+
+// Corners of the frustum in world space, indexed [z][y][x] with 0 = -1 and 1 = +1 in NDC
+static void frustumCorners(const glm::mat4 &viewProjection, glm::vec3 corners[2][2][2]) {
+	glm::mat4 inverse = glm::inverse(viewProjection);
+	for (int z = 0; z < 2; ++z) {
+		for (int y = 0; y < 2; ++y) {
+			for (int x = 0; x < 2; ++x) {
+				glm::vec4 p = inverse * glm::vec4(2.0f * x - 1, 2.0f * y - 1, 2.0f * z - 1, 1);
+				corners[z][y][x] = glm::vec3(p) / p.w;
+			}
+		}
+	}
+}
+
+static bool containsAll(const glm::vec4 &plane, const glm::vec3 *points, int count, float tolerance) {
+	for (int i = 0; i < count; ++i) {
+		if (glm::dot(glm::vec3(plane), points[i]) + plane.w < -tolerance) return false;
+	}
+	return true;
+}
+
+void Frustum::fromUnion(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection) {
+	Frustum eyes[2];
+	eyes[0].fromMatrix(leftViewProjection);
+	eyes[1].fromMatrix(rightViewProjection);
+
+	glm::vec3 corners[2][2][2][2];	// [eye][z][y][x]
+	frustumCorners(leftViewProjection, corners[0]);
+	frustumCorners(rightViewProjection, corners[1]);
+	const glm::vec3 *points = &corners[0][0][0][0];
+
+	glm::vec3 centroid(0.0f);
+	for (int i = 0; i < 16; ++i) centroid += points[i];
+	centroid /= 16.0f;
+	float radius = 0;
+	for (int i = 0; i < 16; ++i) radius = std::max(radius, glm::distance(points[i], centroid));
+	float tolerance = 1e-4f * radius;
+
+	planeCount = 0;
+	for (int side = 0; side < 6; ++side) {
+		// Either eye's own plane, if it bounds the other frustum as well
+		bool found = false;
+		for (int eye = 0; eye < 2 && !found; ++eye) {
+			if (containsAll(eyes[eye].planes[side], points, 16, tolerance)) {
+				planes[planeCount++] = eyes[eye].planes[side];
+				found = true;
+			}
+		}
+
+		// Otherwise (left/right/bottom/top only) a plane through the near edge 
+		// of one eye and the far edge of the other
+		if (found || side >= 4) continue;
+		int axis = side / 2;		// 0: x, 1: y
+		int end = side % 2;			// 0: -1, 1: +1
+		for (int nearEye = 0; nearEye < 2 && !found; ++nearEye) {
+			for (int farEye = 0; farEye < 2 && !found; ++farEye) {
+				glm::vec3 p0 = axis == 0 ? corners[nearEye][0][0][end] : corners[nearEye][0][end][0];
+				glm::vec3 p1 = axis == 0 ? corners[nearEye][0][1][end] : corners[nearEye][0][end][1];
+				glm::vec3 p2 = axis == 0 ? corners[farEye][1][0][end] : corners[farEye][1][end][0];
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				if (glm::length(normal) < 1e-12f) continue;
+				normal = glm::normalize(normal);
+				glm::vec4 plane(normal, -glm::dot(normal, p0));
+				if (glm::dot(normal, centroid) + plane.w < 0) plane = plane * -1.0f;
+				if (containsAll(plane, points, 16, tolerance)) {
+					planes[planeCount++] = plane;
+					found = true;
+				}
+			}
+		}
+	}
+}
+
+enum { Outside = 0x80 };
+
+// Test a box against the planes still set in mask. Clears the bits of planes the 
+// box is completely inside of, or sets Outside.
+static void classify(const Frustum &frustum, const AABB &box, unsigned &mask) {
+	for (int i = 0; i < frustum.planeCount; ++i) {
+		if (!(mask & (1u << i))) continue;
+		const glm::vec4 &plane = frustum.planes[i];
+		glm::vec3 positive(plane.x >= 0 ? box.max.x : box.min.x, plane.y >= 0 ? box.max.y : box.min.y, plane.z >= 0 ? box.max.z : box.min.z);
+		glm::vec3 negative(plane.x >= 0 ? box.min.x : box.max.x, plane.y >= 0 ? box.min.y : box.max.y, plane.z >= 0 ? box.min.z : box.max.z);
+		if (glm::dot(glm::vec3(plane), positive) + plane.w < 0) {
+			mask = Outside;
+			return;
+		}
+		if (glm::dot(glm::vec3(plane), negative) + plane.w >= 0) {
+			mask &= ~(1u << i);
+		}
+	}
+}
+
+void CullStereo(const BVH &bvh, const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, 
+	std::vector<int> &visibleLeft, std::vector<int> &visibleRight, std::vector<int> &visibleEither, CullStats &stats) {
+	auto start = std::chrono::steady_clock::now();
+
+	visibleLeft.clear();
+	visibleRight.clear();
+	visibleEither.clear();
+	stats = CullStats();
+	stats.instances = (int)bvh.indices.size();
+	if (bvh.empty()) return;
+
+	Frustum unionFrustum, leftFrustum, rightFrustum;
+	unionFrustum.fromUnion(leftViewProjection, rightViewProjection);
+	leftFrustum.fromMatrix(leftViewProjection);
+	rightFrustum.fromMatrix(rightViewProjection);
+
+	struct Entry {
+		int node;
+		unsigned unionMask, leftMask, rightMask;
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, (1u << unionFrustum.planeCount) - 1, 0x3f, 0x3f });
+
+	while (!stack.empty()) {
+		Entry entry = stack.back();
+		stack.pop_back();
+		const BVHNode &node = bvh.nodes[entry.node];
+
+		// One test rejects the node for both eyes
+		++stats.nodesTested;
+		if (entry.unionMask) {
+			classify(unionFrustum, node.bounds, entry.unionMask);
+			if (entry.unionMask == Outside) continue;
+		}
+
+		// Refine per eye
+		if (entry.leftMask && entry.leftMask != Outside) {
+			++stats.eyeTests;
+			classify(leftFrustum, node.bounds, entry.leftMask);
+		}
+		if (entry.rightMask && entry.rightMask != Outside) {
+			++stats.eyeTests;
+			classify(rightFrustum, node.bounds, entry.rightMask);
+		}
+		bool inLeft = entry.leftMask != Outside;
+		bool inRight = entry.rightMask != Outside;
+		if (!inLeft && !inRight) continue;
+
+		// Subtrees that are fully inside for every eye that sees them are accepted whole
+		bool settled = (!inLeft || entry.leftMask == 0) && (!inRight || entry.rightMask == 0);
+		if (settled) {
+			for (int i = node.first; i < node.first + node.count; ++i) {
+				int instance = bvh.indices[i];
+				if (inLeft) visibleLeft.push_back(instance);
+				if (inRight) visibleRight.push_back(instance);
+				visibleEither.push_back(instance);
+			}
+			continue;
+		}
+
+		// Leaves test their instances against the planes that are still undecided
+		if (node.isLeaf()) {
+			for (int i = node.first; i < node.first + node.count; ++i) {
+				unsigned leftMask = inLeft ? entry.leftMask : (unsigned)Outside;
+				unsigned rightMask = inRight ? entry.rightMask : (unsigned)Outside;
+				if (leftMask && leftMask != Outside) {
+					++stats.eyeTests;
+					classify(leftFrustum, bvh.instanceBounds[i], leftMask);
+				}
+				if (rightMask && rightMask != Outside) {
+					++stats.eyeTests;
+					classify(rightFrustum, bvh.instanceBounds[i], rightMask);
+				}
+
+				int instance = bvh.indices[i];
+				if (leftMask != Outside) visibleLeft.push_back(instance);
+				if (rightMask != Outside) visibleRight.push_back(instance);
+				if (leftMask != Outside || rightMask != Outside) visibleEither.push_back(instance);
+			}
+			continue;
+		}
+
+		stack.push_back({ node.firstChild + 1, entry.unionMask, entry.leftMask, entry.rightMask });
+		stack.push_back({ node.firstChild, entry.unionMask, entry.leftMask, entry.rightMask });
+	}
+
+	stats.visibleLeft = (int)visibleLeft.size();
+	stats.visibleRight = (int)visibleRight.size();
+	stats.visibleEither = (int)visibleEither.size();
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
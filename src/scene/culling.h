@@ -0,0 +1,39 @@
+#ifndef _CULLING_H_
+#define _CULLING_H_
+
+#include "bvh.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Convex volume bounded by up to six planes (ax + by + cz + d >= 0 inside)
+struct Frustum {
+	glm::vec4 planes[6];
+	int planeCount = 0;
+
+	// Planes of a view-projection matrix: left, right, bottom, top, near, far
+	void fromMatrix(const glm::mat4 &viewProjection);
+
+	// Conservative convex bound of the union of two eye frusta. Where neither 
+	// eye's plane contains the other frustum, a plane spanning both is used.
+	void fromUnion(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection);
+};
+
+struct CullStats {
+	int instances = 0;
+	int nodesTested = 0;		// Nodes tested against the union frustum
+	int eyeTests = 0;			// Per-eye refinement tests
+	int visibleLeft = 0;
+	int visibleRight = 0;
+	int visibleEither = 0;
+	double milliseconds = 0;
+};
+
+// Walk the BVH once: nodes outside the union of both eye frusta are rejected 
+// for both eyes with a single test, the rest are refined per eye. Planes a node 
+// is completely inside of are not tested again below it.
+void CullStereo(const BVH &bvh, const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, 
+	std::vector<int> &visibleLeft, std::vector<int> &visibleRight, std::vector<int> &visibleEither, CullStats &stats);
+
+#endif
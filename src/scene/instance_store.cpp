@@ -0,0 +1,81 @@
+#include "instance_store.h"
+
+#include <util/philox.h>
+#include <util/thread_pool.h>
+
+#include <cmath>
+
+void InstanceStore::resize(size_t count) {
+	positionX.resize(count);
+	positionY.resize(count);
+	positionZ.resize(count);
+	scale.resize(count);
+	axisX.resize(count);
+	axisY.resize(count);
+	axisZ.resize(count);
+	angle.resize(count);
+	colors.resize(count);
+	transforms.resize(count);
+	bounds.resize(count);
+}
+
+void InstanceStore::updateTransform(size_t i) {
+	// Rodrigues' rotation, the same matrix glm::rotate builds, with the scale 
+	// folded into the columns and the translation in the last one
+	float x = axisX[i], y = axisY[i], z = axisZ[i];
+	float c = cosf(angle[i]), s = sinf(angle[i]), t = 1.0f - c;
+	float k = scale[i];
+
+	glm::mat4 &m = transforms[i];
+	m[0] = glm::vec4(k * (t * x * x + c), k * (t * x * y + s * z), k * (t * x * z - s * y), 0.0f);
+	m[1] = glm::vec4(k * (t * x * y - s * z), k * (t * y * y + c), k * (t * y * z + s * x), 0.0f);
+	m[2] = glm::vec4(k * (t * x * z + s * y), k * (t * y * z - s * x), k * (t * z * z + c), 0.0f);
+	m[3] = glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f);
+
+	bounds[i] = TransformUnitBounds(m);
+}
+
+static void generateRange(InstanceStore &store, int begin, int end, uint64_t seed) {
+	const uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+	for (int i = begin; i < end; ++i) {
+		uint32_t first[4], second[4];
+		const uint32_t counter0[4] = { (uint32_t)i, 0, 0, 0 };
+		const uint32_t counter1[4] = { (uint32_t)i, 1, 0, 0 };
+		Philox4x32(counter0, key, first);
+		Philox4x32(counter1, key, second);
+
+		store.positionX[i] = 100.0f * (PhiloxUniform(first[0]) - 0.5f);
+		store.positionY[i] = 100.0f * (PhiloxUniform(first[1]) - 0.5f);
+		store.positionZ[i] = 100.0f * (PhiloxUniform(first[2]) - 0.5f);
+		store.scale[i] = (float)(1 + first[3] % 4);
+
+		// The scale only takes the low bits, each tint channel gets 7 of the rest in [128, 255]
+		uint32_t r = 0x80 | ((first[3] >> 8) & 0x7f);
+		uint32_t g = 0x80 | ((first[3] >> 16) & 0x7f);
+		uint32_t b = 0x80 | ((first[3] >> 24) & 0x7f);
+		store.colors[i] = r | (g << 8) | (b << 16) | 0xff000000u;
+		store.angle[i] = PhiloxUniform(second[0]) * 6.28318530718f;
+
+		float x = PhiloxUniform(second[1]) - 0.5f;
+		float y = PhiloxUniform(second[2]) - 0.5f;
+		float z = PhiloxUniform(second[3]) - 0.5f;
+		float length = sqrtf(x * x + y * y + z * z);
+		if (length < 1e-6f) {
+			x = 0.0f, y = 0.0f, z = 1.0f, length = 1.0f;
+		}
+		store.axisX[i] = x / length;
+		store.axisY[i] = y / length;
+		store.axisZ[i] = z / length;
+
+		store.updateTransform(i);
+	}
+}
+
+void GenerateRandomInstances(InstanceStore &store, int count, uint64_t seed, ThreadPool *pool) {
+	store.resize(count);
+	if (pool) {
+		pool->parallelFor(0, count, 16384, [&](int begin, int end) { generateRange(store, begin, end, seed); });
+	} else {
+		generateRange(store, 0, count, seed);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef _INSTANCE_STORE_H_
+#define _INSTANCE_STORE_H_
+
+#include <scene/bvh.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct ThreadPool;
+
+// Scene instances as a structure of arrays: the random parameters each 
+// instance was generated from, and the matrices and bounds derived from them 
+// that the renderer and the culler read. Scenes loaded from a snapshot have 
+// no parameters, only colors, transforms and bounds.
+struct InstanceStore {
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> scale;
+	std::vector<float> axisX, axisY, axisZ;		// Unit rotation axis
+	std::vector<float> angle;					// Radians
+	std::vector<uint32_t> colors;				// RGBA8 tint, red in the low byte
+
+	std::vector<glm::mat4> transforms;			// translate * rotate * scale
+	std::vector<AABB> bounds;					// TransformUnitBounds(transforms[i])
+
+	size_t size() const { return transforms.size(); }
+	void resize(size_t count);
+
+	// Recompute transforms[i] and bounds[i] from the parameters
+	void updateTransform(size_t i);
+};
+
+// Fill the store with `count` instances at random positions in [-50, 50)^3, 
+// with a random rotation, an integer scale of 1 to 4 and a light random tint. 
+// Instance i draws its numbers from Philox counters (i, 0) and (i, 1) under 
+// `seed`, so the scene is identical for any pool size, and NULL runs serially.
+void GenerateRandomInstances(InstanceStore &store, int count, uint64_t seed, ThreadPool *pool);
+
+#endif
@@ -0,0 +1,297 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Cache misses and distinct vertices of an index list, with a FIFO cache of cacheSize vertices
+static void countCacheMisses(const uint32_t *indices, size_t indexCount, size_t vertexCount, int cacheSize, size_t &misses, size_t &used) {
+	// A vertex is cached while fewer than cacheSize misses happened since its own
+	std::vector<uint32_t> missTime(vertexCount, 0);
+	std::vector<bool> seen(vertexCount, false);
+	uint32_t time = (uint32_t)cacheSize + 1;
+	misses = used = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		uint32_t v = indices[i];
+		if (time - missTime[v] > (uint32_t)cacheSize) {
+			missTime[v] = time++;
+			++misses;
+		}
+		if (!seen[v]) {
+			seen[v] = true;
+			++used;
+		}
+	}
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount, int cacheSize) {
+	VertexCacheStats stats;
+	size_t misses, used;
+	countCacheMisses(indices, indexCount, vertexCount, cacheSize, misses, used);
+	if (indexCount >= 3) stats.acmr = (double)misses / (indexCount / 3);
+	if (used > 0) stats.atvr = (double)misses / used;
+	return stats;
+}
+
+// Forsyth's scoring, for an LRU cache a little larger than the hardware's
+static const int scoringCacheSize = 32;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+	if (remainingTriangles == 0) return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// The last triangle's vertices score a little lower, so the next one does not
+		// just turn around on the same edge
+		if (cachePosition < 3) score = 0.75f;
+		else score = powf(1.0f - (float)(cachePosition - 3) / (scoringCacheSize - 3), 1.5f);
+	}
+	// Prefer finishing vertices with few triangles left, so they leave the cache for good
+	return score + 2.0f * powf((float)remainingTriangles, -0.5f);
+}
+
+void OptimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0) return;
+
+	// The triangles not yet emitted using each vertex
+	std::vector<uint32_t> remaining(vertexCount, 0), first(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i) ++remaining[indices[i]];
+	for (size_t v = 0; v < vertexCount; ++v) first[v + 1] = first[v] + remaining[v];
+	std::vector<uint32_t> triangles(triangleCount * 3);
+	{
+		std::vector<uint32_t> cursor(first.begin(), first.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i) triangles[cursor[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) score[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	std::vector<uint32_t> cache, nextCache;
+	size_t nextUnemitted = 0;
+	long best = -1;
+
+	while (output.size() < triangleCount * 3) {
+		// Nothing in the cache has triangles left: start over at the next one in the input
+		if (best < 0) {
+			while (emitted[nextUnemitted]) ++nextUnemitted;
+			best = (long)nextUnemitted;
+		}
+
+		const uint32_t *triangle = indices + 3 * best;
+		emitted[best] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		for (int corner = 0; corner < 3; ++corner) {
+			uint32_t v = triangle[corner];
+			uint32_t *begin = &triangles[first[v]], *end = begin + remaining[v];
+			uint32_t *found = std::find(begin, end, (uint32_t)best);
+			if (found != end) {
+				*found = end[-1];
+				--remaining[v];
+			}
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		nextCache.assign(triangle, triangle + 3);
+		for (uint32_t v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+		}
+		for (size_t i = scoringCacheSize; i < nextCache.size(); ++i) {
+			cachePosition[nextCache[i]] = -1;
+			score[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+		}
+		if (nextCache.size() > (size_t)scoringCacheSize) nextCache.resize(scoringCacheSize);
+		cache.swap(nextCache);
+		for (size_t i = 0; i < cache.size(); ++i) {
+			cachePosition[cache[i]] = (int)i;
+			score[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+		}
+
+		// Continue with the best triangle touching the cache
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t v : cache) {
+			for (uint32_t i = first[v]; i < first[v] + remaining[v]; ++i) {
+				const uint32_t *candidate = indices + 3 * triangles[i];
+				float candidateScore = score[candidate[0]] + score[candidate[1]] + score[candidate[2]];
+				if (candidateScore > bestScore) {
+					bestScore = candidateScore;
+					best = (long)triangles[i];
+				}
+			}
+		}
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(uint32_t *indices, size_t indexCount, unsigned char *vertices, size_t vertexCount, size_t stride) {
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		if (remap[indices[i]] == unused) remap[indices[i]] = next++;
+		indices[i] = remap[indices[i]];
+	}
+	for (size_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] == unused) remap[v] = next++;
+	}
+
+	std::vector<unsigned char> reordered(vertexCount * stride);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		memcpy(&reordered[remap[v] * stride], vertices + v * stride, stride);
+	}
+	memcpy(vertices, reordered.data(), reordered.size());
+}
+
+static uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t mantissa = bits & 0x7fffff;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+
+	if (((bits >> 23) & 0xff) == 0xff) return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));	// Infinity or NaN
+	if (exponent >= 31) return (uint16_t)(sign | 0x7c00);		// Too large
+	if (exponent <= 0) {
+		// Denormal, or zero when too small even for that
+		if (exponent < -10) return (uint16_t)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1) ++half;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) ++half;		// Round, carrying into the exponent if needed
+	return (uint16_t)half;
+}
+
+// The quantized type for an attribute at `location` whose values span [low, high]
+static MeshAttributeType quantizedType(uint32_t location, float low, float high) {
+	switch (location) {
+	case 0: return (low >= -1.0f && high <= 1.0f) ? MeshSnorm16 : MeshFloat16;
+	case 1: return MeshUnorm8;
+	case 2: return (low >= 0.0f && high <= 1.0f) ? MeshUnorm16 : MeshFloat16;
+	default: return MeshFloat16;
+	}
+}
+
+static void quantizeAttributes(MeshData &mesh) {
+	uint32_t vertexCount = mesh.header.vertexCount;
+	uint32_t stride = mesh.header.vertexStride;
+
+	// Lay the new attributes out in the same order, each 4-byte aligned
+	std::vector<MeshContainerAttribute> attributes = mesh.attributes;
+	uint32_t newStride = 0;
+	for (MeshContainerAttribute &attribute : attributes) {
+		float low = 0.0f, high = 0.0f;
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			const float *values = (const float *)&mesh.vertices[(size_t)v * stride + attribute.offset];
+			for (uint32_t c = 0; c < attribute.components; ++c) {
+				low = (v == 0 && c == 0) ? values[c] : std::min(low, values[c]);
+				high = (v == 0 && c == 0) ? values[c] : std::max(high, values[c]);
+			}
+		}
+		attribute.type = quantizedType(attribute.location, low, high);
+		attribute.offset = newStride;
+		newStride += (MeshAttributeTypeSize(attribute.type) * attribute.components + 3) / 4 * 4;
+	}
+
+	std::vector<unsigned char> vertices((size_t)vertexCount * newStride, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		for (size_t a = 0; a < attributes.size(); ++a) {
+			const float *values = (const float *)&mesh.vertices[(size_t)v * stride + mesh.attributes[a].offset];
+			unsigned char *out = &vertices[(size_t)v * newStride + attributes[a].offset];
+			for (uint32_t c = 0; c < attributes[a].components; ++c) {
+				float value = values[c];
+				switch (attributes[a].type) {
+				case MeshSnorm16: ((int16_t *)out)[c] = (int16_t)lroundf(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f); break;
+				case MeshUnorm16: ((uint16_t *)out)[c] = (uint16_t)lroundf(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f); break;
+				case MeshUnorm8: out[c] = (unsigned char)lroundf(std::min(std::max(value, 0.0f), 1.0f) * 255.0f); break;
+				default: ((uint16_t *)out)[c] = floatToHalf(value); break;
+				}
+			}
+		}
+	}
+	mesh.attributes.swap(attributes);
+	mesh.vertices.swap(vertices);
+	mesh.header.vertexStride = newStride;
+}
+
+void OptimizeMesh(MeshData &mesh, MeshOptimizeStats *stats) {
+	MeshContainerHeader &header = mesh.header;
+	for (const MeshContainerAttribute &attribute : mesh.attributes) {
+		if (attribute.type != MeshFloat32) return;	// Optimized already
+	}
+
+	// The vertices each level uses: its indices are relative to baseVertex
+	struct Range { uint32_t begin, end; };
+	std::vector<Range> ranges(mesh.levels.size());
+	for (size_t l = 0; l < mesh.levels.size(); ++l) {
+		const MeshContainerLevel &level = mesh.levels[l];
+		uint32_t count = 0;
+		for (uint32_t i = level.firstIndex; i < level.firstIndex + level.indexCount; ++i) count = std::max(count, mesh.indices[i] + 1);
+		ranges[l].begin = (uint32_t)level.baseVertex;
+		ranges[l].end = ranges[l].begin + count;
+	}
+	// Levels sharing vertices keep the vertex order, renumbering would break the others
+	bool reorderVertices = true;
+	for (size_t a = 0; a < ranges.size(); ++a) {
+		for (size_t b = a + 1; b < ranges.size(); ++b) {
+			if (ranges[a].begin < ranges[b].end && ranges[b].begin < ranges[a].end) reorderVertices = false;
+		}
+	}
+
+	size_t missesBefore = 0, missesAfter = 0, used = 0, triangles = 0;
+	for (size_t l = 0; l < mesh.levels.size(); ++l) {
+		const MeshContainerLevel &level = mesh.levels[l];
+		uint32_t *indices = mesh.indices.data() + level.firstIndex;
+		uint32_t vertexCount = ranges[l].end - ranges[l].begin;
+		size_t misses, levelUsed;
+
+		countCacheMisses(indices, level.indexCount, vertexCount, 16, misses, levelUsed);
+		missesBefore += misses;
+
+		OptimizeVertexCache(indices, level.indexCount, vertexCount);
+		if (reorderVertices) {
+			OptimizeVertexFetch(indices, level.indexCount, &mesh.vertices[(size_t)ranges[l].begin * header.vertexStride], vertexCount, header.vertexStride);
+		}
+
+		countCacheMisses(indices, level.indexCount, vertexCount, 16, misses, levelUsed);
+		missesAfter += misses;
+		used += levelUsed;
+		triangles += level.indexCount / 3;
+	}
+
+	if (stats) {
+		stats->strideBefore = header.vertexStride;
+		stats->indexSizeBefore = header.indexSize;
+		if (triangles > 0) {
+			stats->before.acmr = (double)missesBefore / triangles;
+			stats->after.acmr = (double)missesAfter / triangles;
+		}
+		if (used > 0) {
+			stats->before.atvr = (double)missesBefore / used;
+			stats->after.atvr = (double)missesAfter / used;
+		}
+	}
+
+	quantizeAttributes(mesh);
+
+	uint32_t largestIndex = 0;
+	for (uint32_t index : mesh.indices) largestIndex = std::max(largestIndex, index);
+	if (largestIndex <= 0xffff) {
+		mesh.shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+		header.indexSize = sizeof(uint16_t);
+	}
+
+	if (stats) {
+		stats->strideAfter = header.vertexStride;
+		stats->indexSizeAfter = header.indexSize;
+	}
+}
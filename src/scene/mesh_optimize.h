@@ -0,0 +1,42 @@
+#ifndef _MESH_OPTIMIZE_H_
+#define _MESH_OPTIMIZE_H_
+
+#include <io/mesh_container.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Post-transform cache behaviour of an index order, simulated as a FIFO cache
+struct VertexCacheStats {
+	double acmr = 0;	// Average cache miss ratio: vertices transformed per triangle, 0.5 at best, 3 at worst
+	double atvr = 0;	// Average transform to vertex ratio: vertices transformed per vertex used, 1 at best
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount, int cacheSize = 16);
+
+// Reorder the triangles of an index list so consecutive ones reuse recently 
+// transformed vertices (Forsyth's linear-speed vertex cache optimization)
+void OptimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// Renumber vertices in the order the indices first use them, so vertex fetch 
+// walks the buffer forward. Unused vertices move to the end.
+void OptimizeVertexFetch(uint32_t *indices, size_t indexCount, unsigned char *vertices, size_t vertexCount, size_t stride);
+
+struct MeshOptimizeStats {
+	VertexCacheStats before, after;		// Over all levels, weighted by triangles
+	uint32_t strideBefore = 0, strideAfter = 0;
+	uint32_t indexSizeBefore = 0, indexSizeAfter = 0;
+};
+
+// Prepare a finished mesh for drawing: optimize every level's index order for 
+// the vertex cache and its vertices for fetch, then quantize the float 
+// attributes by the renderer's locations:
+//   0 position: normalized 16-bit if inside [-1, 1], else half floats
+//   1 color: normalized 8-bit RGBA
+//   2 UV: normalized 16-bit if inside [0, 1], else half floats
+//   others: half floats
+// and store 16-bit indices when every index fits. Meshes quantized already 
+// are left alone.
+void OptimizeMesh(MeshData &mesh, MeshOptimizeStats *stats = NULL);
+
+#endif
@@ -0,0 +1,227 @@
+#include "primitives.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const float boxPositions[72] = {	// Vertex definition for a canonical box
+	// Front face
+	-1.0f, -1.0f, 1.0f, 
+	1.0f, -1.0f, 1.0f, 
+	1.0f, 1.0f, 1.0f, 
+	-1.0f, 1.0f, 1.0f, 
+	
+	// Back face 
+	1.0f, -1.0f, -1.0f, 
+	-1.0f, -1.0f, -1.0f, 
+	-1.0f, 1.0f, -1.0f, 
+	1.0f, 1.0f, -1.0f,
+	
+	// Left face
+	-1.0f, -1.0f, -1.0f, 
+	-1.0f, -1.0f, 1.0f, 
+	-1.0f, 1.0f, 1.0f, 
+	-1.0f, 1.0f, -1.0f, 
+
+	// Right face 
+	1.0f, -1.0f, 1.0f, 
+	1.0f, -1.0f, -1.0f, 
+	1.0f, 1.0f, -1.0f, 
+	1.0f, 1.0f, 1.0f,
+
+	// Top face
+	-1.0f, 1.0f, 1.0f, 
+	1.0f, 1.0f, 1.0f, 
+	1.0f, 1.0f, -1.0f, 
+	-1.0f, 1.0f, -1.0f, 
+
+	// Bottom face
+	-1.0f, -1.0f, -1.0f, 
+	1.0f, -1.0f, -1.0f, 
+	1.0f, -1.0f, 1.0f, 
+	-1.0f, -1.0f, 1.0f, 
+};
+
+// Face colors, temporarily disabled: the box is baked white
+static const bool useBoxColors = false;
+static const float boxColors[72] = {
+	// Front, red
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	// Back, yellow
+	1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+
+	// Left, green
+	0.0f, 1.0f, 0.0f, 
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	// Right, cyan
+	0.0f, 1.0f, 1.0f, 
+	0.0f, 1.0f, 1.0f, 
+	0.0f, 1.0f, 1.0f, 
+	0.0f, 1.0f, 1.0f, 
+
+	// Top, blue
+	0.0f, 0.0f, 1.0f, 
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+
+	// Bottom, magenta
+	1.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 1.0f, 
+	1.0f, 0.0f, 1.0f, 
+	1.0f, 0.0f, 1.0f,  
+};
+
+static const float boxUVs[48] = {
+	// Front
+	0.0f, 1.0f,
+	1.0f, 1.0f,
+	1.0f, 0.0f, 
+	0.0f, 0.0f,
+
+	// Back
+	0.0f, 1.0f,
+	1.0f, 1.0f,
+	1.0f, 0.0f, 
+	0.0f, 0.0f,
+
+	// Left
+	0.0f, 1.0f,
+	1.0f, 1.0f,
+	1.0f, 0.0f, 
+	0.0f, 0.0f,
+
+	// Right
+	0.0f, 1.0f,
+	1.0f, 1.0f,
+	1.0f, 0.0f, 
+	0.0f, 0.0f,
+
+	// Top - we do not want texture the top
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+
+	// Bottom - we do not want texture the bottom
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+};
+
+static const uint32_t boxIndices[36] = {		// 12 triangle faces of a box
+	0, 1, 2, 	
+	0, 2, 3, 
+	
+	4, 5, 6, 
+	4, 6, 7, 
+
+	8, 9, 10, 
+	8, 10, 11, 
+
+	12, 13, 14, 
+	12, 14, 15, 
+
+	16, 17, 18, 
+	16, 18, 19, 
+
+	20, 21, 22, 
+	20, 22, 23, 
+};
+
+void BuildBoxMesh(MeshData &mesh) {
+	// Interleaved position, color and UV
+	mesh.setLayout({ { 0, 3, MeshFloat32, 0 }, { 1, 3, MeshFloat32, 12 }, { 2, 2, MeshFloat32, 24 } }, 32);
+	mesh.vertices.resize(24 * 32);
+	const float white[3] = { 1.0f, 1.0f, 1.0f };
+	for (int v = 0; v < 24; ++v) {
+		unsigned char *vertex = mesh.vertices.data() + v * 32;
+		memcpy(vertex, boxPositions + 3 * v, 12);
+		memcpy(vertex + 12, useBoxColors ? boxColors + 3 * v : white, 12);
+		memcpy(vertex + 24, boxUVs + 2 * v, 8);
+	}
+	mesh.indices.assign(boxIndices, boxIndices + 36);
+
+	MeshContainerLevel level = { 0, 36, 0, 0.0f };
+	mesh.levels.push_back(level);
+	mesh.finish();
+}
+
+// Append a UV sphere with random colors as a new level
+static void appendSphereLevel(MeshData &mesh, int stackCount, int sectorCount) {
+	MeshContainerLevel level;
+	level.firstIndex = (uint32_t)mesh.indices.size();
+	level.baseVertex = (int32_t)(mesh.vertices.size() / 24);
+
+	// A polygon with n sectors deviates from the circle by r (1 - cos(pi / n))
+	float pi = 3.14159265358979f;
+	level.error = 1.0f - cosf(pi / sectorCount);
+
+	float radius = 1.0f;
+	float sectorStep = 2.0f * pi / sectorCount;
+	float stackStep = pi / stackCount;
+
+	for (int i = 0; i <= stackCount; ++i) {
+		float stackAngle = pi / 2 - i * stackStep; // from +pi/2 to -pi/2
+		float xy = radius * cosf(stackAngle);
+		float z = radius * sinf(stackAngle);
+
+		for (int j = 0; j <= sectorCount; ++j) {
+			float sectorAngle = j * sectorStep;
+
+			// Vertex position, then a random color
+			float vertex[6];
+			vertex[0] = xy * cosf(sectorAngle);
+			vertex[1] = xy * sinf(sectorAngle);
+			vertex[2] = z;
+			vertex[3] = static_cast<float>(rand()) / RAND_MAX;
+			vertex[4] = static_cast<float>(rand()) / RAND_MAX;
+			vertex[5] = static_cast<float>(rand()) / RAND_MAX;
+			const unsigned char *bytes = (const unsigned char *)vertex;
+			mesh.vertices.insert(mesh.vertices.end(), bytes, bytes + sizeof(vertex));
+		}
+	}
+
+	// Generate indices for drawing with GL_TRIANGLES
+	for (int i = 0; i < stackCount; ++i) {
+		int k1 = i * (sectorCount + 1);
+		int k2 = k1 + sectorCount + 1;
+
+		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
+			if (i != 0) {
+				mesh.indices.push_back(k1);
+				mesh.indices.push_back(k2);
+				mesh.indices.push_back(k1 + 1);
+			}
+			if (i != (stackCount - 1)) {
+				mesh.indices.push_back(k1 + 1);
+				mesh.indices.push_back(k2);
+				mesh.indices.push_back(k2 + 1);
+			}
+		}
+	}
+
+	level.indexCount = (uint32_t)mesh.indices.size() - level.firstIndex;
+	mesh.levels.push_back(level);
+}
+
+void BuildSphereMesh(MeshData &mesh) {
+	// Interleaved position and color
+	mesh.setLayout({ { 0, 3, MeshFloat32, 0 }, { 1, 3, MeshFloat32, 12 } }, 24);
+	const int segments[] = { 20, 14, 10, 6, 4 };
+	for (int n : segments) {
+		appendSphereLevel(mesh, n, n);
+	}
+	mesh.finish();
+}
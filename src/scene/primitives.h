@@ -0,0 +1,14 @@
+#ifndef _PRIMITIVES_H_
+#define _PRIMITIVES_H_
+
+#include <io/mesh_container.h>
+
+// The canonical box: 24 vertices (4 per face, so every face has its own UVs) 
+// spanning [-1, 1]^3, white, with the facade texture on the side faces
+void BuildBoxMesh(MeshData &mesh);
+
+// The unit sphere as levels of detail of 20, 14, 10, 6 and 4 stacks and 
+// sectors, finest first, with random vertex colors drawn from rand()
+void BuildSphereMesh(MeshData &mesh);
+
+#endif
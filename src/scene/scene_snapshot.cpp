@@ -0,0 +1,151 @@
+#include "scene_snapshot.h"
+
+#include <scene/instance_store.h>
+
+#include <cstdio>
+#include <type_traits>
+
+// Arrays are stored as the renderer holds them and copied back as blocks
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 must be tightly packed");
+static_assert(sizeof(AABB) == 6 * sizeof(float), "AABB must be tightly packed");
+static_assert(sizeof(BVHNode) == sizeof(AABB) + 3 * sizeof(int32_t), "BVHNode must be tightly packed");
+static_assert(std::is_trivially_copyable<BVHNode>::value, "BVHNode must be trivially copyable");
+
+static const size_t alignment = 16;
+
+static size_t alignUp(size_t offset) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+static bool writePadded(FILE *file, const void *data, size_t bytes, uint64_t offset, size_t &position) {
+	static const char padding[alignment] = {};
+	size_t gap = (size_t)offset - position;
+	position = (size_t)offset + bytes;
+	return fwrite(padding, 1, gap, file) == gap && fwrite(data, 1, bytes, file) == bytes;
+}
+
+// Whether [offset, offset + bytes) lies in a file of `size` bytes, at an aligned offset
+static bool fits(uint64_t offset, uint64_t bytes, size_t size) {
+	return offset % alignment == 0 && offset <= size && bytes <= size - offset;
+}
+
+bool WriteSceneSnapshot(const std::string &path, const InstanceStore &instances, const BVH *bvh, SceneSnapshotMesh mesh) {
+	size_t count = instances.size();
+	if (instances.colors.size() != count || instances.bounds.size() != count) return false;
+	if (bvh && (bvh->empty() || bvh->indices.size() != count || bvh->instanceBounds.size() != count)) return false;
+
+	SceneSnapshotHeader header = {};
+	header.magic = sceneSnapshotMagic;
+	header.version = sceneSnapshotVersion;
+	header.mesh = mesh;
+	header.instanceCount = count;
+	header.nodeCount = bvh ? bvh->nodes.size() : 0;
+	header.transformOffset = alignUp(sizeof(header));
+	header.colorOffset = alignUp(header.transformOffset + sizeof(glm::mat4) * count);
+	header.boundsOffset = alignUp(header.colorOffset + sizeof(uint32_t) * count);
+	header.nodeOffset = alignUp(header.boundsOffset + sizeof(AABB) * count);
+	header.bvhIndexOffset = alignUp(header.nodeOffset + sizeof(BVHNode) * header.nodeCount);
+	header.bvhBoundsOffset = alignUp(header.bvhIndexOffset + (bvh ? sizeof(int32_t) * count : 0));
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	size_t position = 0;
+	bool ok = writePadded(file, &header, sizeof(header), 0, position)
+		&& writePadded(file, instances.transforms.data(), sizeof(glm::mat4) * count, header.transformOffset, position)
+		&& writePadded(file, instances.colors.data(), sizeof(uint32_t) * count, header.colorOffset, position)
+		&& writePadded(file, instances.bounds.data(), sizeof(AABB) * count, header.boundsOffset, position);
+	if (ok && bvh) {
+		ok = writePadded(file, bvh->nodes.data(), sizeof(BVHNode) * bvh->nodes.size(), header.nodeOffset, position)
+			&& writePadded(file, bvh->indices.data(), sizeof(int32_t) * count, header.bvhIndexOffset, position)
+			&& writePadded(file, bvh->instanceBounds.data(), sizeof(AABB) * count, header.bvhBoundsOffset, position);
+	}
+	return fclose(file) == 0 && ok;
+}
+
+bool SceneSnapshot::open(const std::string &path) {
+	close();
+	if (!file.open(path)) return false;
+
+	if (file.size < sizeof(SceneSnapshotHeader)) {
+		close();
+		return false;
+	}
+	const SceneSnapshotHeader *h = (const SceneSnapshotHeader *)file.data;
+	uint64_t count = h->instanceCount;
+	// The BVH indexes instances and nodes with ints, which also keeps the sizes below from overflowing
+	bool ok = h->magic == sceneSnapshotMagic && h->version == sceneSnapshotVersion && (h->mesh == SnapshotBox || h->mesh == SnapshotSphere)
+		&& count <= INT32_MAX && h->nodeCount <= INT32_MAX
+		&& h->transformOffset >= sizeof(SceneSnapshotHeader) && fits(h->transformOffset, sizeof(glm::mat4) * count, file.size)
+		&& fits(h->colorOffset, sizeof(uint32_t) * count, file.size) && fits(h->boundsOffset, sizeof(AABB) * count, file.size);
+	if (ok && h->nodeCount > 0) {
+		ok = fits(h->nodeOffset, sizeof(BVHNode) * h->nodeCount, file.size) && fits(h->bvhIndexOffset, sizeof(int32_t) * count, file.size)
+			&& fits(h->bvhBoundsOffset, sizeof(AABB) * count, file.size);
+	}
+	if (!ok) {
+		close();
+		return false;
+	}
+	header = h;
+	transforms = (const glm::mat4 *)(file.data + h->transformOffset);
+	colors = (const uint32_t *)(file.data + h->colorOffset);
+	bounds = (const AABB *)(file.data + h->boundsOffset);
+	if (h->nodeCount == 0) return true;
+
+	nodes = (const BVHNode *)(file.data + h->nodeOffset);
+	bvhIndices = (const int32_t *)(file.data + h->bvhIndexOffset);
+	bvhBounds = (const AABB *)(file.data + h->bvhBoundsOffset);
+	return true;
+}
+
+void SceneSnapshot::close() {
+	file.close();
+	header = NULL;
+	transforms = NULL;
+	colors = NULL;
+	bounds = NULL;
+	nodes = NULL;
+	bvhIndices = NULL;
+	bvhBounds = NULL;
+}
+
+bool SceneSnapshot::load(InstanceStore &instances, BVH *bvh) const {
+	size_t count = size();
+	bool withBVH = bvh && hasBVH();
+	file.prefetch(header->transformOffset, sizeof(glm::mat4) * count);
+	file.prefetch(header->colorOffset, sizeof(uint32_t) * count);
+	file.prefetch(header->boundsOffset, sizeof(AABB) * count);
+	if (withBVH) {
+		file.prefetch(header->nodeOffset, sizeof(BVHNode) * header->nodeCount);
+		file.prefetch(header->bvhIndexOffset, sizeof(int32_t) * count);
+		file.prefetch(header->bvhBoundsOffset, sizeof(AABB) * count);
+	}
+
+	instances.resize(0);
+	instances.transforms.assign(transforms, transforms + count);
+	instances.colors.assign(colors, colors + count);
+	instances.bounds.assign(bounds, bounds + count);
+	if (!withBVH) return false;
+
+	bvh->nodes.assign(nodes, nodes + header->nodeCount);
+	bvh->indices.assign(bvhIndices, bvhIndices + count);
+	bvh->instanceBounds.assign(bvhBounds, bvhBounds + count);
+
+	// Culling follows these without checking, so a damaged BVH is dropped. The
+	// copies are checked while they are still in cache.
+	int nodeCount = (int)bvh->nodes.size();
+	bool valid = true;
+	for (int i = 0; i < nodeCount && valid; ++i) {
+		const BVHNode &node = bvh->nodes[i];
+		valid = node.first >= 0 && node.count > 0 && (size_t)node.first + node.count <= count
+			&& (node.isLeaf() || (node.firstChild > i && node.firstChild + 1 < nodeCount));
+	}
+	for (size_t i = 0; i < count && valid; ++i) {
+		valid = bvh->indices[i] >= 0 && (size_t)bvh->indices[i] < count;
+	}
+	if (!valid) {
+		bvh->nodes.clear();
+		bvh->indices.clear();
+		bvh->instanceBounds.clear();
+	}
+	return valid;
+}
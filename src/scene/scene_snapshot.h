@@ -0,0 +1,80 @@
+#ifndef _SCENE_SNAPSHOT_H_
+#define _SCENE_SNAPSHOT_H_
+
+#include <io/mapped_file.h>
+#include <scene/bvh.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+struct InstanceStore;
+
+// Scene snapshot (.ascene): the instances of a generated or imported scene and
+// optionally their BVH, stored as the arrays the renderer keeps them in, so a
+// scene is written once and reopened without generating or parsing anything.
+//
+//   SceneSnapshotHeader
+//   transforms, glm::mat4[instanceCount], 16-byte aligned
+//   colors, uint32_t[instanceCount], 16-byte aligned
+//   bounds, AABB[instanceCount], 16-byte aligned
+//   BVH nodes, BVHNode[nodeCount], 16-byte aligned
+//   BVH indices, int32_t[instanceCount] when nodeCount > 0, 16-byte aligned
+//   BVH instance bounds, AABB[instanceCount] when nodeCount > 0, 16-byte aligned
+struct SceneSnapshotHeader {
+	uint32_t magic;				// sceneSnapshotMagic
+	uint32_t version;
+	uint32_t mesh;				// SceneSnapshotMesh drawn at every instance
+	uint32_t padding;
+	uint64_t instanceCount;
+	uint64_t nodeCount;			// 0 when the snapshot has no BVH
+	uint64_t transformOffset;	// From the start of the file
+	uint64_t colorOffset;
+	uint64_t boundsOffset;
+	uint64_t nodeOffset;
+	uint64_t bvhIndexOffset;
+	uint64_t bvhBoundsOffset;
+};
+
+// The model the scene was drawn with. Its tint, colors[i], is the only
+// per-instance material; both models share the rest of theirs.
+enum SceneSnapshotMesh {
+	SnapshotBox,
+	SnapshotSphere,
+};
+
+static const uint32_t sceneSnapshotMagic = 0x4e435341;	// "ASCN"
+static const uint32_t sceneSnapshotVersion = 1;
+
+// Write the store's colors, transforms and bounds, and `bvh` when not NULL
+// (built over the store's bounds). Instance parameters are not kept.
+bool WriteSceneSnapshot(const std::string &path, const InstanceStore &instances, const BVH *bvh, SceneSnapshotMesh mesh);
+
+// A mapped snapshot. Opening validates the header; the arrays' pages are only
+// read when they are loaded.
+struct SceneSnapshot {
+	MappedFile file;
+	const SceneSnapshotHeader *header = NULL;
+	const glm::mat4 *transforms = NULL;
+	const uint32_t *colors = NULL;
+	const AABB *bounds = NULL;
+	const BVHNode *nodes = NULL;			// NULL without a BVH
+	const int32_t *bvhIndices = NULL;
+	const AABB *bvhBounds = NULL;
+
+	bool open(const std::string &path);
+	void close();
+
+	size_t size() const { return header ? (size_t)header->instanceCount : 0; }
+	bool hasBVH() const { return nodes != NULL; }
+
+	// Copy the instances into `instances`, which is left without parameters, and
+	// the BVH into `bvh` unless it is NULL. Each array is one block copy behind a
+	// read-ahead hint, with nothing built or parsed. Returns whether a BVH was
+	// loaded: false when there is none, or when it refers to nodes or instances
+	// out of range, which leaves `bvh` empty.
+	bool load(InstanceStore &instances, BVH *bvh) const;
+};
+
+#endif
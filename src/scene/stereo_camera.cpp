@@ -0,0 +1,75 @@
+#include "stereo_camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+void ComputeStereoViewProjections(const StereoCamera &camera, glm::mat4 &vpLeft, glm::mat4 &vpRight) {
+	const glm::mat4 &projectionMatrix = camera.projectionMatrix;
+	const glm::vec3 &eyeCenter = camera.eyeCenter, &lookat = camera.lookat, &up = camera.up;
+	float ipd = camera.ipd, FoV = camera.FoV, aspect = camera.aspect, zNear = camera.zNear, zFar = camera.zFar;
+	float viewDistance = camera.viewDistance;
+
+	if (camera.anaglyphMode == None) {
+		// Set camera view matrix
+		glm::mat4 viewMatrix = glm::lookAt(eyeCenter, lookat, up);
+		vpLeft = vpRight = projectionMatrix * viewMatrix;
+
+	} else if (camera.anaglyphMode == ToeIn) {
+
+		// TODO: Implement the toe-in projection here
+		// 1) Compute the camera’s right direction
+		glm::vec3 rightDir = glm::normalize(glm::cross(lookat - eyeCenter, up));
+
+		// 2) Shift each eye left/right by half the IPD
+		glm::vec3 leftEyePos = eyeCenter - 0.5f * ipd * rightDir;
+		glm::vec3 rightEyePos = eyeCenter + 0.5f * ipd * rightDir;
+
+		// 3) “Toe in”: each eye rotates to converge on the same lookat point
+		glm::mat4 viewLeft = glm::lookAt(leftEyePos, lookat, up);
+		glm::mat4 viewRight = glm::lookAt(rightEyePos, lookat, up);
+
+		// 4) Use the same perspective projection for both eyes
+		vpLeft = projectionMatrix * viewLeft;
+		vpRight = projectionMatrix * viewRight;
+
+		// ------------------------------------------------------------
+
+
+	} else if (camera.anaglyphMode == Asymmetric) {	
+
+		// TODO: Implement the asymmetric view frustum here
+		float top = zNear * tan(glm::radians(FoV / 2.0f));
+		float rightVal = top * aspect;
+
+		// Distance from camera to the plane you’re focusing on.
+		// Here, we use “viewDistance” since the camera is ~100 units from the origin.
+		float frustumShift = 0.5f * ipd * (zNear / viewDistance);
+
+		// Compute shared directions
+		glm::vec3 forwardDir = glm::normalize(lookat - eyeCenter);
+		glm::vec3 rightDir = glm::normalize(glm::cross(forwardDir, up));
+
+		// Left eye position (shift by -ipd/2)
+		glm::vec3 leftEyePos = eyeCenter - 0.5f * ipd * rightDir;
+		// Right eye position (shift by +ipd/2)
+		glm::vec3 rightEyePos = eyeCenter + 0.5f * ipd * rightDir;
+
+		// For the left eye, frustum is shifted to the right by “frustumShift”
+		float left_left = -rightVal + frustumShift;
+		float left_right = rightVal + frustumShift;
+		glm::mat4 projLeft = glm::frustum(left_left, left_right, -top, top, zNear, zFar);
+		glm::mat4 viewLeft = glm::lookAt(leftEyePos, leftEyePos + forwardDir, up);
+		vpLeft = projLeft * viewLeft;
+
+		// For the right eye, frustum is shifted left by “frustumShift”
+		float right_left = -rightVal - frustumShift;
+		float right_right = rightVal - frustumShift;
+		glm::mat4 projRight = glm::frustum(right_left, right_right, -top, top, zNear, zFar);
+		glm::mat4 viewRight = glm::lookAt(rightEyePos, rightEyePos + forwardDir, up);
+		vpRight = projRight * viewRight;
+
+		// ------------------------------------------------------------
+
+	}
+}
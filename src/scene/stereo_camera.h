@@ -0,0 +1,25 @@
+#ifndef _STEREO_CAMERA_H_
+#define _STEREO_CAMERA_H_
+
+#include <glm/glm.hpp>
+
+enum AnaglyphMode {
+	None,
+	ToeIn, 
+	Asymmetric, 
+	AnaglyphModeCount,
+};
+
+// Where the scene is viewed from and how the two eyes are set up around it
+struct StereoCamera {
+	glm::mat4 projectionMatrix = glm::mat4(1);	// Of the mono view, also both eyes' in toe-in mode
+	glm::vec3 eyeCenter, lookat, up;
+	float FoV = 45, zNear = 0.1f, zFar = 1000, aspect = 1, viewDistance = 100, ipd = 0;
+	AnaglyphMode anaglyphMode = None;
+};
+
+// Compute the left and right eye view-projection matrices for the camera's 
+// anaglyph mode; both are the mono view-projection without one
+void ComputeStereoViewProjections(const StereoCamera &camera, glm::mat4 &vpLeft, glm::mat4 &vpRight);
+
+#endif
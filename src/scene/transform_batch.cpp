@@ -0,0 +1,171 @@
+#include "transform_batch.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TRANSFORM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_TARGET(x)
+#else
+#define TRANSFORM_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+static inline void multiplyScalar(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+	for (int column = 0; column < 4; ++column) {
+		out[column] = a[0] * b[column][0] + a[1] * b[column][1] + a[2] * b[column][2] + a[3] * b[column][3];
+	}
+}
+
+void TransformBatchScalar(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out) {
+	for (size_t i = 0; i < count; ++i) {
+		multiplyScalar(viewProjection, models[indices ? indices[i] : i], out[i]);
+	}
+}
+
+#ifdef TRANSFORM_X86
+
+// One output column: a * column of b, summed in glm's order
+static inline __m128 columnSSE(const __m128 a[4], const float *b) {
+	__m128 sum = _mm_mul_ps(a[0], _mm_set1_ps(b[0]));
+	sum = _mm_add_ps(sum, _mm_mul_ps(a[1], _mm_set1_ps(b[1])));
+	sum = _mm_add_ps(sum, _mm_mul_ps(a[2], _mm_set1_ps(b[2])));
+	return _mm_add_ps(sum, _mm_mul_ps(a[3], _mm_set1_ps(b[3])));
+}
+
+static void transformSSE(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out) {
+	const float *vp = &viewProjection[0][0];
+	__m128 a[4] = { _mm_loadu_ps(vp), _mm_loadu_ps(vp + 4), _mm_loadu_ps(vp + 8), _mm_loadu_ps(vp + 12) };
+	for (size_t i = 0; i < count; ++i) {
+		const float *b = &models[indices ? indices[i] : i][0][0];
+		float *o = &out[i][0][0];
+		for (int column = 0; column < 4; ++column) {
+			_mm_storeu_ps(o + 4 * column, columnSSE(a, b + 4 * column));
+		}
+	}
+}
+
+static void transformStereoSSE(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, const glm::mat4 *models, const int *indices, size_t count, 
+	glm::mat4 *outLeft, glm::mat4 *outRight) {
+	const float *l = &leftViewProjection[0][0];
+	const float *r = &rightViewProjection[0][0];
+	__m128 a[4] = { _mm_loadu_ps(l), _mm_loadu_ps(l + 4), _mm_loadu_ps(l + 8), _mm_loadu_ps(l + 12) };
+	__m128 c[4] = { _mm_loadu_ps(r), _mm_loadu_ps(r + 4), _mm_loadu_ps(r + 8), _mm_loadu_ps(r + 12) };
+	for (size_t i = 0; i < count; ++i) {
+		const float *b = &models[indices ? indices[i] : i][0][0];
+		float *oLeft = &outLeft[i][0][0];
+		float *oRight = &outRight[i][0][0];
+		for (int column = 0; column < 4; ++column) {
+			_mm_storeu_ps(oLeft + 4 * column, columnSSE(a, b + 4 * column));
+			_mm_storeu_ps(oRight + 4 * column, columnSSE(c, b + 4 * column));
+		}
+	}
+}
+
+// Two output columns at once: each 128-bit lane holds one column of b, and 
+// the in-lane permute broadcasts its k-th element against column k of a.
+TRANSFORM_TARGET("avx")
+static inline __m256 columnPairAVX(const __m256 a[4], __m256 b) {
+	__m256 sum = _mm256_mul_ps(a[0], _mm256_permute_ps(b, 0x00));
+	sum = _mm256_add_ps(sum, _mm256_mul_ps(a[1], _mm256_permute_ps(b, 0x55)));
+	sum = _mm256_add_ps(sum, _mm256_mul_ps(a[2], _mm256_permute_ps(b, 0xAA)));
+	return _mm256_add_ps(sum, _mm256_mul_ps(a[3], _mm256_permute_ps(b, 0xFF)));
+}
+
+TRANSFORM_TARGET("avx")
+static void loadColumnsAVX(const glm::mat4 &m, __m256 a[4]) {
+	const float *p = &m[0][0];
+	for (int k = 0; k < 4; ++k) {
+		a[k] = _mm256_broadcast_ps((const __m128 *)(p + 4 * k));
+	}
+}
+
+TRANSFORM_TARGET("avx")
+static void transformAVX(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out) {
+	__m256 a[4];
+	loadColumnsAVX(viewProjection, a);
+	for (size_t i = 0; i < count; ++i) {
+		const float *b = &models[indices ? indices[i] : i][0][0];
+		float *o = &out[i][0][0];
+		_mm256_storeu_ps(o, columnPairAVX(a, _mm256_loadu_ps(b)));
+		_mm256_storeu_ps(o + 8, columnPairAVX(a, _mm256_loadu_ps(b + 8)));
+	}
+}
+
+TRANSFORM_TARGET("avx")
+static void transformStereoAVX(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, const glm::mat4 *models, const int *indices, size_t count, 
+	glm::mat4 *outLeft, glm::mat4 *outRight) {
+	__m256 a[4], c[4];
+	loadColumnsAVX(leftViewProjection, a);
+	loadColumnsAVX(rightViewProjection, c);
+	for (size_t i = 0; i < count; ++i) {
+		const float *b = &models[indices ? indices[i] : i][0][0];
+		__m256 b01 = _mm256_loadu_ps(b);
+		__m256 b23 = _mm256_loadu_ps(b + 8);
+		float *oLeft = &outLeft[i][0][0];
+		float *oRight = &outRight[i][0][0];
+		_mm256_storeu_ps(oLeft, columnPairAVX(a, b01));
+		_mm256_storeu_ps(oLeft + 8, columnPairAVX(a, b23));
+		_mm256_storeu_ps(oRight, columnPairAVX(c, b01));
+		_mm256_storeu_ps(oRight + 8, columnPairAVX(c, b23));
+	}
+}
+
+enum Kernel { KernelSSE, KernelAVX };
+
+static Kernel detectKernel() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0 && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+	__builtin_cpu_init();
+	bool avx = __builtin_cpu_supports("avx");
+#endif
+	return avx ? KernelAVX : KernelSSE;
+}
+
+static Kernel activeKernel() {
+	static Kernel kernel = detectKernel();
+	return kernel;
+}
+
+const char *TransformKernelName() {
+	return activeKernel() == KernelAVX ? "avx" : "sse";
+}
+
+void TransformBatch(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out) {
+	if (activeKernel() == KernelAVX) {
+		transformAVX(viewProjection, models, indices, count, out);
+	} else {
+		transformSSE(viewProjection, models, indices, count, out);
+	}
+}
+
+void TransformBatchStereo(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, const glm::mat4 *models, const int *indices, size_t count, 
+	glm::mat4 *outLeft, glm::mat4 *outRight) {
+	if (activeKernel() == KernelAVX) {
+		transformStereoAVX(leftViewProjection, rightViewProjection, models, indices, count, outLeft, outRight);
+	} else {
+		transformStereoSSE(leftViewProjection, rightViewProjection, models, indices, count, outLeft, outRight);
+	}
+}
+
+#else
+
+const char *TransformKernelName() {
+	return "scalar";
+}
+
+void TransformBatch(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out) {
+	TransformBatchScalar(viewProjection, models, indices, count, out);
+}
+
+void TransformBatchStereo(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, const glm::mat4 *models, const int *indices, size_t count, 
+	glm::mat4 *outLeft, glm::mat4 *outRight) {
+	TransformBatchScalar(leftViewProjection, models, indices, count, outLeft);
+	TransformBatchScalar(rightViewProjection, models, indices, count, outRight);
+}
+
+#endif
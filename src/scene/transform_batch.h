@@ -0,0 +1,27 @@
+#ifndef _TRANSFORM_BATCH_H_
+#define _TRANSFORM_BATCH_H_
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Batched model-view-projection products for many instances. Instance i of 
+// the batch is models[indices[i]], or models[i] when indices is NULL, and its 
+// result goes to out[i], so the output can be a mapped buffer written front 
+// to back. Results match glm's operator* bit for bit: the kernels multiply 
+// and add in the same order, without fused multiply-add.
+
+// Scalar reference, the same arithmetic as the per-draw path
+void TransformBatchScalar(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out);
+
+// Vectorized (AVX or SSE chosen at runtime)
+void TransformBatch(const glm::mat4 &viewProjection, const glm::mat4 *models, const int *indices, size_t count, glm::mat4 *out);
+
+// Both eyes in one pass, loading each model matrix once
+void TransformBatchStereo(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection, const glm::mat4 *models, const int *indices, size_t count, 
+	glm::mat4 *outLeft, glm::mat4 *outRight);
+
+// Name of the kernel TransformBatch() uses on this machine
+const char *TransformKernelName();
+
+#endif
@@ -4,9 +4,10 @@ layout(location = 1) in vec3 vertexColor;
 
 out vec3 fragColor;
 uniform mat4 MVP;
+uniform vec4 tint;      // Color of this sphere, multiplied into the vertex colors
 
 void main()
 {
     gl_Position = MVP * vec4(vertexPosition, 1.0);
-    fragColor = vertexColor;
+    fragColor = vertexColor * tint.rgb;
 }
@@ -0,0 +1,34 @@
+#version 330 core
+in vec3 rayTarget;
+flat in vec3 center;
+flat in float radius;
+flat in vec3 tint;
+flat in int eye;
+
+out vec4 color;
+
+uniform mat4 VP[2];
+uniform vec3 eyePosition[2];
+
+void main()
+{
+    // Nearest intersection of the eye ray through this pixel with the sphere
+    vec3 origin = eyePosition[eye];
+    vec3 direction = normalize(rayTarget - origin);
+    vec3 offset = origin - center;
+    float b = dot(offset, direction);
+    float c = dot(offset, offset) - radius * radius;
+    float discriminant = b * b - c;
+    if (discriminant < 0.0)
+        discard;
+    vec3 hit = origin + (-b - sqrt(discriminant)) * direction;
+
+    // Depth of the hit point, not of the quad, so spheres intersect each other 
+    // and the boxes exactly. z / w is the same before and after the stereo squeeze.
+    vec4 clip = VP[eye] * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (clip.z / clip.w) + 0.5;
+
+    // The mesh has random vertex colors; impostors shade the tint with a headlight
+    vec3 normal = (hit - center) / radius;
+    color = vec4(tint * (0.35 + 0.65 * max(dot(normal, -direction), 0.0)), 1.0);
+}
@@ -0,0 +1,47 @@
+#version 330 core
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in vec4 instanceColor;
+
+// Each instance is a quad facing the eye, just covering the sphere's outline. 
+// The fragment shader ray-casts the sphere inside it.
+out vec3 rayTarget;         // World position on the quad
+flat out vec3 center;
+flat out float radius;
+flat out vec3 tint;
+flat out int eye;
+
+uniform mat4 VP[2];
+uniform vec3 eyePosition[2];
+uniform int stereo;     // See box_instanced.vert
+
+const vec2 corners[4] = vec2[4](vec2(-1, -1), vec2(1, -1), vec2(-1, 1), vec2(1, 1));
+
+void main()
+{
+    eye = stereo * (gl_InstanceID & 1);
+    center = instanceModel[3].xyz;
+    radius = length(instanceModel[0].xyz);
+    tint = instanceColor.rgb;
+
+    // The quad goes through the center, perpendicular to the view ray. There the 
+    // cone of rays grazing the sphere has radius r d / sqrt(d^2 - r^2).
+    vec3 toEye = eyePosition[eye] - center;
+    float d = length(toEye);
+    vec3 axis = toEye / d;
+    float extent = (d > radius) ? radius * d / sqrt(d * d - radius * radius) : 0.0;
+    vec3 right = normalize(cross(abs(axis.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0), axis));
+    vec3 up = cross(axis, right);
+    rayTarget = center + extent * (corners[gl_VertexID].x * right + corners[gl_VertexID].y * up);
+
+    vec4 position = VP[eye] * vec4(rayTarget, 1.0);
+    if (stereo != 0)
+    {
+        gl_ClipDistance[0] = (eye == 0) ? position.w - position.x : position.w + position.x;
+        position.x = 0.5 * position.x + ((eye == 0) ? -0.5 : 0.5) * position.w;
+    }
+    else
+    {
+        gl_ClipDistance[0] = 1.0;
+    }
+    gl_Position = position;
+}
@@ -0,0 +1,27 @@
+#version 330 core
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in vec4 instanceColor;
+
+out vec3 fragColor;
+uniform mat4 VP[2];
+uniform int stereo;     // See box_instanced.vert
+
+void main()
+{
+    int eye = stereo * (gl_InstanceID & 1);
+    vec4 position = VP[eye] * instanceModel * vec4(vertexPosition, 1.0);
+
+    if (stereo != 0)
+    {
+        gl_ClipDistance[0] = (eye == 0) ? position.w - position.x : position.w + position.x;
+        position.x = 0.5 * position.x + ((eye == 0) ? -0.5 : 0.5) * position.w;
+    }
+    else
+    {
+        gl_ClipDistance[0] = 1.0;
+    }
+    gl_Position = position;
+    fragColor = vertexColor * instanceColor.rgb;
+}
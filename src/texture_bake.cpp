@@ -0,0 +1,54 @@
+// Offline texture baker: decodes an image and writes it with its full mip chain 
+// as a texture container (.atex) that the renderer maps and streams to the GPU.
+
+#include <io/texture_container.h>
+
+#include <stb/stb_image.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+static void printUsage() {
+	std::cout << "Usage: texture_bake INPUT OUTPUT.atex [INPUT OUTPUT.atex ...]" << std::endl;
+}
+
+static bool bake(const char *inputPath, const char *outputPath) {
+	auto start = std::chrono::steady_clock::now();
+
+	int width, height, channels;
+	unsigned char *rgb = stbi_load(inputPath, &width, &height, &channels, 3);
+	if (!rgb) {
+		std::cerr << "Cannot read " << inputPath << std::endl;
+		return false;
+	}
+	bool ok = WriteTextureContainer(outputPath, width, height, rgb);
+	stbi_image_free(rgb);
+	if (!ok) {
+		std::cerr << "Cannot write " << outputPath << std::endl;
+		return false;
+	}
+
+	TextureContainer container;
+	if (!container.open(outputPath)) {
+		std::cerr << "Written container does not validate: " << outputPath << std::endl;
+		return false;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << inputPath << " -> " << outputPath << ": " << width << "x" << height << ", " 
+		<< container.header->levelCount << " levels, " << container.file.size / 1024 << " KiB, " << seconds * 1e3 << " ms" << std::endl;
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3 || (argc - 1) % 2 != 0) {
+		printUsage();
+		return -1;
+	}
+
+	int failures = 0;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!bake(argv[i], argv[i + 1])) ++failures;
+	}
+	return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,373 @@
+#include "ray_tracer.h"
+
+#include <scene/bvh.h>
+#include <util/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRACE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const int maxStackDepth = 128;
+
+// A ray from origin (t = 0, on the near plane) to origin + direction (t = 1, on the far plane)
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+};
+
+struct RayHit {
+	float t = 1.0f;
+	int instance = -1;
+};
+
+// Sides of the box as BuildBoxMesh() lays them out: the corner with UV (0, 1)
+// and the edges along which u grows and v shrinks
+struct BoxFace {
+	glm::vec3 corner, uEdge, vEdge;
+};
+
+static const BoxFace boxFaces[4] = {
+	{ glm::vec3(-1, -1, 1), glm::vec3(2, 0, 0), glm::vec3(0, 2, 0) },		// Front, +z
+	{ glm::vec3(1, -1, -1), glm::vec3(-2, 0, 0), glm::vec3(0, 2, 0) },		// Back, -z
+	{ glm::vec3(-1, -1, -1), glm::vec3(0, 0, 2), glm::vec3(0, 2, 0) },		// Left, -x
+	{ glm::vec3(1, -1, 1), glm::vec3(0, 0, -2), glm::vec3(0, 2, 0) },		// Right, +x
+};
+
+static glm::vec2 boxFaceUV(const BoxFace &face, const glm::vec3 &p) {
+	glm::vec3 offset = p - face.corner;
+	return glm::vec2(glm::dot(offset, face.uEdge) * 0.25f, 1.0f - glm::dot(offset, face.vEdge) * 0.25f);
+}
+
+static Ray toObject(const RayTracer::Instance &instance, const Ray &ray) {
+	Ray local;
+	for (int r = 0; r < 3; ++r) {
+		glm::vec3 row(instance.inverse[r]);
+		local.origin[r] = glm::dot(row, ray.origin) + instance.inverse[r].w;
+		local.direction[r] = glm::dot(row, ray.direction);
+	}
+	return local;
+}
+
+// Entry distance of the ray into [-1, 1]^3, if it enters in [0, tMax). Rays
+// starting inside see nothing, as back faces are culled when rasterizing.
+static bool intersectUnitBox(const Ray &ray, float tMax, float &t) {
+	float enter = 0.0f, exit = tMax;
+	for (int axis = 0; axis < 3; ++axis) {
+		float inverse = 1.0f / ray.direction[axis];
+		float t0 = (-1.0f - ray.origin[axis]) * inverse, t1 = (1.0f - ray.origin[axis]) * inverse;
+		if (t0 > t1) std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		exit = std::min(exit, t1);
+	}
+	if (enter > exit || std::max(std::max(fabsf(ray.origin.x), fabsf(ray.origin.y)), fabsf(ray.origin.z)) <= 1.0f) return false;
+	t = enter;
+	return true;
+}
+
+static bool intersectUnitSphere(const Ray &ray, float tMax, float &t) {
+	float a = glm::dot(ray.direction, ray.direction);
+	float b = glm::dot(ray.origin, ray.direction);
+	float c = glm::dot(ray.origin, ray.origin) - 1.0f;
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f) return false;
+	float enter = (-b - sqrtf(discriminant)) / a;
+	if (enter < 0.0f || enter >= tMax) return false;
+	t = enter;
+	return true;
+}
+
+void RayTracer::build(const glm::mat4 *transforms, const uint32_t *colors, size_t count, ThreadPool *pool) {
+	auto start = std::chrono::steady_clock::now();
+	nodes.clear();
+	instances.clear();
+
+	std::vector<AABB> bounds(count);
+	auto computeBounds = [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) bounds[i] = TransformUnitBounds(transforms[i]);
+	};
+	if (pool) pool->parallelFor(0, (int)count, 4096, computeBounds);
+	else computeBounds(0, (int)count);
+
+	// Single-instance leaves, so the four-wide box test rejects instances
+	// before their object-space test
+	BVH bvh;
+	bvh.build(bounds, 1);
+
+	// Instances in leaf order, so a leaf reads a contiguous range
+	instances.resize(count);
+	auto prepare = [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			const glm::mat4 &transform = transforms[bvh.indices[i]];
+			glm::mat4 inverse = glm::inverse(transform);
+			Instance &instance = instances[i];
+			for (int r = 0; r < 3; ++r) instance.inverse[r] = glm::vec4(inverse[0][r], inverse[1][r], inverse[2][r], inverse[3][r]);
+			instance.center = glm::vec3(transform[3]);
+			instance.radius = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+			uint32_t color = colors[bvh.indices[i]];
+			instance.tint = glm::vec3(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff) / 255.0f;
+		}
+	};
+	if (pool) pool->parallelFor(0, (int)count, 4096, prepare);
+	else prepare(0, (int)count);
+
+	if (bvh.empty()) {
+		stats.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	// Collapse the binary tree: a node takes its children's children, largest
+	// first, until it has four or only leaves are left
+	auto area = [](const AABB &box) {
+		glm::vec3 size = box.max - box.min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	};
+	std::vector<std::pair<int, int>> stack;		// Binary node, four-wide node
+	nodes.push_back(Node());
+	stack.push_back(std::make_pair(0, 0));
+	while (!stack.empty()) {
+		int binary = stack.back().first, wide = stack.back().second;
+		stack.pop_back();
+
+		int children[4], childCount = 0;
+		if (bvh.nodes[binary].isLeaf()) {
+			children[childCount++] = binary;
+		} else {
+			children[childCount++] = bvh.nodes[binary].firstChild;
+			children[childCount++] = bvh.nodes[binary].firstChild + 1;
+		}
+		while (childCount < 4) {
+			int largest = -1;
+			for (int i = 0; i < childCount; ++i) {
+				const BVHNode &node = bvh.nodes[children[i]];
+				if (!node.isLeaf() && (largest < 0 || area(node.bounds) > area(bvh.nodes[children[largest]].bounds))) largest = i;
+			}
+			if (largest < 0) break;
+			int firstChild = bvh.nodes[children[largest]].firstChild;
+			children[largest] = firstChild;
+			children[childCount++] = firstChild + 1;
+		}
+
+		for (int i = 0; i < 4; ++i) {
+			Node &node = nodes[wide];
+			if (i >= childCount) {
+				// Inverted bounds, which the near/far slab test always rejects
+				node.minX[i] = node.minY[i] = node.minZ[i] = INFINITY;
+				node.maxX[i] = node.maxY[i] = node.maxZ[i] = -INFINITY;
+				node.child[i] = -1;
+				node.count[i] = 0;
+				continue;
+			}
+			const BVHNode &child = bvh.nodes[children[i]];
+			node.minX[i] = child.bounds.min.x;
+			node.minY[i] = child.bounds.min.y;
+			node.minZ[i] = child.bounds.min.z;
+			node.maxX[i] = child.bounds.max.x;
+			node.maxY[i] = child.bounds.max.y;
+			node.maxZ[i] = child.bounds.max.z;
+			if (child.isLeaf()) {
+				node.child[i] = child.first;
+				node.count[i] = child.count;
+			} else {
+				node.child[i] = (int)nodes.size();
+				node.count[i] = 0;
+				stack.push_back(std::make_pair(children[i], (int)nodes.size()));
+				nodes.push_back(Node());
+			}
+		}
+	}
+	stats.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Distances at which the ray enters the four child boxes, and a bit for each
+// it enters within [0, tMax). near/far pick the bound the ray meets first on
+// each axis, by the sign of the direction.
+static inline int intersectChildren(const RayTracer::Node &node, const float *origin, const float *inverseDirection, const bool *negative,
+	float tMax, float enter[4]) {
+	const float *nearX = negative[0] ? node.maxX : node.minX, *farX = negative[0] ? node.minX : node.maxX;
+	const float *nearY = negative[1] ? node.maxY : node.minY, *farY = negative[1] ? node.minY : node.maxY;
+	const float *nearZ = negative[2] ? node.maxZ : node.minZ, *farZ = negative[2] ? node.minZ : node.maxZ;
+#ifdef TRACE_SSE2
+	__m128 ox = _mm_set1_ps(origin[0]), oy = _mm_set1_ps(origin[1]), oz = _mm_set1_ps(origin[2]);
+	__m128 ix = _mm_set1_ps(inverseDirection[0]), iy = _mm_set1_ps(inverseDirection[1]), iz = _mm_set1_ps(inverseDirection[2]);
+	__m128 tEnter = _mm_max_ps(
+		_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearX), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearY), oy), iy)),
+		_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearZ), oz), iz), _mm_setzero_ps()));
+	__m128 tExit = _mm_min_ps(
+		_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farX), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farY), oy), iy)),
+		_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farZ), oz), iz), _mm_set1_ps(tMax)));
+	_mm_storeu_ps(enter, tEnter);
+	return _mm_movemask_ps(_mm_cmple_ps(tEnter, tExit));
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; ++i) {
+		float tEnter = std::max(std::max((nearX[i] - origin[0]) * inverseDirection[0], (nearY[i] - origin[1]) * inverseDirection[1]),
+			std::max((nearZ[i] - origin[2]) * inverseDirection[2], 0.0f));
+		float tExit = std::min(std::min((farX[i] - origin[0]) * inverseDirection[0], (farY[i] - origin[1]) * inverseDirection[1]),
+			std::min((farZ[i] - origin[2]) * inverseDirection[2], tMax));
+		enter[i] = tEnter;
+		if (tEnter <= tExit) mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
+// Nearest instance the ray hits, front to back through the four-wide tree
+static void traceRay(const std::vector<RayTracer::Node> &nodes, const std::vector<RayTracer::Instance> &instances, TracedModel model,
+	const Ray &ray, RayHit &hit, RayTracerStats &stats) {
+	if (nodes.empty()) return;
+
+	float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	float inverseDirection[3];
+	bool negative[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		// Zero components would make 0 * infinity NaNs in the slab test
+		float d = ray.direction[axis];
+		if (fabsf(d) < 1e-20f) d = d < 0.0f ? -1e-20f : 1e-20f;
+		inverseDirection[axis] = 1.0f / d;
+		negative[axis] = d < 0.0f;
+	}
+
+	int stack[maxStackDepth];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0) {
+		const RayTracer::Node &node = nodes[stack[--depth]];
+		++stats.nodesVisited;
+
+		float enter[4];
+		int mask = intersectChildren(node, origin, inverseDirection, negative, hit.t, enter);
+		if (!mask) continue;
+
+		// Nearest child first
+		int order[4], count = 0;
+		for (int i = 0; i < 4; ++i) {
+			if (!(mask & (1 << i))) continue;
+			int j = count++;
+			while (j > 0 && enter[order[j - 1]] > enter[i]) {
+				order[j] = order[j - 1];
+				--j;
+			}
+			order[j] = i;
+		}
+
+		// Leaves are intersected now, which shortens the ray for the nodes
+		// pushed after them; nodes go on the stack farthest first
+		int pushed[4], pushCount = 0;
+		for (int k = 0; k < count; ++k) {
+			int i = order[k];
+			if (node.count[i] == 0) {
+				pushed[pushCount++] = node.child[i];
+				continue;
+			}
+			if (enter[i] > hit.t) continue;
+			for (int instance = node.child[i]; instance < node.child[i] + node.count[i]; ++instance) {
+				++stats.instancesTested;
+				Ray local = toObject(instances[instance], ray);
+				float t;
+				bool intersects = model == TracedSphere ? intersectUnitSphere(local, hit.t, t) : intersectUnitBox(local, hit.t, t);
+				if (intersects && t < hit.t) {
+					hit.t = t;
+					hit.instance = instance;
+				}
+			}
+		}
+		for (int k = pushCount - 1; k >= 0 && depth < maxStackDepth; --k) stack[depth++] = pushed[k];
+	}
+}
+
+// The ray through the center of pixel (x, y), rows bottom-up
+static Ray pixelRay(const glm::mat4 &inverseViewProjection, float x, float y, int width, int height) {
+	float ndcX = 2.0f * x / width - 1.0f, ndcY = 2.0f * y / height - 1.0f;
+	glm::vec4 center = inverseViewProjection[0] * ndcX + inverseViewProjection[1] * ndcY + inverseViewProjection[3];
+	glm::vec4 nearPoint = center - inverseViewProjection[2], farPoint = center + inverseViewProjection[2];
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+	return ray;
+}
+
+void RayTracer::render(const glm::mat4 &viewProjection, SoftTarget &target, ThreadPool *pool) {
+	double buildMilliseconds = stats.buildMilliseconds;
+	stats = RayTracerStats();
+	stats.buildMilliseconds = buildMilliseconds;
+
+	auto start = std::chrono::steady_clock::now();
+	glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+	int tilesX = (target.width + tileSize - 1) / tileSize, tilesY = (target.height + tileSize - 1) / tileSize;
+	tileStats.assign(tilesX * tilesY, RayTracerStats());
+
+	auto trace = [&](int begin, int end) {
+		for (int tile = begin; tile < end; ++tile) renderTile(tile, tilesX, inverseViewProjection, target);
+	};
+	if (pool) pool->parallelFor(0, tilesX * tilesY, 1, trace);
+	else trace(0, tilesX * tilesY);
+
+	for (const RayTracerStats &tile : tileStats) {
+		stats.rays += tile.rays;
+		stats.hits += tile.hits;
+		stats.nodesVisited += tile.nodesVisited;
+		stats.instancesTested += tile.instancesTested;
+	}
+	stats.traceMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RayTracer::renderTile(int tile, int tilesX, const glm::mat4 &inverseViewProjection, SoftTarget &target) {
+	int x0 = (tile % tilesX) * tileSize, y0 = (tile / tilesX) * tileSize;
+	int x1 = std::min(x0 + tileSize, target.width), y1 = std::min(y0 + tileSize, target.height);
+	RayTracerStats &tileStat = tileStats[tile];
+
+	for (int y = y0; y < y1; ++y) {
+		uint8_t *pixel = &target.color[((size_t)y * target.width + x0) * 3];
+		for (int x = x0; x < x1; ++x, pixel += 3) {
+			Ray ray = pixelRay(inverseViewProjection, x + 0.5f, y + 0.5f, target.width, target.height);
+			RayHit hit;
+			traceRay(nodes, instances, model, ray, hit, tileStat);
+			++tileStat.rays;
+
+			glm::vec3 color = clearColor;
+			if (hit.instance >= 0) {
+				++tileStat.hits;
+				const Instance &instance = instances[hit.instance];
+				if (model == TracedSphere) {
+					// The impostors' headlight shading of the tint
+					glm::vec3 normal = (ray.origin + hit.t * ray.direction - instance.center) / instance.radius;
+					glm::vec3 view = glm::normalize(ray.direction);
+					color = instance.tint * (0.35f + 0.65f * std::max(glm::dot(normal, -view), 0.0f));
+				} else {
+					color = instance.tint;
+					Ray local = toObject(instance, ray);
+					glm::vec3 p = local.origin + hit.t * local.direction;
+					glm::vec3 magnitude = glm::abs(p);
+					int axis = magnitude.x > magnitude.y && magnitude.x > magnitude.z ? 0 : (magnitude.y > magnitude.z ? 1 : 2);
+					if (texture && axis != 1) {
+						// Top and bottom have UV (0, 0) all over; the sides get the UVs
+						// of the pixel's neighbors on the face's plane for the level of detail
+						const BoxFace &face = boxFaces[axis == 2 ? (p.z > 0.0f ? 0 : 1) : (p.x < 0.0f ? 2 : 3)];
+						float plane = p[axis] > 0.0f ? 1.0f : -1.0f;
+						auto planeUV = [&](const Ray &neighbor) {
+							Ray neighborLocal = toObject(instance, neighbor);
+							float t = (plane - neighborLocal.origin[axis]) / neighborLocal.direction[axis];
+							return boxFaceUV(face, neighborLocal.origin + t * neighborLocal.direction);
+						};
+						glm::vec2 uv = boxFaceUV(face, p);
+						glm::vec2 uvDx = planeUV(pixelRay(inverseViewProjection, x + 1.5f, y + 0.5f, target.width, target.height)) - uv;
+						glm::vec2 uvDy = planeUV(pixelRay(inverseViewProjection, x + 0.5f, y + 1.5f, target.width, target.height)) - uv;
+						color *= texture->sample(uv, uvDx, uvDy);
+					} else if (texture) {
+						color *= texture->sample(glm::vec2(0.0f), glm::vec2(0.0f), glm::vec2(0.0f));
+					}
+				}
+			}
+
+			color = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+			pixel[0] = (uint8_t)color.x;
+			pixel[1] = (uint8_t)color.y;
+			pixel[2] = (uint8_t)color.z;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef _RAY_TRACER_H_
+#define _RAY_TRACER_H_
+
+#include <raster/soft_rasterizer.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ThreadPool;
+
+enum TracedModel {
+	TracedBox,			// The canonical [-1, 1]^3 box, textured on its sides as BuildBoxMesh() maps it
+	TracedSphere,		// The analytic unit sphere, shaded as the sphere impostors are
+};
+
+struct RayTracerStats {
+	long long rays = 0;
+	long long hits = 0;
+	long long nodesVisited = 0;		// Four-wide nodes whose children were tested
+	long long instancesTested = 0;	// Object-space box or sphere tests
+	double buildMilliseconds = 0;
+	double traceMilliseconds = 0;
+};
+
+// Ray traces the scene's instances, one primary ray per pixel center, for
+// high-quality stills. Rays start on the near plane and end on the far plane
+// of the view-projection they are generated from, so both eyes see exactly
+// what the rasterizer would clip them to.
+//
+// Acceleration is two-level. The top level is the instance BVH, collapsed to
+// four children per node whose bounds are tested against a ray at once with
+// SSE2 (scalar elsewhere). The bottom level of every instance is its model
+// in object space: the ray is moved there by the inverse transform, where the
+// box and the sphere are intersected analytically. Tracing cost grows with
+// the logarithm of the instance count rather than with the count.
+//
+// Tiles of pixels are handed out to the pool's threads as they finish, so
+// expensive regions do not hold the frame back.
+struct RayTracer {
+	static const int tileSize = 16;
+
+	TracedModel model = TracedBox;
+	const SoftTexture *texture = NULL;		// Multiplied into the box's sides, may be NULL
+	glm::vec3 clearColor = glm::vec3(163, 227, 255) / 255.0f;
+	RayTracerStats stats;
+
+	// Build the acceleration structure over `count` instances with tints
+	// colors[i] (RGBA8, red in the low byte)
+	void build(const glm::mat4 *transforms, const uint32_t *colors, size_t count, ThreadPool *pool);
+
+	// Trace the target's pixels through viewProjection
+	void render(const glm::mat4 &viewProjection, SoftTarget &target, ThreadPool *pool);
+
+	// Four children of a top-level node, bounds as structures of arrays. A
+	// child with count > 0 is a leaf of `count` instances from `child`, one
+	// with count 0 the node at `child`, and -1 is empty.
+	struct Node {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		int32_t child[4];
+		int32_t count[4];
+	};
+
+	// An instance in leaf order, with what intersection and shading read
+	struct Instance {
+		glm::vec4 inverse[3];		// Rows of the world-to-object affine transform
+		glm::vec3 center;
+		float radius;
+		glm::vec3 tint;
+	};
+
+private:
+	std::vector<Node> nodes;
+	std::vector<Instance> instances;
+	std::vector<RayTracerStats> tileStats;
+
+	void renderTile(int tile, int tilesX, const glm::mat4 &inverseViewProjection, SoftTarget &target);
+};
+
+#endif
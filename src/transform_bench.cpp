@@ -0,0 +1,120 @@
+// Microbenchmark of the per-draw model-view-projection products: the glm 
+// product the draw loop used to compute per object against the batched SIMD 
+// kernels, for one eye and for both eyes in one pass. Needs no OpenGL.
+
+#include <scene/instance_store.h>
+#include <scene/transform_batch.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage() {
+	std::cout << "Usage: transform_bench [--count N] [--iterations N] [--visible FRACTION]" << std::endl;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time `iterations` runs of fn and return the average seconds per run
+template <typename Fn>
+static double timeRuns(int iterations, Fn fn) {
+	fn();	// Warm up caches and page in the output
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) fn();
+	return secondsSince(start) / iterations;
+}
+
+// `products` is the number of matrix products one run computes
+static void printResult(const char *name, double seconds, size_t products) {
+	std::cout << "  " << name << ": " << seconds * 1e3 << " ms/frame, " 
+		<< products / seconds / 1e6 << " M matrices/s" << std::endl;
+}
+
+static bool sameMatrices(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b) {
+	return memcmp(a.data(), b.data(), sizeof(glm::mat4) * a.size()) == 0;
+}
+
+int main(int argc, char **argv) {
+	int count = 100000;
+	int iterations = 100;
+	float visibleFraction = 1.0f;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--count" && hasValue) {
+			count = atoi(argv[++i]);
+		} else if (arg == "--iterations" && hasValue) {
+			iterations = atoi(argv[++i]);
+		} else if (arg == "--visible" && hasValue) {
+			visibleFraction = (float)atof(argv[++i]);
+		} else {
+			printUsage();
+			return 1;
+		}
+	}
+	if (count <= 0 || iterations <= 0 || visibleFraction <= 0 || visibleFraction > 1) {
+		printUsage();
+		return 1;
+	}
+
+	InstanceStore instances;
+	GenerateRandomInstances(instances, count, 2024, NULL);
+
+	// Both eyes of the viewer's default camera, 2 units apart
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	glm::mat4 vpLeft = projection * glm::lookAt(glm::vec3(-1, 0, 100), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0));
+	glm::mat4 vpRight = projection * glm::lookAt(glm::vec3(1, 0, 100), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0));
+
+	// Evenly spread subset standing in for a culled visible list
+	std::vector<int> visible;
+	for (int i = 0; i < count; ++i) {
+		if ((int)((i + 1) * visibleFraction) != (int)(i * visibleFraction)) {
+			visible.push_back(i);
+		}
+	}
+	const int *indices = visibleFraction < 1 ? visible.data() : NULL;
+	size_t n = visible.size();
+
+	std::cout << n << " of " << count << " instances, kernel " << TransformKernelName() << std::endl;
+
+	std::vector<glm::mat4> referenceLeft(n), referenceRight(n), outLeft(n), outRight(n);
+
+	double perDrawTime = timeRuns(iterations, [&] {
+		for (size_t i = 0; i < n; ++i) {
+			const glm::mat4 &model = instances.transforms[indices ? indices[i] : i];
+			referenceLeft[i] = vpLeft * model;
+			referenceRight[i] = vpRight * model;
+		}
+	});
+	printResult("per-draw glm, both eyes", perDrawTime, 2 * n);
+
+	double monoTime = timeRuns(iterations, [&] {
+		TransformBatch(vpLeft, instances.transforms.data(), indices, n, outLeft.data());
+		TransformBatch(vpRight, instances.transforms.data(), indices, n, outRight.data());
+	});
+	printResult("batched, one eye at a time", monoTime, 2 * n);
+	bool match = sameMatrices(outLeft, referenceLeft) && sameMatrices(outRight, referenceRight);
+
+	std::fill(outLeft.begin(), outLeft.end(), glm::mat4(0));
+	std::fill(outRight.begin(), outRight.end(), glm::mat4(0));
+	double stereoTime = timeRuns(iterations, [&] {
+		TransformBatchStereo(vpLeft, vpRight, instances.transforms.data(), indices, n, outLeft.data(), outRight.data());
+	});
+	printResult("batched, both eyes in one pass", stereoTime, 2 * n);
+	match = match && sameMatrices(outLeft, referenceLeft) && sameMatrices(outRight, referenceRight);
+
+	std::cout << "  speedup vs per-draw: " << perDrawTime / monoTime << "x (one eye at a time), " 
+		<< perDrawTime / stereoTime << "x (both eyes)" << std::endl;
+	std::cout << "  output matches per-draw: " << (match ? "yes" : "NO") << std::endl;
+	return match ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef _PHILOX_H_
+#define _PHILOX_H_
+
+#include <cstdint>
+
+// Philox4x32-10 counter-based random number generator (Salmon et al., 
+// "Parallel random numbers: as easy as 1, 2, 3", SC 2011). Each (counter, key) 
+// pair maps to four independent 32-bit words with no state between calls, so 
+// item i of a parallel loop can draw its numbers from counter i and get the 
+// same values whichever thread runs it.
+inline void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for (int round = 0; round < 10; ++round) {
+		uint64_t product0 = (uint64_t)0xD2511F53u * c0;
+		uint64_t product1 = (uint64_t)0xCD9E8D57u * c2;
+		uint32_t hi0 = (uint32_t)(product0 >> 32), lo0 = (uint32_t)product0;
+		uint32_t hi1 = (uint32_t)(product1 >> 32), lo1 = (uint32_t)product1;
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+// Uniform float in [0, 1) from the top 24 bits, exactly representable
+inline float PhiloxUniform(uint32_t bits) {
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer 
+// thread. The producer only writes `tail` and the consumer only writes `head`, 
+// each publishing its slot with a release store the other side acquires. 
+// Capacity must be a power of two.
+template <typename T, size_t Capacity>
+struct SPSCQueue {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+	T items[Capacity];
+	alignas(64) std::atomic<size_t> head{0};	// Next item to pop
+	alignas(64) std::atomic<size_t> tail{0};	// Next slot to push into
+
+	// Producer: returns false if the queue is full
+	bool push(const T &item) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+		items[t & (Capacity - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: returns false if the queue is empty
+	bool pop(T &item) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		item = items[h & (Capacity - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+};
+
+#endif
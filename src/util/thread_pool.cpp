@@ -0,0 +1,79 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+void ThreadPool::initialize(int threadCount) {
+	cleanup();
+	if (threadCount <= 0) {
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	stopping = false;
+	for (int i = 1; i < threadCount; ++i) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+	if (begin >= end) return;
+	grain = std::max(grain, 1);
+
+	// Not worth waking anyone for a single chunk
+	if (workers.empty() || end - begin <= grain) {
+		body(begin, end);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->body = &body;
+		jobEnd = end;
+		jobGrain = grain;
+		next = begin;
+		active = (int)workers.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return active == 0; });
+	this->body = nullptr;
+}
+
+void ThreadPool::runChunks() {
+	for (;;) {
+		int chunkBegin = next.fetch_add(jobGrain);
+		if (chunkBegin >= jobEnd) return;
+		(*body)(chunkBegin, std::min(chunkBegin + jobGrain, jobEnd));
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+		}
+
+		runChunks();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--active == 0) done.notify_one();
+	}
+}
+
+void ThreadPool::cleanup() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+}
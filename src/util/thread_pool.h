@@ -0,0 +1,43 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. parallelFor() splits 
+// [begin, end) into chunks of `grain` items that workers (and the calling 
+// thread) pull from a shared counter, and returns once all chunks are done.
+struct ThreadPool {
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)> *body = nullptr;
+	int jobEnd = 0;
+	int jobGrain = 1;
+	std::atomic<int> next{0};
+	int active = 0;
+	unsigned generation = 0;
+	bool stopping = false;
+
+	~ThreadPool() { cleanup(); }
+
+	// threadCount includes the calling thread, 0 uses all hardware threads
+	void initialize(int threadCount = 0);
+
+	int threadCount() const { return (int)workers.size() + 1; }
+
+	void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+	void cleanup();
+
+	void runChunks();
+	void workerLoop();
+};
+
+#endif